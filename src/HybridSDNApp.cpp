@@ -4,14 +4,19 @@
 using namespace std::chrono;
 
 // ---- 建構子定義（要跟 hpp 簽名完全一致）----
-HybridSDNApp::HybridSDNApp(uint16_t of_port, const Paths& paths)
+HybridSDNApp::HybridSDNApp(uint16_t of_port, const Paths& paths, ShardContext* shard)
   : of_port_(of_port),
     paths_(paths),
+    shard_(shard),
     // TopoViewer(ctl 指標, swid->node 映射, lldp 週期, edge 過期秒數)
     topo_(&ctl_, [](int sw){ return sw; }, milliseconds(1000), seconds(10)),
     // Monitor(ctl 指標, 容量查詢, 取樣週期)
-    mon_(&ctl_, [this](const ::LinkId& e){ return this->cap_lookup_(e); }, milliseconds(2000))
+    mon_(&ctl_, [this](const ::LinkId& e){ return this->cap_lookup_(e); }, milliseconds(2000)),
+    act_(&ctl_)
 {
+  // 分片 hooks 必須在 ctl_.start() 之前裝上（SO_REUSEPORT、swid 目錄）
+  if (shard_) shard_->attach(ctl_);
+
   // 載入拓樸與流
   runtime_graph_ = load_graph_json_(paths_.graph_json);
 
@@ -23,50 +28,445 @@ HybridSDNApp::HybridSDNApp(uint16_t of_port, const Paths& paths)
   fcfg.alpha_max  = 0.9;
   forecast_ = std::make_unique<Forecast>(fcfg);
 
-  flows_ = load_flows_csv_or_default_(paths_.flows_csv, runtime_graph_.nodes);
+  // 設定檔指定的 dpid → node：swid 直接等於 node id，與連線順序無關
+  if (!runtime_graph_.dpid_to_node.empty()) {
+    ctl_.set_switch_ids(runtime_graph_.dpid_to_node);
+    if (shard_)
+      for (const auto& kv : runtime_graph_.dpid_to_node) shard_->segment().reserve(kv.first, kv.second);
+  }
+
+  std::map<int, std::pair<std::string,std::string>> flow_ips;
+  flows_ = load_flows_csv_or_default_(paths_.flows_csv, runtime_graph_.nodes, &flow_ips);
+  for (const auto& kv : flow_ips) act_.set_flow_match(kv.first, kv.second.first, kv.second.second);
+  act_.set_metering(runtime_graph_.meter_headroom, runtime_graph_.meter_band);
+
+  // 暖啟動：switch 身分與 MAC 表交給控制器，規則影子等第一輪 TE 再對帳
+  if (!paths_.state_file.empty()) {
+    store_ = std::make_unique<StateStore>(paths_.state_file);
+    if (auto snap = store_->load()) {
+      ctl_.import_warm_state(snap->switches);
+      for (const auto& sw : snap->switches) restored_dpid_[sw.swid] = sw.dpid;
+      restored_shadow_ = std::move(snap->shadow);
+      last_plan_ = std::move(snap->plan);
+      std::cerr << "[HybridOF] warm start: " << snap->switches.size() << " switches, "
+                << restored_shadow_->size() << " flows from " << paths_.state_file << "\n";
+    }
+  }
+
+  if (!paths_.journal_file.empty() && !topo_.open_journal(paths_.journal_file))
+    std::cerr << "[HybridOF] topology journal disabled\n";
+
+  // 拓樸有變（switch 上下線、鏈路增減或換埠）就提早跑下一輪 TE
+  // 斷線的 switch 可能丟了表（或重連後表不明）：影子裡它的項目作廢，下一輪重送
+  ctl_.on_switch_state([this](int swid, bool up){
+    if (!up) { std::lock_guard<std::mutex> lk(act_mtx_); act_.forget_switch(swid); }
+    wake_te_();
+  });
+  // 鏈路斷線（PORT_STATUS / 探測漏接）：先就地改道，再讓 TE 重新規劃
+  topo_.subscribe([this](const TopoViewer::TopoChange& c){
+    if (c.urgent && (!shard_ || shard_->leader())) fast_reroute_(c.deltas);
+    wake_te_();
+  });
 }
 
 // ---- run() 最小可運作版本（之後你可替換為完整控制邏輯）----
 void HybridSDNApp::run() {
   // 啟動控制器與背景模組
+  std::cerr << "[HybridOF] reading topo: " << paths_.graph_json << "\n";
+  std::cerr << "[HybridOF] nodes=" << runtime_graph_.nodes.size()
+            << " links=" << runtime_graph_.cap_mbps.size()
+            << " sdn=" << runtime_graph_.sdn_nodes.size() << "\n";
+
   if (!ctl_.start(of_port_)) {
     throw std::runtime_error("Failed to start OpenFlow controller");
   }
-std::cerr << "[HybridOF] reading topo: " << paths_.graph_json << "\n";
-std::cerr << "[HybridOF] nodes=" << runtime_graph_.nodes.size()
-          << " links=" << runtime_graph_.cap_mbps.size()
-          << " sdn=" << runtime_graph_.sdn_nodes.size() << "\n";
-
-if (!ctl_.start(of_port_)) {
-  throw std::runtime_error("Failed to start OpenFlow controller");
-}
-std::cerr << "[HybridOF] listening on 0.0.0.0:" << of_port_ << "\n";
+  std::cerr << "[HybridOF] listening on 0.0.0.0:" << of_port_;
+  if (shard_) std::cerr << " (shard " << shard_->index() << "/" << shard_->count()
+                        << (shard_->leader() ? ", TE leader" : "") << ")";
+  std::cerr << "\n";
+  if (shard_) shard_->start();
 
   topo_.start();
   mon_.start();
 
-  // 先跑個簡單的示範循環（避免主程式立刻結束）
-  // 你可以把這段替換成先前的 MILP 迴圈
-  for (int i = 0; i < 3 && running_; ++i) {
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+  // TE 主迴圈：每 te_period_ 跑一輪（容量調和 + MILP）
+  // 分片模式只有 leader 跑 TE；其餘 shard 只定期發布自己的狀態
+  const bool run_te = !shard_ || shard_->leader();
+  const auto period = run_te ? te_period_ : shard_publish_period_;
+  while (running_) {
+    try {
+      if (shard_) publish_shard_();
+      if (run_te) te_cycle_();
+      save_state_();
+    } catch (const std::exception& e) {
+      std::cerr << "[HybridOF] te_cycle error: " << e.what() << "\n";
+    }
+    std::unique_lock<std::mutex> lk(te_mtx_);
+    te_cv_.wait_for(lk, period, [this]{ return te_dirty_ || !running_; });
+    te_dirty_ = false;
   }
 
-  stop();
+  save_state_();
+  shutdown_();
+}
+
+void HybridSDNApp::save_state_() {
+  if (!store_) return;
+  StateSnapshot s;
+  s.switches = ctl_.export_warm_state();
+  {
+    // fast_reroute_ 會在拓樸訂閱執行緒改 Actuator 的規則表
+    std::lock_guard<std::mutex> lk(act_mtx_);
+    s.shadow = act_.shadow();
+    s.plan   = last_plan_;
+  }
+  store_->save(s);
+}
+
+// 快照裡的規則只有在涉及的 switch 都以同一個 dpid 回到同一個 swid 時才沿用；
+// 其餘 flow 視為未安裝，由這一輪 install_paths 重新下發
+void HybridSDNApp::reconcile_restored_() {
+  if (!restored_shadow_) return;
+  std::map<int, bool> same;   // swid -> 身分相符
+  auto ok = [&](int swid) {
+    auto it = same.find(swid);
+    if (it != same.end()) return it->second;
+    const auto info = ctl_.switch_info(swid);
+    auto d = restored_dpid_.find(swid);
+    const bool v = info && info->connected && d != restored_dpid_.end() && info->dpid == d->second;
+    same[swid] = v;
+    return v;
+  };
+  Actuator::Shadow keep;
+  for (auto& kv : *restored_shadow_) {
+    const auto& ins = kv.second;
+    const bool all = std::all_of(ins.rules.begin(),  ins.rules.end(),  [&](const auto& r){ return ok(r.swid); }) &&
+                     std::all_of(ins.groups.begin(), ins.groups.end(), [&](const auto& g){ return ok(g.swid); }) &&
+                     std::all_of(ins.meters.begin(), ins.meters.end(), [&](const auto& m){ return ok(m.swid); });
+    if (all) keep.insert(std::move(kv));
+  }
+  std::cerr << "[HybridOF] warm start: reusing " << keep.size() << "/" << restored_shadow_->size()
+            << " installed flows\n";
+  act_.restore_shadow(std::move(keep));
+  restored_shadow_.reset();
+  restored_dpid_.clear();
+}
+
+// ---- 分片：發布本 shard 狀態 / 讀全域拓樸 ----
+void HybridSDNApp::publish_shard_() {
+  ShardSegment::View v;
+  v.edges = topo_.snapshot_edges();
+  const auto ids = ctl_.switch_ids();
+  const std::set<int> local(ids.begin(), ids.end());
+  for (const auto& w : ctl_.export_warm_state()) {
+    if (!local.count(w.swid)) continue;   // 已斷線、只剩記憶的 switch 不發布
+    for (const auto& m : w.macs) v.hosts.push_back(ShardSegment::Host{m.first, w.swid, m.second});
+  }
+  const auto rates = mon_.last_rates_snapshot();
+  for (int swid : ids) {
+    for (int port : ctl_.ports_of(swid)) {
+      ShardSegment::Rate r;
+      r.swid = swid; r.port = port;
+      r.speed_mbps = ctl_.port_speed_mbps(swid, port);
+      if (auto it = rates.find(::LinkId{swid, port}); it != rates.end()) {
+        r.rx_mbps = it->second.rx_mbps;
+        r.tx_mbps = it->second.tx_mbps;
+      }
+      v.rates.push_back(r);
+    }
+  }
+  shard_->segment().publish(shard_->index(), v);
+}
+
+std::shared_ptr<const TopoGraph> HybridSDNApp::alive_graph_() {
+  if (!shard_) return topo_.graph();
+  auto g = shard_->segment().global();
+  // 其他 shard 的 switch 埠速率只能從它們發布的資料得知（swid == node id）
+  std::map<std::pair<int,int>, uint32_t> speed;
+  for (const auto& r : g.rates) if (r.speed_mbps) speed[{r.swid, r.port}] = r.speed_mbps;
+  auto at = [&](int sw, int port) -> uint32_t {
+    auto it = speed.find({sw, port});
+    return it == speed.end() ? 0 : it->second;
+  };
+  std::vector<TopoGraph::Speed> speeds;
+  speeds.reserve(g.edges.size());
+  for (const auto& e : g.edges) speeds.push_back({at(e.u, e.u_port), at(e.v, e.v_port)});
+  return TopoGraph::build(0, std::move(g.edges), std::move(speeds));
+}
+
+// ---- 容量自動探測 ----
+void HybridSDNApp::refresh_capacities_(const TopoGraph& g) {
+  std::map<::LinkId, double> live;
+  std::map<std::pair<int,int>, double> per_port;
+  // 本地 switch 問控制器（速率可能在快照之後才回報）；否則用快照裡的速率
+  //（其他 shard 的 switch 來自它們發布的資料）
+  auto speed = [&](int swid, int port, uint32_t snap) -> double {
+    if (const uint32_t s = ctl_.port_speed_mbps(swid, port)) return s;
+    return snap;
+  };
+  for (size_t eid = 0; eid < g.edge_count(); ++eid) {
+    const auto& e = g.edges[eid];
+    // 假設 swid == node id（與 TopoViewer 的 mapper 一致）
+    const double su = speed(e.u, e.u_port, g.speeds[eid].u_mbps);
+    const double sv = speed(e.v, e.v_port, g.speeds[eid].v_mbps);
+    // 兩端取瓶頸；只有一端回報時用那一端
+    const double discovered = (su > 0.0 && sv > 0.0) ? std::min(su, sv) : std::max(su, sv);
+    const ::LinkId id = mk_edge_(e.u, e.v);
+    const double cap = reconcile_cap_(runtime_graph_, id, discovered);
+    if (cap <= 0.0) continue;
+    live[id] = cap;
+    per_port[{e.u, e.u_port}] = cap;
+    per_port[{e.v, e.v_port}] = cap;
+  }
+  std::lock_guard<std::mutex> lk(cap_mtx_);
+  live_cap_mbps_.swap(live);
+  port_cap_mbps_.swap(per_port);
+}
+
+// ---- 候選路徑快取 ----
+bool HybridSDNApp::update_paths_(const TopoGraph& g) {
+  const uint64_t epoch = g.epoch;
+  const auto& alive = g.edges;
+  if (epoch && epoch == path_epoch_) return false;     // 拓樸沒變
+  std::set<::LinkId> links;
+  for (const auto& e : alive) links.insert(mk_edge_(e.u, e.v));
+
+  bool changed = true;
+  bool grew = false;
+  std::set<::LinkId> gone;
+  std::vector<TopoViewer::EdgeDelta> deltas;
+  if (epoch && path_epoch_ && topo_.deltas_since(path_epoch_, epoch, deltas)) {
+    for (const auto& d : deltas) {
+      const ::LinkId id = mk_edge_(d.edge.u, d.edge.v);
+      if (d.kind == TopoViewer::EdgeDelta::Kind::Added && links.count(id) && !path_links_.count(id)) grew = true;
+      if (d.kind == TopoViewer::EdgeDelta::Kind::Removed && !links.count(id)) gone.insert(id);
+      // PortChanged：路徑以 node 表示，不必重算
+    }
+  } else {
+    // 分片模式或 delta 已被覆蓋：直接比對集合
+    std::set_difference(path_links_.begin(), path_links_.end(), links.begin(), links.end(),
+                        std::inserter(gone, gone.end()));
+    grew = !std::includes(path_links_.begin(), path_links_.end(), links.begin(), links.end());
+    if (!epoch) {
+      std::set<std::tuple<int,int,int,int>> edges;
+      for (const auto& e : alive) edges.insert({e.u, e.v, e.u_port, e.v_port});
+      changed = (edges != path_edges_);
+      path_edges_.swap(edges);
+    }
+  }
+
+  if (grew) {
+    sd_paths_.clear();
+  } else if (!gone.empty()) {
+    auto uses_gone = [&](const std::vector<te::LinkId>& p) {
+      return std::any_of(p.begin(), p.end(), [&](const te::LinkId& l){ return gone.count(from_te(l)) > 0; });
+    };
+    for (auto it = sd_paths_.begin(); it != sd_paths_.end(); ) {
+      if (std::any_of(it->second.begin(), it->second.end(), uses_gone)) it = sd_paths_.erase(it);
+      else ++it;
+    }
+  }
+  path_links_.swap(links);
+  path_epoch_ = epoch;
+  return changed;
+}
+
+std::vector<te::Path> HybridSDNApp::build_paths_(const TopoGraph& g, const std::vector<te::Flow>& flows, int K) {
+  std::set<std::pair<int,int>> need;
+  for (const auto& f : flows) { int s=f.s, d=f.d; if (s>d) std::swap(s,d); need.insert({s,d}); }
+
+  for (auto sd : need) {
+    if (sd_paths_.count(sd)) continue;
+    std::vector<te::Path> found; int pid = 0;
+    bfs_k_paths_(g, sd.first, sd.second, K, found, pid);
+    auto& slot = sd_paths_[sd];
+    for (auto& p : found) slot.push_back(std::move(p.edges));
+  }
+
+  std::vector<te::Path> paths; int next_pid = 100;
+  for (auto sd : need)
+    for (const auto& edges : sd_paths_[sd]) paths.push_back(te::Path{next_pid++, edges});
+  return paths;
+}
+
+// ---- 一輪 TE ----
+void HybridSDNApp::te_cycle_() {
+  // 整輪 TE 共用同一份不可變快照
+  const auto graph = alive_graph_();
+  const auto& alive = graph->edges;
+  refresh_capacities_(*graph);
+  if (alive.empty()) return;
+
+  const bool topo_changed = update_paths_(*graph);
+  te::GraphCaps caps = make_caps_from_runtime_(runtime_graph_, alive);
+  // 拓樸與容量都和上一次成功的規劃相同：規則已在 switch 上，不重解 MILP
+  if (!topo_changed && te_solved_ && caps.capacity_mbps == te_caps_) return;
+  te_solved_ = false;
+
+  // 結構提示：bridge 的 β 固定 1；其餘 β 依「適合休眠」的順序分支
+  const auto before = metrics_;
+  const auto t0 = steady_clock::now();
+  metrics_ = TopoMetrics::update(metrics_, *graph);
+  if (metrics_ != before)
+    std::cerr << "[HybridOF] topology metrics: " << metrics_->links.size() << " links, "
+              << metrics_->bridge_count() << " bridges ("
+              << duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.0 << " ms)\n";
+  int rank = 0;
+  for (size_t i : metrics_->sleep_order()) {
+    const auto& l = metrics_->links[i];
+    const te::LinkId k{l.u, l.v};
+    if (!caps.sdn(k)) continue;
+    if (l.bridge) caps.keep_on.insert(k);
+    else caps.beta_priority[k] = ++rank;
+  }
+  uint64_t gen = 0;
+  {
+    std::lock_guard<std::mutex> lk(act_mtx_);
+    gen = reroute_gen_;
+  }
+
+  auto paths = build_paths_(*graph, flows_, /*K=*/3);
+  const auto sd2p = map_paths_to_sd_(paths);
+
+  std::vector<te::Flow> flows;
+  for (auto f : flows_) {
+    int s = f.s, d = f.d; if (s > d) std::swap(s, d);
+    auto it = sd2p.find({s, d});
+    if (it == sd2p.end()) continue;       // 目前拓樸不連通，跳過
+    f.cand_path_ids = it->second;
+    flows.push_back(std::move(f));
+  }
+  if (flows.empty()) return;
+  // 資料平面切不開的 flow（OF1.0 上的 /32 來源）在 MILP 裡也不分割，免得規劃與安裝不符
+  if (runtime_graph_.splittable)
+    for (auto& f : flows) f.splittable = act_.splittable(f, paths);
+
+#ifdef HAVE_COINOR
+  te::MILP_TE milp(caps, paths, flows);
+  milp.set_splittable(runtime_graph_.splittable);
+  te::TE_Output plan;
+  if (!milp.solve(te::Weights{}, &plan, /*time_limit_sec=*/2.0)) {
+    std::cerr << "[HybridOF] MILP: no solution (" << plan.status_text << ")\n";
+    return;
+  }
+  std::lock_guard<std::mutex> lk(act_mtx_);
+  // 解的過程中有鏈路斷線且已快速改道：這個解是依舊拓樸算的，丟掉重算
+  if (reroute_gen_ != gen) { wake_te_(); return; }
+  act_.apply_beta(plan, alive);
+  reconcile_restored_();
+  // 其他 shard 的 switch 斷線不經 on_switch_state：連不到的 switch 在影子裡的項目也作廢
+  {
+    std::set<int> seen;
+    for (const auto& kv : act_.shadow()) {
+      for (const auto& r : kv.second.rules)  seen.insert(r.swid);
+      for (const auto& g : kv.second.groups) seen.insert(g.swid);
+      for (const auto& m : kv.second.meters) seen.insert(m.swid);
+    }
+    for (int swid : seen) if (!ctl_.switch_version(swid)) act_.forget_switch(swid);
+  }
+  // 主路徑 + fast-failover 備援（OF1.3）；鏈路斷時由 switch 本地切換
+  // 可分割解（routing=split）則裝 select group / 來源前綴分流
+  act_.install_paths(flows, paths, plan, alive);
+  last_plan_ = std::move(plan);
+  te_flows_ = std::move(flows);
+  te_paths_ = std::move(paths);
+  te_caps_ = caps.capacity_mbps;
+  te_solved_ = true;
+#else
+  (void)caps; (void)gen;
+#endif
+}
+
+// 只動受影響的 flow：分流的去掉斷掉的分支、份額重新正規化；整條斷掉的改走第一條
+// 完好的候選路徑（β = 0 的鏈路不算完好）。其餘 flow 的規則不變，install_paths 只送差異。
+void HybridSDNApp::fast_reroute_(const std::vector<TopoViewer::EdgeDelta>& deltas) {
+  const auto t0 = steady_clock::now();
+  const auto g = topo_.graph();
+  std::set<::LinkId> up, dead;
+  for (const auto& e : g->edges) up.insert(mk_edge_(e.u, e.v));
+  for (const auto& d : deltas) {
+    if (d.kind != TopoViewer::EdgeDelta::Kind::Removed) continue;
+    const ::LinkId id = mk_edge_(d.edge.u, d.edge.v);
+    if (!up.count(id)) dead.insert(id);   // 平行鏈路還在就不算斷
+  }
+  if (dead.empty()) return;
+
+  std::lock_guard<std::mutex> lk(act_mtx_);
+  if (!last_plan_ || te_paths_.empty()) return;
+  te::TE_Output plan = *last_plan_;
+  std::map<int, const te::Path*> by_id;
+  for (const auto& p : te_paths_) by_id[p.id] = &p;
+  auto usable = [&](int pid) {
+    auto it = by_id.find(pid);
+    if (it == by_id.end()) return false;
+    return std::none_of(it->second->edges.begin(), it->second->edges.end(), [&](const te::LinkId& l) {
+      auto b = plan.beta.find(l);
+      return dead.count(from_te(l)) > 0 || (b != plan.beta.end() && b->second == 0);
+    });
+  };
+
+  int moved = 0, stranded = 0;
+  for (const auto& f : te_flows_) {
+    auto cit = plan.chosen_path.find(f.id);
+    if (cit == plan.chosen_path.end()) continue;
+    auto sit = plan.split.find(f.id);
+    bool hit = !usable(cit->second);
+    if (sit != plan.split.end()) {
+      for (const auto& kv : sit->second) hit = hit || !usable(kv.first);
+    }
+    if (!hit) continue;
+
+    std::map<int, double> keep;
+    if (sit != plan.split.end())
+      for (const auto& kv : sit->second) if (usable(kv.first)) keep[kv.first] = kv.second;
+    double sum = 0.0;
+    for (const auto& kv : keep) sum += kv.second;
+    if (!keep.empty() && sum > 0.0) {
+      for (auto& kv : keep) kv.second /= sum;
+      cit->second = std::max_element(keep.begin(), keep.end(),
+                                     [](const auto& a, const auto& b){ return a.second < b.second; })->first;
+      sit->second = std::move(keep);
+    } else {
+      auto alt = std::find_if(f.cand_path_ids.begin(), f.cand_path_ids.end(), usable);
+      if (alt == f.cand_path_ids.end()) { ++stranded; continue; }   // 等 TE 用新拓樸重算
+      cit->second = *alt;
+      if (sit != plan.split.end()) plan.split.erase(sit);
+    }
+    ++moved;
+  }
+  if (!moved) return;
+
+  // 分片模式：本地快照只有本 shard 的鏈路，埠號要從全域聯集查
+  const auto ports = shard_ ? alive_graph_() : g;
+  act_.install_paths(te_flows_, te_paths_, plan, ports->edges);
+  last_plan_ = std::move(plan);
+  ++reroute_gen_;
+  std::cerr << "[HybridOF] fast reroute: " << moved << " flows off " << dead.size() << " failed links in "
+            << duration_cast<microseconds>(steady_clock::now() - t0).count() / 1000.0 << " ms";
+  if (stranded) std::cerr << " (" << stranded << " without an intact candidate)";
+  std::cerr << "\n";
 }
 
 // ---- stop() ----
+// 可從其他執行緒（例如 main 的訊號執行緒）呼叫：只要求 run() 結束；
+// run() 存完快照後才由 shutdown_() 關掉各模組，免得快照看到已清空的 switch 表
 void HybridSDNApp::stop() {
-  if (!running_) return;
   running_ = false;
+  wake_te_();
+}
+
+void HybridSDNApp::shutdown_() {
   topo_.stop();
   mon_.stop();
+  if (shard_) shard_->stop();   // inbox 執行緒會呼叫 ctl_，先停
   ctl_.stop();
 }
 
 // ---- 輔助：讀 flows（或產生 Demo）----
 std::vector<te::Flow>
 HybridSDNApp::load_flows_csv_or_default_(const std::string& path,
-                                         const std::vector<int>& /*nodes*/) {
+                                         const std::vector<int>& /*nodes*/,
+                                         std::map<int, std::pair<std::string,std::string>>* ip_out) {
   std::vector<te::Flow> flows;
   std::ifstream ifs(path);
   if (!ifs) {
@@ -81,7 +481,7 @@ HybridSDNApp::load_flows_csv_or_default_(const std::string& path,
     }
     return flows;
   }
-  // CSV header: flow_id,s,d,demand_mbps
+  // CSV header: flow_id,s,d,demand_mbps[,src_ip,dst_ip]
   std::string line; std::getline(ifs, line);
   while (std::getline(ifs, line)) {
     if (line.empty()) continue;
@@ -94,6 +494,8 @@ HybridSDNApp::load_flows_csv_or_default_(const std::string& path,
     int d  = std::stoi(cols[2]);
     double dem = std::stod(cols[3]);
     flows.push_back(te::Flow{id, s, d, dem, {}});
+    if (ip_out && cols.size() >= 6 && !cols[4].empty() && !cols[5].empty())
+      (*ip_out)[id] = {cols[4], cols[5]};
   }
   return flows;
 }
@@ -1,15 +1,19 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <set>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <tuple>
 #include <utility>
 #include <vector>
 #include <nlohmann/json.hpp>
@@ -18,8 +22,13 @@
 #include "models.hpp"       // 提供全局 ::LinkId
 #include "of_controller.hpp"
 #include "topo_viewer.hpp"
+#include "topo_graph.hpp"
+#include "topo_metrics.hpp"
 #include "monitor.hpp"
 #include "forecast.hpp"
+#include "actuator.hpp"
+#include "state_snapshot.hpp"
+#include "shard.hpp"
 #include "milp_te.hpp"      // te::MILP_TE / te::GraphCaps / te::Path / te::Flow / te::TE_Output / te::Weights / te::LinkId
 
 class HybridSDNApp {
@@ -27,19 +36,27 @@ public:
   struct Paths {
     std::string graph_json;
     std::string flows_csv;
+    std::string state_file;   // 暖啟動快照；空字串 = 不保存
+    std::string journal_file; // 拓樸事件日誌（topo_journal.hpp）；空字串 = 不記錄
     // 用預設建構子設定預設值，避免 in-class initializer + 預設參數的干擾
     Paths() : graph_json("config/NSFNET.json"),
               flows_csv("config/flows.csv") {}
   };
 
   // 只有一個建構子簽名；用 const 引用 + 預設參數
-  explicit HybridSDNApp(uint16_t of_port, const Paths& paths = Paths());
+  // shard：多行程模式下本 worker 的分片（見 shard.hpp）；nullptr = 單一行程
+  explicit HybridSDNApp(uint16_t of_port, const Paths& paths = Paths(), ShardContext* shard = nullptr);
 
   // 只在 public 宣告一次
   void run();
-  void stop();
+  void stop();   // 可跨執行緒呼叫；run() 存完快照、關掉各模組後返回
 
 private:
+  // JSON 容量與 switch 回報速率的調和方式
+  //   Bound    : JSON cap 為上限，實際取 min(JSON, 埠速率)
+  //   Override : JSON cap 直接覆蓋埠速率
+  enum class CapMode { Bound, Override };
+
   // ----------- Runtime graph model（對應 JSON）-----------
   struct RuntimeGraph {
     std::vector<int> nodes;
@@ -47,6 +64,11 @@ private:
     std::map<::LinkId,double> cap_mbps;   // 用全局 ::LinkId
     std::map<::LinkId,double> power_cost;
     std::map<::LinkId,bool>   is_sdn;
+    std::map<::LinkId,CapMode> cap_mode;
+    bool splittable{false};               // 頂層 "routing": "single"（預設）/ "split"
+    double meter_headroom{-1.0};          // "meter": {"headroom": 0.1, "band": "drop"|"dscp_remark"}；<0 = 不限速
+    MeterBand::Type meter_band{MeterBand::Type::Drop};
+    std::map<uint64_t,int> dpid_to_node;  // 頂層 "dpids": {"<node>": "<dpid>"}；未列出的 switch 以 dpid 推得
   };
 
   // ---------- 小工具：::LinkId <-> te::LinkId ----------
@@ -71,84 +93,124 @@ private:
 
   static int to_int_(const std::string& s) { return std::stoi(s); }
 
+  // dpid："0x1a" / "26" / "00:00:00:00:00:00:00:1a"（ovs-ofctl 格式，16 進位）或數字
+  static uint64_t parse_dpid_(const nlohmann::json& v) {
+    if (v.is_number_unsigned() || v.is_number_integer()) return v.get<uint64_t>();
+    std::string s = v.get<std::string>();
+    if (s.find(':') != std::string::npos) {
+      s.erase(std::remove(s.begin(), s.end(), ':'), s.end());
+      return std::stoull(s, nullptr, 16);
+    }
+    return std::stoull(s, nullptr, 0);
+  }
+
+  static CapMode parse_cap_mode_(const std::string& s) {
+    if (s == "override") return CapMode::Override;
+    if (s == "bound" || s == "upper_bound") return CapMode::Bound;
+    throw std::runtime_error("Unknown cap_mode: " + s);
+  }
+
+  // 容量單位：頂層 "cap_unit"（"gbps" 預設 / "mbps"），或逐條給 "cap_mbps"
+  // 調和方式：頂層 "cap_mode"（"bound" 預設 / "override"），可逐條覆寫
   RuntimeGraph load_graph_json_(const std::string& path) {
     using json = nlohmann::json;
     auto j = json::parse(read_all_(path));
     RuntimeGraph G;
     for (auto& s : j.at("nodes"))      G.nodes.push_back(to_int_(s.get<std::string>()));
     for (auto& s : j.at("sdn_nodes"))  G.sdn_nodes.insert(to_int_(s.get<std::string>()));
+
+    const std::string unit = j.value("cap_unit", std::string("gbps"));
+    if (unit != "gbps" && unit != "mbps") throw std::runtime_error("Unknown cap_unit: " + unit);
+    const double scale = (unit == "gbps") ? 1000.0 : 1.0;
+    const CapMode def_mode = parse_cap_mode_(j.value("cap_mode", std::string("bound")));
+    const std::string routing = j.value("routing", std::string("single"));
+    if (routing != "single" && routing != "split") throw std::runtime_error("Unknown routing: " + routing);
+    G.splittable = (routing == "split");
+    if (j.contains("meter")) {
+      const auto& m = j.at("meter");
+      G.meter_headroom = m.value("headroom", 0.1);
+      const std::string band = m.value("band", std::string("drop"));
+      if (band == "drop") G.meter_band = MeterBand::Type::Drop;
+      else if (band == "dscp_remark") G.meter_band = MeterBand::Type::DscpRemark;
+      else throw std::runtime_error("Unknown meter band: " + band);
+    }
+
+    if (j.contains("dpids")) {
+      for (auto it = j.at("dpids").begin(); it != j.at("dpids").end(); ++it) {
+        const uint64_t dpid = parse_dpid_(it.value());
+        if (!dpid) throw std::runtime_error("Invalid dpid for node " + it.key());
+        G.dpid_to_node[dpid] = to_int_(it.key());
+      }
+    }
+
     for (auto& e : j.at("links")) {
       int u = to_int_(e.at("u").get<std::string>());
       int v = to_int_(e.at("v").get<std::string>());
-      double cap = e.at("cap").get<double>() * 1000.0; // 假設 JSON 給 Gbps，內部存 Mbps
+      double cap = e.contains("cap_mbps") ? e.at("cap_mbps").get<double>()
+                                          : e.at("cap").get<double>() * scale;
       auto id = mk_edge_(u, v);
       G.cap_mbps[id]   = cap;
       G.power_cost[id] = cap * 0.1;
       G.is_sdn[id]     = (G.sdn_nodes.count(u) && G.sdn_nodes.count(v));
+      G.cap_mode[id]   = e.contains("cap_mode") ? parse_cap_mode_(e.at("cap_mode").get<std::string>())
+                                                : def_mode;
     }
     return G;
   }
 
-  // 存活鏈路 → MILP 圖能力（key 用 te::LinkId）
+  // JSON 容量 vs. 埠速率（discovered=0 表示未知）
+  static double reconcile_cap_(const RuntimeGraph& RG, const ::LinkId& id, double discovered) {
+    auto it = RG.cap_mbps.find(id);
+    if (it == RG.cap_mbps.end()) return discovered;
+    if (discovered <= 0.0) return it->second;
+    auto mit = RG.cap_mode.find(id);
+    const CapMode mode = (mit == RG.cap_mode.end()) ? CapMode::Bound : mit->second;
+    return (mode == CapMode::Override) ? it->second : std::min(it->second, discovered);
+  }
+
+  // 存活鏈路 → MILP 圖能力（key 用 te::LinkId）；容量取 refresh_capacities_() 的調和結果
   te::GraphCaps make_caps_from_runtime_(const RuntimeGraph& RG,
                                         const std::vector<TopoViewer::Edge>& alive) {
     te::GraphCaps GC;
+    std::lock_guard<std::mutex> lk(cap_mtx_);
     for (const auto& e : alive) {
       ::LinkId g = mk_edge_(e.u, e.v);
-      auto it = RG.cap_mbps.find(g);
-      if (it == RG.cap_mbps.end()) continue;
+      auto lit = live_cap_mbps_.find(g);
+      auto it  = RG.cap_mbps.find(g);
+      const double cap = (lit != live_cap_mbps_.end()) ? lit->second
+                       : (it  != RG.cap_mbps.end())    ? it->second : 0.0;
+      if (cap <= 0.0) continue;
       te::LinkId k = to_te(g);
-      GC.capacity_mbps[k] = it->second;
-      GC.power_cost[k]    = RG.power_cost.at(g);
-      GC.is_sdn[k]        = RG.is_sdn.at(g);
+      GC.capacity_mbps[k] = cap;
+      GC.power_cost[k]    = cap * 0.1;
+      GC.is_sdn[k]        = RG.sdn_nodes.count(g.u) && RG.sdn_nodes.count(g.v);
     }
     return GC;
   }
 
-  // K 條無環 BFS 路徑（te::Path.edges: vector<te::LinkId>）
-  static void bfs_k_paths_(const std::map<int,std::vector<int>>& adj, int s, int d, int K,
+  // 由兩端埠的 feature bits 推得鏈路速率，與 JSON 調和後更新 live 容量表
+  void refresh_capacities_(const TopoGraph& g);
+
+  // K 條無環 BFS 路徑（te::Path.edges: vector<te::LinkId>），見 TopoGraph::k_paths
+  static void bfs_k_paths_(const TopoGraph& g, int s, int d, int K,
                            std::vector<te::Path>& out_paths, int& next_pid) {
-    struct P { int node; std::vector<int> seq; };
-    std::queue<P> q; q.push({s,{s}});
-    std::set<std::vector<int>> seen;
-    while (!q.empty() && static_cast<int>(out_paths.size()) < K) {
-      auto cur = q.front(); q.pop();
-      if (static_cast<int>(cur.seq.size()) > 10) continue; // 深度限制
-      if (cur.node == d) {
-        if (!seen.count(cur.seq)) {
-          std::vector<te::LinkId> edges;
-          for (size_t i = 1; i < cur.seq.size(); ++i)
-            edges.push_back(te::LinkId{std::min(cur.seq[i-1], cur.seq[i]),
-                                       std::max(cur.seq[i-1], cur.seq[i])});
-          out_paths.push_back(te::Path{next_pid++, std::move(edges)});
-          seen.insert(cur.seq);
-        }
-        continue;
-      }
-      auto it = adj.find(cur.node);
-      if (it == adj.end()) continue;
-      for (int nb : it->second) {
-        if (std::find(cur.seq.begin(), cur.seq.end(), nb) != cur.seq.end()) continue; // 禁止成環
-        auto nxt = cur.seq; nxt.push_back(nb);
-        q.push({nb, std::move(nxt)});
+    for (const auto& seq : g.k_paths(s, d, size_t(std::max(K, 0)))) {
+      std::vector<te::LinkId> edges;
+      for (size_t i = 1; i < seq.size(); ++i) {
+        const int a = g.node_id(seq[i-1]), b = g.node_id(seq[i]);
+        edges.push_back(te::LinkId{std::min(a, b), std::max(a, b)});
       }
+      out_paths.push_back(te::Path{next_pid++, std::move(edges)});
     }
   }
 
-  std::vector<te::Path> build_paths_(const std::vector<TopoViewer::Edge>& alive,
-                                     const std::vector<te::Flow>& flows, int K) {
-    std::map<int, std::vector<int>> adj;
-    for (const auto& e : alive) {
-      adj[e.u].push_back(e.v);
-      adj[e.v].push_back(e.u);
-    }
-    std::set<std::pair<int,int>> need;
-    for (auto f : flows) { int s=f.s, d=f.d; if (s>d) std::swap(s,d); need.insert({s,d}); }
-
-    std::vector<te::Path> paths; int next_pid = 100;
-    for (auto [s,d] : need) bfs_k_paths_(adj, s, d, K, paths, next_pid);
-    return paths;
-  }
+  // 候選路徑依 (s,d) 快取；update_paths_() 依拓樸變動作廢受影響的 pair：
+  //   鏈路消失 → 只重算路徑經過它的 pair（其餘 pair 的 BFS 結果不變）
+  //   鏈路新增 → 可能出現更短的路徑，全部重算
+  // 回傳 TE 的輸入拓樸是否有變（含埠變更：規則的出埠取自 alive）
+  bool update_paths_(const TopoGraph& g);
+  // 缺的 pair 才跑 BFS；path id 依 (s,d) 順序從 100 起編，與整批重算相同
+  std::vector<te::Path> build_paths_(const TopoGraph& g, const std::vector<te::Flow>& flows, int K);
 
   // 路徑列表 → (s,d) → 候選 path id
   static std::map<std::pair<int,int>, std::vector<int>>
@@ -169,54 +231,55 @@ private:
     return mp;
   }
 
-  // 監控需要的容量查詢（輸入 ::LinkId）
-  double cap_lookup_(const ::LinkId& e) const {
-    auto it = runtime_graph_.cap_mbps.find(e);
-    return (it == runtime_graph_.cap_mbps.end()) ? 1000.0 : it->second;
-  }
-
-  // 套用 β（plan.beta 的 key 是 te::LinkId）
-  void apply_beta_(const te::TE_Output& plan,
-                   const std::vector<TopoViewer::Edge>& alive) {
-    std::map<te::LinkId, std::pair<int,int>> ports; // (u_port, v_port)
-    std::map<te::LinkId, std::pair<int,int>> nodes; // (u, v)
-    for (const auto& e : alive) {
-      int u = e.u, v = e.v, u_port = e.u_port, v_port = e.v_port;
-      if (u > v) { std::swap(u, v); std::swap(u_port, v_port); }
-      te::LinkId id{u, v};
-      ports[id] = {u_port, v_port};
-      nodes[id] = {u, v}; // 假設 swid == node id
+  // 監控需要的容量查詢：Monitor 的 key 是 {swid, port}（見 OFController::poll_port_stats）
+  // 已知鏈路 → 調和後容量；否則退回埠本身速率；仍未知回傳 0（Monitor 視為不計算 util）
+  double cap_lookup_(const ::LinkId& sw_port) const {
+    {
+      std::lock_guard<std::mutex> lk(cap_mtx_);
+      auto it = port_cap_mbps_.find({sw_port.u, sw_port.v});
+      if (it != port_cap_mbps_.end()) return it->second;
     }
+    return double(ctl_.port_speed_mbps(sw_port.u, sw_port.v));
+  }
 
-    for (const auto& kv : plan.beta) {
-      const te::LinkId id = kv.first;
-      const int beta = kv.second;
-      auto pit = ports.find(id);
-      auto sit = nodes.find(id);
-      if (pit == ports.end() || sit == nodes.end()) continue;
-
-      const int u = sit->second.first;
-      const int v = sit->second.second;
-      const int u_port = pit->second.first;
-      const int v_port = pit->second.second;
-
-      const bool up = (beta == 1);
-      const int speed = up ? 10000 : 0;   // 例：開→10G，關→admin-down
-      ctl_.port_mod(u, u_port, up, speed);
-      ctl_.port_mod(v, v_port, up, speed);
-    }
+  // 一輪 TE：容量 → 候選路徑 → MILP → 套用 β
+  void te_cycle_();
+  // 鏈路回報斷線：不等下一輪 TE，把走過它的 flow 換到上一輪預先算好、仍完好的候選路徑
+  void fast_reroute_(const std::vector<TopoViewer::EdgeDelta>& deltas);
+  // 暖啟動：保存 / 第一輪 TE 前把快照裡的規則影子對回目前的 switch
+  void save_state_();
+  void reconcile_restored_();
+  void shutdown_();
+  // 分片模式：把本 shard 的鏈路 / 主機 / 速率發布到共享區；TE 用的存活鏈路取全域聯集
+  void publish_shard_();
+  // 單一行程：TopoViewer 發布的快照（不複製）；分片模式：由全域聯集現建，epoch = 0
+  std::shared_ptr<const TopoGraph> alive_graph_();
+  void wake_te_() {
+    std::lock_guard<std::mutex> lk(te_mtx_);
+    te_dirty_ = true;
+    te_cv_.notify_one();
   }
 
 private:
   uint16_t of_port_{6633};
   Paths paths_{};
 
-  bool running_{true};
+  std::atomic<bool> running_{true};
+  std::chrono::milliseconds te_period_{5000};
+  std::chrono::milliseconds shard_publish_period_{1000};   // 非 leader shard 的發布週期
+  // switch 上下線 → 立即喚醒 TE 迴圈
+  std::mutex te_mtx_;
+  std::condition_variable te_cv_;
+  bool te_dirty_{false};
+
+  // 分片（nullptr = 單一行程）；只有 leader 跑 TE
+  ShardContext* shard_{nullptr};
 
   // 模組
   OFController ctl_;
   TopoViewer   topo_;
   Monitor      mon_;
+  Actuator     act_;
   std::unique_ptr<Forecast> forecast_;
 
   // 运行態
@@ -224,8 +287,36 @@ private:
   std::vector<te::Flow> flows_;
   std::map<::LinkId, std::vector<double>> hist_mbps_;
 
+  // 已安裝的規劃；TE 執行緒與快速改道（拓樸事件執行緒）共用，act_mtx_ 保護
+  std::mutex act_mtx_;
+  std::optional<te::TE_Output> last_plan_;
+  std::vector<te::Flow> te_flows_;                           // last_plan_ 的輸入
+  std::vector<te::Path> te_paths_;
+  uint64_t reroute_gen_{0};                                  // 每次快速改道 +1：解 MILP 期間改過就作廢該解
+
+  // 暖啟動快照
+  std::unique_ptr<StateStore> store_;
+  std::optional<Actuator::Shadow> restored_shadow_;   // 等 switch 重連後才交給 act_
+  std::map<int, uint64_t> restored_dpid_;             // 快照中的 swid -> dpid
+
+  // 調和後的容量（Monitor 執行緒也會讀）
+  mutable std::mutex cap_mtx_;
+  std::map<::LinkId, double> live_cap_mbps_;                 // (u,v) -> Mbps
+  std::map<std::pair<int,int>, double> port_cap_mbps_;      // (node, port) -> 所屬鏈路 Mbps
+
+  // TE 輸入的版本（只在 TE 執行緒使用）
+  uint64_t path_epoch_{0};                                   // 候選路徑對應的拓樸 epoch
+  std::set<::LinkId> path_links_;                            // 同上，node 層級的鏈路
+  std::set<std::tuple<int,int,int,int>> path_edges_;         // 分片模式：上一輪的 (u,v,u_port,v_port)
+  std::map<std::pair<int,int>, std::vector<std::vector<te::LinkId>>> sd_paths_;  // (s,d) -> 候選路徑
+  std::map<te::LinkId, double> te_caps_;                     // 上一次成功規劃時的容量
+  std::shared_ptr<const TopoMetrics> metrics_;               // bridge / 連通度 / betweenness，鏈路集合變了才重算
+  bool te_solved_{false};
+
   // 僅宣告，定義放在 .cpp
+  // ip_out: 有 src_ip,dst_ip 欄位的 flow → (src, dst)
   static std::vector<te::Flow> load_flows_csv_or_default_(const std::string& path,
-                                                          const std::vector<int>& nodes);
+                                                          const std::vector<int>& nodes,
+                                                          std::map<int, std::pair<std::string,std::string>>* ip_out);
 };
 
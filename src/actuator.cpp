@@ -1,45 +1,532 @@
 // src/actuator.cpp
-#include <map>
-#include <utility>
-#include "of_controller.hpp"
-#include "topo_viewer.cpp" // or include "topo_viewer.hpp" if you split headers
-#include "milp_te.cpp"     // for TE_Output / LinkId; swap to header if you have one
-
-static inline LinkId mk_edge(int a,int b){ if(a>b) std::swap(a,b); return LinkId{a,b}; }
-
-struct Actuator {
-  OFController* ctl;
-  void apply_beta(const TE_Output& plan, const std::vector<TopoViewer::Edge>& alive_edges) {
-    // (u,v) -> (u_port, v_port) and assume swid == node id
-    std::map<LinkId, std::pair<int,int>> ports;
-    std::map<LinkId, std::pair<int,int>> sw_of_node;
-    for (const auto& e : alive_edges) {
-      auto id = mk_edge(e.u, e.v);
-      int up=e.u_port, vp=e.v_port;
-      if (e.u > e.v) std::swap(up, vp);
-      ports[id] = {up, vp};
-      sw_of_node[id] = {e.u, e.v};
-    }
-
-    for (const auto& kv : plan.beta) {
-      const auto& id = kv.first; int beta = kv.second;
-      auto pit = ports.find(id);
-      auto sit = sw_of_node.find(id);
-      if (pit==ports.end() || sit==sw_of_node.end()) continue;
-
-      int u = sit->second.first, v = sit->second.second;
-      int u_port = pit->second.first, v_port = pit->second.second;
-
-      bool up = (beta==1);
-      int speed = up ? 10000 : 0; // up->10G, down->admin down (adjust as needed)
-      ctl->port_mod(u, u_port, up, speed);
-      ctl->port_mod(v, v_port, up, speed);
-      ctl->barrier(u);
-      ctl->barrier(v);
-    }
-  }
-};
-
-// If you need this class from other translation units, provide a header `actuator.hpp`:
-// class Actuator { public: OFController* ctl; void apply_beta(...); };
+#include "actuator.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <set>
+#include <sstream>
+
+#include <arpa/inet.h>
+
+bool Actuator::Group::operator==(const Group& o) const {
+  if (swid != o.swid || id != o.id || type != o.type || buckets.size() != o.buckets.size()) return false;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    const auto& a = buckets[i]; const auto& b = o.buckets[i];
+    if (a.weight != b.weight || a.watch_port != b.watch_port ||
+        a.watch_group != b.watch_group || a.out_ports != b.out_ports) return false;
+  }
+  return true;
+}
+
+// 單一訊息送出；switch 不在（或 1.0 不支援）回 false，送出失敗（佇列滿、轉送失敗）記錄後回 false
+template<class F> static bool sent_(const char* what, int swid, F&& send) {
+  try { return send(); }
+  catch (const std::exception& e) {
+    std::cerr << "[actuator] " << what << " to swid " << swid << " failed: " << e.what() << "\n";
+    return false;
+  }
+}
+
+Actuator::Actuator(OFController* ctl) : ctl_(ctl) {}
+
+void Actuator::set_flow_match(int flow_id, const std::string& src_ip, const std::string& dst_ip) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  ip_[flow_id] = {src_ip, dst_ip};
+}
+
+void Actuator::set_metering(double headroom, MeterBand::Type band) {
+  meter_headroom_ = headroom;
+  meter_band_ = band;
+}
+
+// ---- β → port_mod ----
+void Actuator::apply_beta(const te::TE_Output& plan, const std::vector<TopoViewer::Edge>& alive) {
+  std::map<te::LinkId, std::pair<int,int>> ports; // (u_port, v_port)
+  std::map<te::LinkId, std::pair<int,int>> nodes; // (u, v)
+  for (const auto& e : alive) {
+    int u = e.u, v = e.v, u_port = e.u_port, v_port = e.v_port;
+    if (u > v) { std::swap(u, v); std::swap(u_port, v_port); }
+    te::LinkId id{u, v};
+    ports[id] = {u_port, v_port};
+    nodes[id] = {u, v}; // 假設 swid == node id
+  }
+
+  for (const auto& kv : plan.beta) {
+    const te::LinkId id = kv.first;
+    const int beta = kv.second;
+    auto pit = ports.find(id);
+    auto sit = nodes.find(id);
+    if (pit == ports.end() || sit == nodes.end()) continue;
+
+    const int u = sit->second.first;
+    const int v = sit->second.second;
+    const int u_port = pit->second.first;
+    const int v_port = pit->second.second;
+
+    const bool up = (beta == 1);
+    const int speed = up ? 10000 : 0;   // 例：開→10G，關→admin-down
+    sent_("port_mod", u, [&]{ ctl_->port_mod(u, u_port, up, speed); return true; });
+    sent_("port_mod", v, [&]{ ctl_->port_mod(v, v_port, up, speed); return true; });
+  }
+}
+
+// te::Path 的邊是無向且已正規化（u<v）；從 s 依序走到 d 還原節點序列
+std::vector<int> Actuator::node_seq_(const te::Path& p, int s, int d) {
+  std::vector<int> seq{s};
+  std::vector<bool> used(p.edges.size(), false);
+  int cur = s;
+  for (size_t step = 0; step < p.edges.size(); ++step) {
+    bool moved = false;
+    for (size_t i = 0; i < p.edges.size(); ++i) {
+      if (used[i]) continue;
+      const auto& e = p.edges[i];
+      if (e.u != cur && e.v != cur) continue;
+      cur = (e.u == cur) ? e.v : e.u;
+      used[i] = true; seq.push_back(cur); moved = true;
+      break;
+    }
+    if (!moved) return {};
+  }
+  return (cur == d) ? seq : std::vector<int>{};
+}
+
+// 最大餘數法：w 依比例換成和為 total 的整數
+std::vector<uint16_t> Actuator::quantize_(const std::vector<double>& w, uint16_t total) {
+  std::vector<uint16_t> q(w.size(), 0);
+  const double sum = std::accumulate(w.begin(), w.end(), 0.0);
+  if (sum <= 0.0 || w.empty()) return q;
+  std::vector<std::pair<double, size_t>> rem;
+  int used = 0;
+  for (size_t i = 0; i < w.size(); ++i) {
+    const double x = std::max(0.0, w[i]) / sum * total;
+    q[i] = uint16_t(std::floor(x));
+    used += q[i];
+    rem.push_back({x - q[i], i});
+  }
+  std::sort(rem.begin(), rem.end(), [](const auto& a, const auto& b){ return a.first > b.first; });
+  for (size_t j = 0; used < total && j < rem.size(); ++j, ++used) ++q[rem[j].second];
+  return q;
+}
+
+std::pair<std::string, std::string> Actuator::flow_ips_(const te::Flow& f) const {
+  std::string src, dst;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = ip_.find(f.id);
+    if (it != ip_.end()) { src = it->second.first; dst = it->second.second; }
+  }
+  if (src.empty()) src = "10.0.0." + std::to_string(f.s);
+  if (dst.empty()) dst = "10.0.0." + std::to_string(f.d);
+  return {src, dst};
+}
+
+std::string Actuator::ip_match_(const te::Flow& f, int in_port, const std::string& src_override) const {
+  const auto ips = flow_ips_(f);
+  std::ostringstream ss;
+  if (in_port > 0) ss << "in=" << in_port << ",";
+  ss << "ip,src=" << (src_override.empty() ? ips.first : src_override) << ",dst=" << ips.second;
+  return ss.str();
+}
+
+// 單一 flow 的規則集：
+//   主路徑每一跳 : match(flow, 上一跳埠) → FF group [下一跳 | 備援]
+//     ingress   : 備援 = 備援路徑第一跳
+//     其他節點  : 備援 = IN_PORT（crankback 回上一跳）
+//   crankback   : match(flow, 下一跳埠) → 往上一跳送；到 ingress 時改走備援路徑
+//   備援路徑節點: match(flow, 上一跳埠) → 下一跳
+// OF1.0 switch 沒有 group，只裝主路徑的單純 output。crankback 要一路折返到 ingress 的備援，
+// 所以只有備援存在、且 ingress 到該跳之前都是 OF1.3 時才加 IN_PORT bucket；否則 group 只有主路徑。
+Actuator::Installed Actuator::plan_flow_(const te::Flow& f,
+                                         const std::vector<int>& primary,
+                                         const std::vector<int>& backup,
+                                         const PortMap& port_of) const {
+  Installed out;
+  auto port = [&](int a, int b) {
+    auto it = port_of.find({a, b});
+    return it == port_of.end() ? -1 : it->second;
+  };
+  auto is13 = [&](int swid) { return ctl_->switch_version(swid) == OFController::kOFVersion13; };
+  const uint32_t gid = kFailoverGroupBase + uint32_t(f.id);
+  const int backup_first = (backup.size() >= 2) ? port(backup[0], backup[1]) : -1;
+  bool crank = backup_first > 0;   // 折返的封包到得了備援路徑（上游各跳都有 crankback）
+
+  for (size_t i = 0; i + 1 < primary.size(); ++i) {
+    const int n = primary[i];
+    const int out_p = port(n, primary[i+1]);
+    const int in_p  = (i > 0) ? port(n, primary[i-1]) : -1;
+    if (out_p < 0 || (i > 0 && in_p < 0)) return Installed{};   // 拓樸與路徑不一致
+
+    if (!is13(n)) {
+      out.rules.push_back(Rule{n, ip_match_(f, in_p), "output:" + std::to_string(out_p), kPrioPath});
+      crank = false;
+      continue;
+    }
+    Group g; g.swid = n; g.id = gid; g.type = GroupType::FastFailover;
+    GroupBucket b1; b1.watch_port = uint32_t(out_p); b1.out_ports = {uint32_t(out_p)};
+    g.buckets.push_back(b1);
+    if (i == 0 && backup_first > 0) {
+      GroupBucket b2; b2.watch_port = uint32_t(backup_first); b2.out_ports = {uint32_t(backup_first)};
+      g.buckets.push_back(b2);
+    } else if (i > 0 && crank) {
+      GroupBucket b2; b2.watch_port = uint32_t(in_p); b2.out_ports = {OFController::kInPort};
+      g.buckets.push_back(b2);
+    }
+    out.groups.push_back(g);
+    out.rules.push_back(Rule{n, ip_match_(f, in_p), "group:" + std::to_string(gid), kPrioPath});
+
+    // crankback：從下一跳折返的封包
+    const int back_to = (i > 0) ? in_p : backup_first;
+    if (crank && back_to > 0)
+      out.rules.push_back(Rule{n, ip_match_(f, out_p), "output:" + std::to_string(back_to), kPrioCrankback});
+  }
+
+  // 備援路徑（ingress 之後、egress 之前）的逐跳轉送
+  for (size_t i = 1; i + 1 < backup.size(); ++i) {
+    const int n = backup[i];
+    const int in_p = port(n, backup[i-1]), out_p = port(n, backup[i+1]);
+    if (in_p < 0 || out_p < 0) break;
+    out.rules.push_back(Rule{n, ip_match_(f, in_p), "output:" + std::to_string(out_p), kPrioPath});
+  }
+  return out;
+}
+
+bool Actuator::splittable(const te::Flow& f, const std::vector<te::Path>& paths) const {
+  const std::string src = flow_ips_(f).first;
+  const auto slash = src.find('/');
+  if (slash != std::string::npos && std::stoi(src.substr(slash + 1)) < 32) return true;
+  // /32：經過的 OF1.0 switch（egress 除外，它只往主機送）切不開
+  std::set<int> nodes;
+  for (const auto& p : paths) {
+    if (std::find(f.cand_path_ids.begin(), f.cand_path_ids.end(), p.id) == f.cand_path_ids.end()) continue;
+    for (const auto& e : p.edges) { nodes.insert(e.u); nodes.insert(e.v); }
+  }
+  nodes.erase(f.d);
+  return std::all_of(nodes.begin(), nodes.end(), [&](int n){
+    return ctl_->switch_version(n) == OFController::kOFVersion13;
+  });
+}
+
+// 可分割 flow：各 path 份額在每個 (節點, 入埠) 彙整成下一跳份額
+//   OF1.3 → select group（權重量化為 kWeightScale）
+//   OF1.0 → 來源前綴切成 2^k 個子前綴，依份額分配下一跳；來源為 /32 時只能走最大份額
+// 以 in_port 區分狀態後若仍可能成環，回傳空集合讓呼叫端退回單一路徑。
+Actuator::Installed Actuator::plan_split_(const te::Flow& f,
+                                          const std::vector<std::pair<std::vector<int>, double>>& parts,
+                                          const PortMap& port_of) const {
+  auto port = [&](int a, int b) {
+    auto it = port_of.find({a, b});
+    return it == port_of.end() ? -1 : it->second;
+  };
+  using Key = std::pair<int,int>;                     // (node, in_port)；ingress 的 in_port = -1
+  std::map<Key, std::map<int, double>> hop;           // → 下一跳節點 → 份額
+  for (const auto& pw : parts) {
+    const auto& seq = pw.first;
+    for (size_t i = 0; i + 1 < seq.size(); ++i) {
+      const int in_p = (i > 0) ? port(seq[i], seq[i-1]) : -1;
+      if ((i > 0 && in_p < 0) || port(seq[i], seq[i+1]) < 0) return Installed{};
+      hop[{seq[i], in_p}][seq[i+1]] += pw.second;
+    }
+  }
+
+  // 環偵測：(n,in) → (m, port(m,n))
+  std::map<Key, int> color;   // 0 未訪、1 進行中、2 完成
+  std::function<bool(const Key&)> cyclic = [&](const Key& k) -> bool {
+    auto it = hop.find(k);
+    if (it == hop.end()) return false;
+    int& c = color[k];
+    if (c == 1) return true;
+    if (c == 2) return false;
+    c = 1;
+    for (const auto& nx : it->second)
+      if (cyclic({nx.first, port(nx.first, k.first)})) return true;
+    color[k] = 2;
+    return false;
+  };
+  for (const auto& kv : hop) if (cyclic(kv.first)) return Installed{};
+
+  // 來源前綴（OF1.0 切分用）
+  const std::string src = flow_ips_(f).first;
+  uint32_t src_host = 0; int src_plen = 32;
+  {
+    const auto slash = src.find('/');
+    in_addr a{};
+    if (inet_aton(src.substr(0, slash).c_str(), &a) != 0) src_host = ntohl(a.s_addr);
+    if (slash != std::string::npos) src_plen = std::clamp(std::stoi(src.substr(slash + 1)), 0, 32);
+  }
+
+  Installed out;
+  std::map<int, uint32_t> next_gid;                   // 每台 switch 的 select group 序號
+  for (const auto& kv : hop) {
+    const int n = kv.first.first, in_p = kv.first.second;
+    std::vector<int> nexts; std::vector<double> w;
+    for (const auto& nx : kv.second) { nexts.push_back(port(n, nx.first)); w.push_back(nx.second); }
+
+    if (nexts.size() == 1) {
+      out.rules.push_back(Rule{n, ip_match_(f, in_p), "output:" + std::to_string(nexts[0]), kPrioPath});
+      continue;
+    }
+    if (ctl_->switch_version(n) == OFController::kOFVersion13) {
+      const auto q = quantize_(w, kWeightScale);
+      Group g; g.swid = n; g.type = GroupType::Select;
+      g.id = kSelectGroupBase + (uint32_t(f.id) << 8) + next_gid[n]++;
+      for (size_t i = 0; i < nexts.size(); ++i) {
+        if (q[i] == 0) continue;
+        GroupBucket b; b.weight = q[i]; b.watch_port = uint32_t(nexts[i]); b.out_ports = {uint32_t(nexts[i])};
+        g.buckets.push_back(b);
+      }
+      out.groups.push_back(g);
+      out.rules.push_back(Rule{n, ip_match_(f, in_p), "group:" + std::to_string(g.id), kPrioPath});
+      continue;
+    }
+    // OF1.0：無 group、無法遮罩 tp_src，只能切來源前綴
+    const int bits = std::min(kOF10SplitBits, 32 - src_plen);
+    if (bits <= 0) {
+      // 正常不會到這裡（splittable() 為 false 的 flow 不會被分割）；switch 換版本時才可能
+      const size_t best = size_t(std::max_element(w.begin(), w.end()) - w.begin());
+      std::cerr << "[actuator] flow " << f.id << ": OF1.0 swid " << n
+                << " cannot split a /32 source, all traffic to the largest share (installed routing differs from the plan)\n";
+      out.rules.push_back(Rule{n, ip_match_(f, in_p), "output:" + std::to_string(nexts[best]), kPrioPath});
+      continue;
+    }
+    const auto q = quantize_(w, uint16_t(1u << bits));
+    const int sub_plen = src_plen + bits;
+    const uint32_t base = src_plen ? (src_host & (~0u << (32 - src_plen))) : 0;
+    uint32_t part = 0;
+    for (size_t i = 0; i < nexts.size(); ++i) {
+      for (uint16_t k = 0; k < q[i]; ++k, ++part) {
+        in_addr a{}; a.s_addr = htonl(base | (part << (32 - sub_plen)));
+        const std::string sub = std::string(inet_ntoa(a)) + "/" + std::to_string(sub_plen);
+        out.rules.push_back(Rule{n, ip_match_(f, in_p, sub), "output:" + std::to_string(nexts[i]), kPrioPath});
+      }
+    }
+  }
+  return out;
+}
+
+// ingress（f.s 上不帶 in= 的規則）前面加 meter；只有 OF1.3 有 meter table
+void Actuator::attach_meter_(const te::Flow& f, Installed& ins) const {
+  if (meter_headroom_ < 0.0 || f.demand_mbps <= 0.0) return;
+  if (ctl_->switch_version(f.s) != OFController::kOFVersion13) return;
+  Meter m; m.swid = f.s; m.id = kMeterBase + uint32_t(f.id);
+  m.band.type = meter_band_;
+  m.band.rate_kbps = uint32_t(std::lround(f.demand_mbps * (1.0 + meter_headroom_) * 1000.0));
+  m.band.burst_kb  = std::max<uint32_t>(1, m.band.rate_kbps * kMeterBurstMs / 1000);
+  bool used = false;
+  for (auto& r : ins.rules) {
+    if (r.swid != f.s || r.match.rfind("in=", 0) == 0) continue;
+    r.actions = "meter:" + std::to_string(m.id) + "," + r.actions;
+    used = true;
+  }
+  if (used) ins.meters.push_back(m);
+}
+
+void Actuator::install_paths(const std::vector<te::Flow>& flows,
+                             const std::vector<te::Path>& paths,
+                             const te::TE_Output& plan,
+                             const std::vector<TopoViewer::Edge>& alive) {
+  PortMap port_of;
+  std::set<te::LinkId> up_links;
+  for (const auto& e : alive) {
+    port_of[{e.u, e.v}] = e.u_port;
+    port_of[{e.v, e.u}] = e.v_port;
+    up_links.insert(te::LinkId{std::min(e.u, e.v), std::max(e.u, e.v)});
+  }
+  // β=0 的鏈路即將 admin-down，不拿來當備援
+  for (const auto& kv : plan.beta) if (kv.second == 0) up_links.erase(kv.first);
+
+  std::map<int, const te::Path*> path_by_id;
+  for (const auto& p : paths) path_by_id[p.id] = &p;
+
+  std::map<int, Installed> want;
+  for (const auto& f : flows) {
+    auto cit = plan.chosen_path.find(f.id);
+    if (cit == plan.chosen_path.end()) continue;
+    auto pit = path_by_id.find(cit->second);
+    if (pit == path_by_id.end()) continue;
+    const auto primary = node_seq_(*pit->second, f.s, f.d);
+    if (primary.size() < 2) continue;
+
+    // 最佳解把 flow 分到多條 path → 分流樹
+    auto sit = plan.split.find(f.id);
+    if (sit != plan.split.end() && sit->second.size() > 1) {
+      std::vector<std::pair<std::vector<int>, double>> parts;
+      for (const auto& pw : sit->second) {
+        auto bit = path_by_id.find(pw.first);
+        if (bit == path_by_id.end()) continue;
+        auto seq = node_seq_(*bit->second, f.s, f.d);
+        if (seq.size() >= 2) parts.push_back({std::move(seq), pw.second});
+      }
+      if (parts.size() > 1) {
+        Installed ins = plan_split_(f, parts, port_of);
+        if (!ins.rules.empty()) { attach_meter_(f, ins); want[f.id] = std::move(ins); continue; }
+      }
+    }
+
+    // 備援：與主路徑邊不相交、且全程存活的候選中最短者
+    const std::set<te::LinkId> used(pit->second->edges.begin(), pit->second->edges.end());
+    std::vector<int> backup;
+    for (int pid : f.cand_path_ids) {
+      if (pid == cit->second) continue;
+      auto bit = path_by_id.find(pid);
+      if (bit == path_by_id.end()) continue;
+      const auto& edges = bit->second->edges;
+      const bool ok = std::all_of(edges.begin(), edges.end(), [&](const te::LinkId& e) {
+        return !used.count(e) && up_links.count(e);
+      });
+      if (!ok) continue;
+      auto seq = node_seq_(*bit->second, f.s, f.d);
+      if (seq.size() >= 2 && (backup.empty() || seq.size() < backup.size())) backup = std::move(seq);
+    }
+
+    Installed ins = plan_flow_(f, primary, backup, port_of);
+    if (ins.rules.empty()) continue;
+    attach_meter_(f, ins);
+    want[f.id] = std::move(ins);
+  }
+
+  // 不再有路徑的 flow → 移除
+  for (auto it = installed_.begin(); it != installed_.end(); ) {
+    if (!want.count(it->first)) remove_(Installed(it->second), &it->second);
+    // 沒刪乾淨的（switch 不在、送不出去）留著，下一輪再刪
+    if (!want.count(it->first) && it->second == Installed{}) it = installed_.erase(it);
+    else ++it;
+  }
+  for (auto& kv : want) push_(kv.first, kv.second);
+}
+
+// 與上次安裝的差異：先建/改 meter 與 group，再裝規則，最後清掉過時的規則、group、meter。
+// have 只記確實送出的部分；沒送到的下一輪 have != want 會再試
+void Actuator::push_(int flow_id, const Installed& want) {
+  Installed& have = installed_[flow_id];
+  if (have == want) return;
+  const uint64_t cookie = kCookieBase | uint64_t(uint32_t(flow_id));
+
+  for (const auto& m : want.meters) {
+    auto old = std::find_if(have.meters.begin(), have.meters.end(),
+                            [&](const Meter& h){ return h.swid == m.swid && h.id == m.id; });
+    if (old != have.meters.end() && *old == m) continue;
+    const bool known = old != have.meters.end();
+    // 沒有紀錄的 id 可能還留在 switch 上（重連、上次送一半）：先刪再加，免得 METER_EXISTS
+    const bool ok = sent_("meter_mod", m.swid, [&]{
+      if (!known) ctl_->meter_mod(m.swid, MeterCommand::Delete, m.id);
+      return ctl_->meter_mod(m.swid, known ? MeterCommand::Modify : MeterCommand::Add, m.id, {m.band});
+    });
+    if (!ok) std::cerr << "[actuator] meter_mod failed (swid=" << m.swid << " meter=" << m.id << ")\n";
+    else if (known) *old = m;
+    else have.meters.push_back(m);
+  }
+
+  for (const auto& g : want.groups) {
+    auto old = std::find_if(have.groups.begin(), have.groups.end(),
+                            [&](const Group& h){ return h.swid == g.swid && h.id == g.id; });
+    if (old != have.groups.end() && *old == g) continue;
+    const bool known = old != have.groups.end();
+    const bool ok = sent_("group_mod", g.swid, [&]{
+      if (!known) ctl_->group_mod(g.swid, GroupCommand::Delete, g.id);
+      return ctl_->group_mod(g.swid, known ? GroupCommand::Modify : GroupCommand::Add, g.id, g.type, g.buckets);
+    });
+    if (!ok) std::cerr << "[actuator] group_mod failed (swid=" << g.swid << " group=" << g.id << ")\n";
+    else if (known) *old = g;
+    else have.groups.push_back(g);
+  }
+
+  auto same_key = [](const Rule& a, const Rule& b) {
+    return a.swid == b.swid && a.match == b.match && a.priority == b.priority;
+  };
+  // 規則引用的 group / meter 沒裝上就先不送，免得 switch 回 BAD_OUT_GROUP / BAD_METER
+  auto deps_in = [&](const Rule& r) {
+    std::istringstream as(r.actions);
+    std::string tok;
+    while (std::getline(as, tok, ',')) {
+      const bool g = tok.rfind("group:", 0) == 0, m = tok.rfind("meter:", 0) == 0;
+      if (!g && !m) continue;
+      const uint32_t id = uint32_t(std::stoul(tok.substr(6)));
+      const bool have_it = g
+        ? std::any_of(have.groups.begin(), have.groups.end(), [&](const Group& h){ return h.swid == r.swid && h.id == id; })
+        : std::any_of(have.meters.begin(), have.meters.end(), [&](const Meter& h){ return h.swid == r.swid && h.id == id; });
+      if (!have_it) return false;
+    }
+    return true;
+  };
+  for (const auto& r : want.rules) {
+    if (std::find(have.rules.begin(), have.rules.end(), r) != have.rules.end()) continue;
+    if (!deps_in(r)) continue;
+    const bool ok = sent_("flow_mod", r.swid, [&]{
+      return ctl_->flow_mod(r.swid, r.match, r.actions, r.priority, /*add=*/true, {}, {}, cookie, OFController::kTableTE);
+    });
+    if (!ok) continue;
+    // 同 match/priority 的 ADD 會覆蓋舊動作
+    auto old = std::find_if(have.rules.begin(), have.rules.end(), [&](const Rule& h){ return same_key(h, r); });
+    if (old != have.rules.end()) *old = r;
+    else have.rules.push_back(r);
+  }
+
+  Installed stale;
+  for (const auto& r : have.rules) {
+    const bool kept = std::any_of(want.rules.begin(), want.rules.end(), [&](const Rule& w){ return same_key(w, r); });
+    if (!kept) stale.rules.push_back(r);
+  }
+  for (const auto& g : have.groups) {
+    const bool kept = std::any_of(want.groups.begin(), want.groups.end(), [&](const Group& w){
+      return w.swid == g.swid && w.id == g.id;
+    });
+    if (!kept) stale.groups.push_back(g);
+  }
+  for (const auto& m : have.meters) {
+    const bool kept = std::any_of(want.meters.begin(), want.meters.end(), [&](const Meter& w){
+      return w.swid == m.swid && w.id == m.id;
+    });
+    if (!kept) stale.meters.push_back(m);
+  }
+  remove_(stale, &have);
+}
+
+// 刪除 'gone' 的規則、group、meter；from 不為空時，只把確實送出刪除的項目從 from 拿掉
+void Actuator::remove_(const Installed& gone, Installed* from) {
+  auto drop = [](auto& v, const auto& x) {
+    auto it = std::find(v.begin(), v.end(), x);
+    if (it != v.end()) v.erase(it);
+  };
+  for (const auto& r : gone.rules) {
+    const bool ok = sent_("flow_mod", r.swid, [&]{
+      return ctl_->flow_mod(r.swid, r.match, "", r.priority, /*add=*/false, {}, {}, {}, OFController::kTableTE);
+    });
+    if (ok && from) drop(from->rules, r);
+  }
+  for (const auto& g : gone.groups) {
+    const bool ok = sent_("group_mod", g.swid, [&]{ return ctl_->group_mod(g.swid, GroupCommand::Delete, g.id); });
+    if (ok && from) drop(from->groups, g);
+  }
+  for (const auto& m : gone.meters) {
+    const bool ok = sent_("meter_mod", m.swid, [&]{ return ctl_->meter_mod(m.swid, MeterCommand::Delete, m.id); });
+    if (ok && from) drop(from->meters, m);
+  }
+}
+
+Actuator::Shadow Actuator::shadow() const {
+  return installed_;
+}
+
+void Actuator::restore_shadow(Shadow s) {
+  installed_ = std::move(s);
+}
+
+void Actuator::forget_switch(int swid) {
+  for (auto it = installed_.begin(); it != installed_.end(); ) {
+    auto& ins = it->second;
+    auto on = [swid](const auto& x) { return x.swid == swid; };
+    ins.rules.erase(std::remove_if(ins.rules.begin(), ins.rules.end(), on), ins.rules.end());
+    ins.groups.erase(std::remove_if(ins.groups.begin(), ins.groups.end(), on), ins.groups.end());
+    ins.meters.erase(std::remove_if(ins.meters.begin(), ins.meters.end(), on), ins.meters.end());
+    if (ins == Installed{}) it = installed_.erase(it);
+    else ++it;
+  }
+}
+
+void Actuator::clear() {
+  for (const auto& kv : installed_) remove_(kv.second);
+  installed_.clear();
+}
@@ -0,0 +1,152 @@
+#pragma once
+#ifndef HYBRID_ACTUATOR_HPP
+#define HYBRID_ACTUATOR_HPP
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "of_controller.hpp"
+#include "topo_viewer.hpp"
+#include "milp_te.hpp"
+
+//
+//  TE Actuator
+//  -----------------------------------------------
+//  Pushes a te::TE_Output into the switches: β becomes port_mod, chosen paths
+//  become per-hop flow rules. On OF1.3 switches each hop forwards through a
+//  fast-failover group whose buckets are precomputed from the flow's candidate
+//  paths (primary next hop first, then the backup path at the ingress switch or
+//  crankback toward it further along), so a link failure is repaired in the
+//  data plane without waiting for LLDP expiry and a new TE cycle. OF1.0
+//  switches get plain primary-path rules.
+//
+//  Flows that the optimizer splits (TE_Output::split with several paths) are
+//  installed as a per-(node, in_port) splitting tree instead: OF1.3 hops use
+//  select groups with quantized bucket weights, OF1.0 hops partition the
+//  flow's source prefix into sub-prefixes (1.0 cannot mask L4 ports).
+//
+//  Optionally each flow is policed at its ingress switch (OF1.3 meter) to
+//  demand × (1 + headroom), so a flow that overshoots its TE budget cannot
+//  push links the optimizer packed tightly past capacity.
+//
+//  Rules live in OFController::kTableTE; on pipelined OF1.3 switches unmatched
+//  traffic falls through to the L2 table, so TE and learning never compete.
+//
+//  Node ids are assumed to equal switch ids (same as TopoViewer's default mapper).
+//
+class Actuator {
+public:
+  explicit Actuator(OFController* ctl);
+
+  // Optional IP classifier per flow; default is 10.0.0.<s> -> 10.0.0.<d>.
+  void set_flow_match(int flow_id, const std::string& src_ip, const std::string& dst_ip);
+
+  // Meter every flow at its ingress switch; headroom < 0 disables (default).
+  void set_metering(double headroom, MeterBand::Type band = MeterBand::Type::Drop);
+
+  // β = 0 → both ends admin-down, β = 1 → up.
+  void apply_beta(const te::TE_Output& plan, const std::vector<TopoViewer::Edge>& alive);
+
+  // Install (or refresh) forwarding for every flow in plan.chosen_path. Flows
+  // whose rules did not change are left untouched; flows no longer routed are removed.
+  void install_paths(const std::vector<te::Flow>& flows,
+                     const std::vector<te::Path>& paths,
+                     const te::TE_Output& plan,
+                     const std::vector<TopoViewer::Edge>& alive);
+
+  // Whether a split of this flow over its candidate paths can be installed as
+  // planned. An OF1.0 switch can only split by source sub-prefix, so a flow
+  // with a /32 source that crosses one must stay on a single path.
+  bool splittable(const te::Flow& f, const std::vector<te::Path>& paths) const;
+
+  // Remove every rule and group installed by this actuator.
+  void clear();
+  // A switch went away (or came back with unknown tables): drop its entries
+  // from the shadow so the next install_paths sends them again.
+  void forget_switch(int swid);
+
+  static constexpr uint64_t kCookieBase        = 0x7e00000000000000ULL; // | flow id
+  static constexpr uint32_t kFailoverGroupBase = 0x10000;               // + flow id
+  static constexpr uint32_t kSelectGroupBase   = 0x1000000;             // + (flow id << 8) + k
+  static constexpr uint32_t kMeterBase         = 0x10000;               // + flow id
+  static constexpr uint32_t kMeterBurstMs      = 100;  // burst = rate × 100 ms
+  static constexpr uint16_t kWeightScale       = 100;  // select bucket weights sum to this
+  static constexpr int      kOF10SplitBits     = 3;    // 1.0: up to 2^3 source sub-prefixes
+  static constexpr int      kPrioPath          = 300;  // above L2 learning (100) on single-table switches
+  static constexpr int      kPrioCrankback     = 310;
+
+  // ---- Installed-state shadow ----
+  // What this actuator believes is on the switches; install_paths only sends
+  // the difference, and only what was actually sent is recorded. Persisted
+  // across restarts by StateStore.
+  struct Rule {
+    int swid{0};
+    std::string match, actions;
+    int priority{0};
+    bool operator==(const Rule& o) const {
+      return swid == o.swid && match == o.match && actions == o.actions && priority == o.priority;
+    }
+  };
+  struct Group {
+    int swid{0};
+    uint32_t id{0};
+    GroupType type{GroupType::FastFailover};
+    std::vector<GroupBucket> buckets;
+    bool operator==(const Group& o) const;
+  };
+  struct Meter {
+    int swid{0};
+    uint32_t id{0};
+    MeterBand band;
+    bool operator==(const Meter& o) const {
+      return swid == o.swid && id == o.id && band.type == o.band.type && band.rate_kbps == o.band.rate_kbps &&
+             band.burst_kb == o.band.burst_kb && band.prec_level == o.band.prec_level;
+    }
+  };
+  struct Installed {
+    std::vector<Rule>  rules;
+    std::vector<Group> groups;
+    std::vector<Meter> meters;
+    bool operator==(const Installed& o) const {
+      return rules == o.rules && groups == o.groups && meters == o.meters;
+    }
+  };
+  using Shadow = std::map<int, Installed>;   // flow id -> switch state
+
+  Shadow shadow() const;
+  // Adopt a saved shadow without touching the switches; the next install_paths
+  // reconciles against it, so an unchanged plan costs no flow_mods.
+  void restore_shadow(Shadow s);
+
+private:
+  // (from, to) -> egress port on 'from'
+  using PortMap = std::map<std::pair<int,int>, int>;
+
+  static std::vector<int> node_seq_(const te::Path& p, int s, int d);
+  static std::vector<uint16_t> quantize_(const std::vector<double>& w, uint16_t total);
+  std::pair<std::string, std::string> flow_ips_(const te::Flow& f) const;
+  std::string ip_match_(const te::Flow& f, int in_port, const std::string& src_override = "") const;
+  Installed plan_flow_(const te::Flow& f,
+                       const std::vector<int>& primary,
+                       const std::vector<int>& backup,
+                       const PortMap& port_of) const;
+  Installed plan_split_(const te::Flow& f,
+                        const std::vector<std::pair<std::vector<int>, double>>& parts,
+                        const PortMap& port_of) const;
+  void attach_meter_(const te::Flow& f, Installed& ins) const;
+  void push_(int flow_id, const Installed& want);
+  void remove_(const Installed& gone, Installed* from = nullptr);
+
+  OFController* ctl_;
+  mutable std::mutex mtx_;
+  std::map<int, std::pair<std::string, std::string>> ip_;   // flow id -> (src, dst)
+  Shadow installed_;
+  double meter_headroom_{-1.0};
+  MeterBand::Type meter_band_{MeterBand::Type::Drop};
+};
+
+#endif // HYBRID_ACTUATOR_HPP
@@ -0,0 +1,171 @@
+#include "event_bus.hpp"
+
+#include <iostream>
+
+namespace {
+const char* kind_name(OFEvent::Kind k) {
+  switch (k) {
+    case OFEvent::Kind::SwitchState: return "switch_state";
+    case OFEvent::Kind::PacketIn:    return "packet_in";
+    case OFEvent::Kind::LLDP:        return "lldp";
+    case OFEvent::Kind::Error:       return "error";
+    case OFEvent::Kind::StatsReply:  return "stats_reply";
+    case OFEvent::Kind::LinkDown:    return "link_down";
+    default:                         return "unknown";
+  }
+}
+} // namespace
+
+EventBus::EventBus(size_t capacity, size_t urgent_capacity)
+  : ring_(capacity), urgent_(urgent_capacity), subs_(std::make_shared<const Subs>()) {}
+
+EventBus::~EventBus() { stop(); }
+
+void EventBus::start() {
+  if (running_.exchange(true)) return;
+  consumer_ = std::thread([this]{ consume_(); });
+}
+
+void EventBus::stop() {
+  if (!running_.exchange(false)) return;
+  {
+    std::lock_guard<std::mutex> lk(wake_mtx_);
+    wake_cv_.notify_one();
+  }
+  if (consumer_.joinable()) consumer_.join();
+}
+
+bool EventBus::publish(OFEvent&& e) {
+  const size_t k = size_t(e.kind);
+  // LinkDown 走 urgent ring 會插隊：蓋上發布序號，讓訂閱者認得出比它早收到的 LLDP
+  if (e.kind == OFEvent::Kind::LLDP) e.lldp.seq = seq_.fetch_add(1) + 1;
+  else if (e.kind == OFEvent::Kind::LinkDown) e.link.seq = seq_.fetch_add(1) + 1;
+  auto& ring = (e.kind == OFEvent::Kind::LinkDown) ? urgent_ : ring_;
+  if (!ring.try_push(std::move(e))) {
+    dropped_[k].fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  published_[k].fetch_add(1, std::memory_order_relaxed);
+  // 消費端睡著才需要叫醒（seq_cst 與 consume_ 的 waiting_ 配對，避免漏叫）
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting_.load()) {
+    std::lock_guard<std::mutex> lk(wake_mtx_);
+    wake_cv_.notify_one();
+  }
+  return true;
+}
+
+template <typename F>
+void EventBus::update_subs_(F&& f) {
+  std::lock_guard<std::mutex> lk(subs_mtx_);
+  auto next = std::make_shared<Subs>(*std::atomic_load(&subs_));
+  f(*next);
+  std::atomic_store(&subs_, std::shared_ptr<const Subs>(std::move(next)));
+}
+
+void EventBus::subscribe(OnSwitchState cb) { if (cb) update_subs_([&](Subs& s){ s.sw_state.push_back(std::move(cb)); }); }
+void EventBus::subscribe(OnPacketIn cb)    { if (cb) update_subs_([&](Subs& s){ s.packet_in.push_back(std::move(cb)); }); }
+void EventBus::subscribe(OnLLDP cb)        { if (cb) update_subs_([&](Subs& s){ s.lldp.push_back(std::move(cb)); }); }
+void EventBus::subscribe(OnError cb)       { if (cb) update_subs_([&](Subs& s){ s.error.push_back(std::move(cb)); }); }
+void EventBus::subscribe(OnStatsReply cb)  { if (cb) update_subs_([&](Subs& s){ s.stats.push_back(std::move(cb)); }); }
+void EventBus::subscribe(OnLinkDown cb)    { if (cb) update_subs_([&](Subs& s){ s.link_down.push_back(std::move(cb)); }); }
+void EventBus::set_executor(Executor ex)   { update_subs_([&](Subs& s){ s.executor = std::move(ex); }); }
+
+EventBusStats EventBus::stats() const {
+  EventBusStats st;
+  st.capacity = ring_.capacity() + urgent_.capacity();
+  st.depth    = ring_.size_approx() + urgent_.size_approx();
+  for (size_t k = 0; k < kKinds; ++k) {
+    const uint64_t d = dropped_[k].load(std::memory_order_relaxed);
+    st.published  += published_[k].load(std::memory_order_relaxed);
+    st.dispatched += dispatched_[k].load(std::memory_order_relaxed);
+    st.dropped    += d;
+    st.dropped_by_kind[kind_name(OFEvent::Kind(k))] = d;
+  }
+  return st;
+}
+
+// 每取一個事件前先看優先佇列
+bool EventBus::pop_(OFEvent& e) {
+  if (urgent_.try_pop(e)) { urgent_.publish_consumer_pos(); return true; }
+  if (ring_.try_pop(e))   { ring_.publish_consumer_pos();   return true; }
+  return false;
+}
+
+void EventBus::consume_() {
+  OFEvent e;
+  for (;;) {
+    bool any = false;
+    while (pop_(e)) {
+      any = true;
+      dispatch_(e);
+      dispatched_[size_t(e.kind)].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!running_.load()) {
+      if (!any) break;      // stop() 後把已排隊的事件送完再離開
+      continue;
+    }
+    if (any) continue;
+
+    std::unique_lock<std::mutex> lk(wake_mtx_);
+    waiting_.store(true);
+    // 設 waiting_ 後再檢查一次，與 publish() 的 fence 配對
+    if (pop_(e)) {
+      waiting_.store(false);
+      lk.unlock();
+      dispatch_(e);
+      dispatched_[size_t(e.kind)].fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    wake_cv_.wait_for(lk, std::chrono::milliseconds(50));
+    waiting_.store(false);
+  }
+}
+
+void EventBus::dispatch_(OFEvent& e) {
+  auto subs = std::atomic_load(&subs_);
+  // 每個 callback 各自 catch：一個訂閱者丟例外不影響其他訂閱者
+  auto run = [&](std::function<void()> fn) {
+    auto guarded = [fn = std::move(fn)]{
+      try { fn(); }
+      catch (const std::exception& ex) { std::cerr << "[event_bus] subscriber threw: " << ex.what() << "\n"; }
+      catch (...) { std::cerr << "[event_bus] subscriber threw\n"; }
+    };
+    try {
+      if (subs->executor) subs->executor(std::move(guarded));
+      else guarded();
+    } catch (const std::exception& ex) {
+      std::cerr << "[event_bus] executor threw: " << ex.what() << "\n";
+    }
+  };
+  switch (e.kind) {
+    case OFEvent::Kind::SwitchState:
+      for (const auto& cb : subs->sw_state) run([cb, sw = e.swid, up = e.up]{ cb(sw, up); });
+      break;
+    case OFEvent::Kind::PacketIn: {
+      // payload 由 shared_ptr 持有，executor 非同步執行時仍有效
+      auto buf = std::make_shared<std::vector<uint8_t>>(std::move(e.data));
+      for (const auto& cb : subs->packet_in)
+        run([cb, buf, sw = e.swid, port = e.in_port]{
+          PacketIn pki; pki.swid = sw; pki.in_port = port;
+          pki.data = buf->data(); pki.len = buf->size();
+          cb(pki);
+        });
+      break;
+    }
+    case OFEvent::Kind::LLDP:
+      for (const auto& cb : subs->lldp) run([cb, ev = e.lldp]{ cb(ev); });
+      break;
+    case OFEvent::Kind::Error:
+      for (const auto& cb : subs->error)
+        run([cb, sw = e.swid, t = e.err_type, c = e.err_code, m = e.msg]{ cb(sw, t, c, m); });
+      break;
+    case OFEvent::Kind::StatsReply:
+      for (const auto& cb : subs->stats) run([cb, sw = e.swid]{ cb(sw); });
+      break;
+    case OFEvent::Kind::LinkDown:
+      for (const auto& cb : subs->link_down) run([cb, ev = e.link]{ cb(ev); });
+      break;
+    default: break;
+  }
+}
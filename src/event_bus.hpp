@@ -0,0 +1,173 @@
+#pragma once
+#ifndef HYBRID_EVENT_BUS_HPP
+#define HYBRID_EVENT_BUS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "of_controller.hpp"  // callback types, PacketIn, LLDPEvent, EventBusStats
+
+//
+//  Controller Event Bus
+//  -----------------------------------------------
+//  I/O threads publish into a bounded lock-free MPSC ring; a single consumer
+//  thread drains it and dispatches to subscribers (inline, or through an
+//  executor if one is installed). A full ring drops the event and bumps the
+//  per-kind overflow counter; publishers never block.
+//
+//  Link-down events go through a small second ring that the consumer drains
+//  before every event of the main one, so a failure is never stuck behind a
+//  packet-in burst. LLDP and link-down events are stamped with a shared
+//  publish sequence number, so a subscriber can tell an LLDP received before
+//  the link went down (but delivered after it) from a fresh one.
+//
+
+// Bounded multi-producer / single-consumer ring (Vyukov, sequence per slot).
+template <typename T>
+class MpscRing {
+public:
+  explicit MpscRing(size_t capacity) {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    mask_ = cap - 1;
+    cells_.reset(new Cell[cap]);
+    for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Any thread. Returns false when the ring is full.
+  bool try_push(T&& v) {
+    size_t pos = enq_.load(std::memory_order_relaxed);
+    Cell* c;
+    for (;;) {
+      c = &cells_[pos & mask_];
+      const size_t seq = c->seq.load(std::memory_order_acquire);
+      const intptr_t dif = intptr_t(seq) - intptr_t(pos);
+      if (dif == 0) {
+        if (enq_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = enq_.load(std::memory_order_relaxed);
+      }
+    }
+    c->data = std::move(v);
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer thread only. Returns false when empty.
+  bool try_pop(T& out) {
+    Cell* c = &cells_[deq_ & mask_];
+    const size_t seq = c->seq.load(std::memory_order_acquire);
+    if (intptr_t(seq) - intptr_t(deq_ + 1) < 0) return false;
+    out = std::move(c->data);
+    c->seq.store(deq_ + mask_ + 1, std::memory_order_release);
+    ++deq_;
+    return true;
+  }
+
+  // Approximate (racy) fill level, for metrics only.
+  size_t size_approx() const {
+    const size_t e = enq_.load(std::memory_order_relaxed);
+    const size_t d = deq_seen_.load(std::memory_order_relaxed);
+    return e >= d ? e - d : 0;
+  }
+  void publish_consumer_pos() { deq_seen_.store(deq_, std::memory_order_relaxed); }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq{0};
+    T data{};
+  };
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_{0};
+  alignas(64) std::atomic<size_t> enq_{0};
+  alignas(64) size_t deq_{0};
+  std::atomic<size_t> deq_seen_{0};
+};
+
+// One queued controller event. Packet-in payloads are copied so they stay
+// valid until dispatch.
+struct OFEvent {
+  enum class Kind : uint8_t { SwitchState = 0, PacketIn, LLDP, Error, StatsReply, LinkDown, Count };
+  Kind kind{Kind::SwitchState};
+  int swid{0};
+  bool up{false};                 // SwitchState
+  int in_port{0};                 // PacketIn
+  std::vector<uint8_t> data;      // PacketIn payload
+  LLDPEvent lldp{};               // LLDP
+  LinkDownEvent link{};           // LinkDown
+  uint16_t err_type{0}, err_code{0};
+  std::string msg;                // Error
+};
+
+class EventBus {
+public:
+  using Executor = std::function<void(std::function<void()>)>;
+
+  explicit EventBus(size_t capacity = 8192, size_t urgent_capacity = 256);
+  ~EventBus();
+
+  void start();
+  void stop();   // drains what is already queued, then joins
+
+  // Lock-free; safe from any thread (including while holding controller locks).
+  bool publish(OFEvent&& e);
+
+  void subscribe(OnSwitchState cb);
+  void subscribe(OnPacketIn cb);
+  void subscribe(OnLLDP cb);
+  void subscribe(OnError cb);
+  void subscribe(OnStatsReply cb);
+  void subscribe(OnLinkDown cb);
+
+  // Run callbacks through 'ex' instead of on the consumer thread (empty = inline).
+  void set_executor(Executor ex);
+
+  EventBusStats stats() const;
+
+private:
+  struct Subs {
+    std::vector<OnSwitchState> sw_state;
+    std::vector<OnPacketIn>    packet_in;
+    std::vector<OnLLDP>        lldp;
+    std::vector<OnError>       error;
+    std::vector<OnStatsReply>  stats;
+    std::vector<OnLinkDown>    link_down;
+    Executor                   executor;
+  };
+
+  void consume_();
+  bool pop_(OFEvent& e);
+  void dispatch_(OFEvent& e);
+  template <typename F> void update_subs_(F&& f);
+
+  MpscRing<OFEvent> ring_;
+  MpscRing<OFEvent> urgent_;            // LinkDown only; drained first
+  std::shared_ptr<const Subs> subs_;    // copy-on-write, read via atomic_load
+  std::mutex subs_mtx_;                 // serialises writers only
+
+  std::atomic<uint64_t> seq_{0};        // LLDPEvent::seq / LinkDownEvent::seq
+  std::atomic<bool> running_{false};
+  std::atomic<bool> waiting_{false};
+  std::mutex wake_mtx_;
+  std::condition_variable wake_cv_;
+  std::thread consumer_;
+
+  static constexpr size_t kKinds = size_t(OFEvent::Kind::Count);
+  std::atomic<uint64_t> published_[kKinds]{};
+  std::atomic<uint64_t> dispatched_[kKinds]{};
+  std::atomic<uint64_t> dropped_[kKinds]{};
+};
+
+#endif // HYBRID_EVENT_BUS_HPP
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef HYBRID_EXPIRY_WHEEL_HPP
+#define HYBRID_EXPIRY_WHEEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//
+//  Expiry Timer Wheel
+//  -----------------------------------------------
+//  Hashed timer wheel over integer ticks (slot = tick % slots). The wheel only
+//  finds candidates: the owner keeps the authoritative tick of every key and
+//  checks it with reached(), so a key that was rescheduled simply leaves a
+//  stale copy behind instead of being searched for and removed.
+//
+//  schedule() never places an entry further ahead than one rotation (it is
+//  then looked at early and rescheduled), and advance() reports an entry at
+//  the first visit of its slot at or after its tick. A late advance() that
+//  skips ticks, even by more than a rotation, therefore delays entries but
+//  never loses one.
+//
+template<class Key>
+class ExpiryWheel {
+public:
+  explicit ExpiryWheel(size_t slots) : slots_(std::max<size_t>(slots, 1)) {}
+
+  size_t size() const { return slots_.size(); }
+  int64_t done() const { return done_; }   // last tick already processed
+
+  // Tick the entry was placed on: 'due', clamped to the ticks not yet processed
+  // and at most one rotation ahead.
+  int64_t schedule(const Key& k, int64_t due) {
+    const int64_t t = std::clamp(due, done_ + 1, done_ + int64_t(slots_.size()));
+    slots_[slot_(t)].push_back(k);
+    return t;
+  }
+
+  // Process every tick up to 'now'; f(key, t) for each entry in the slot of t.
+  // f may schedule again: those entries land on ticks after t.
+  template<class F> void advance(int64_t now, F&& f) {
+    // A gap longer than one rotation still visits every slot exactly once
+    const int64_t from = std::max(done_ + 1, now - int64_t(slots_.size()) + 1);
+    for (int64_t t = from; t <= now; ++t) {
+      done_ = t;
+      auto due = std::move(slots_[slot_(t)]);
+      slots_[slot_(t)].clear();
+      for (const auto& k : due) f(k, t);
+    }
+    done_ = std::max(done_, now);
+  }
+
+  // Whether an entry placed on 'tick' is due when its slot is visited at t
+  bool reached(int64_t tick, int64_t t) const {
+    return tick <= t && (t - tick) % int64_t(slots_.size()) == 0;
+  }
+
+private:
+  size_t slot_(int64_t t) const { return size_t(t % int64_t(slots_.size())); }
+
+  std::vector<std::vector<Key>> slots_;
+  int64_t done_{0};
+};
+
+#endif // HYBRID_EXPIRY_WHEEL_HPP
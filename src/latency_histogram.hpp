@@ -0,0 +1,85 @@
+#pragma once
+#ifndef HYBRID_LATENCY_HISTOGRAM_HPP
+#define HYBRID_LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+//
+//  Log-linear latency histogram (HdrHistogram-style)
+//  -----------------------------------------------
+//  Values are recorded in microseconds. Each power of two is split into 8
+//  linear sub-buckets, so any reported quantile is within ~12.5% of the
+//  true value. Fixed size (no allocation), cheap to copy and merge.
+//
+class LatencyHistogram {
+public:
+  static constexpr int kSubBits    = 3;
+  static constexpr int kSubBuckets = 1 << kSubBits;
+  static constexpr int kBuckets    = (64 - kSubBits + 1) * kSubBuckets;
+
+  void record(uint64_t us) {
+    ++counts_[index_of(us)];
+    ++count_;
+    sum_ += us;
+    min_ = std::min(min_, us);
+    max_ = std::max(max_, us);
+  }
+
+  void merge(const LatencyHistogram& o) {
+    for (int i = 0; i < kBuckets; ++i) counts_[i] += o.counts_[i];
+    count_ += o.count_;
+    sum_   += o.sum_;
+    min_ = std::min(min_, o.min_);
+    max_ = std::max(max_, o.max_);
+  }
+
+  void reset() { *this = LatencyHistogram{}; }
+
+  uint64_t count() const { return count_; }
+  uint64_t min()   const { return count_ ? min_ : 0; }
+  uint64_t max()   const { return max_; }
+  double   mean()  const { return count_ ? double(sum_) / double(count_) : 0.0; }
+
+  // q in [0,1]; returns the upper edge of the bucket holding the q-th sample,
+  // clamped to the observed [min, max].
+  uint64_t quantile(double q) const {
+    if (count_ == 0) return 0;
+    q = std::clamp(q, 0.0, 1.0);
+    const uint64_t rank = std::max<uint64_t>(1, uint64_t(q * double(count_) + 0.5));
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += counts_[i];
+      if (seen >= rank) return std::clamp(upper_of(i), min(), max_);
+    }
+    return max_;
+  }
+
+private:
+  static int index_of(uint64_t v) {
+    if (v < kSubBuckets) return int(v);
+    const int e = 63 - __builtin_clzll(v);                       // floor(log2 v) >= kSubBits
+    const int sub = int((v >> (e - kSubBits)) & (kSubBuckets - 1));
+    return (e - kSubBits + 1) * kSubBuckets + sub;
+  }
+  static uint64_t lower_of(int idx) {
+    if (idx < kSubBuckets) return uint64_t(idx);
+    const int e = idx / kSubBuckets + kSubBits - 1;
+    const int sub = idx % kSubBuckets;
+    return uint64_t(kSubBuckets + sub) << (e - kSubBits);
+  }
+  static uint64_t upper_of(int idx) {
+    if (idx + 1 >= kBuckets) return std::numeric_limits<uint64_t>::max();
+    return lower_of(idx + 1) - 1;
+  }
+
+  std::array<uint32_t, kBuckets> counts_{};
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  uint64_t min_{std::numeric_limits<uint64_t>::max()};
+  uint64_t max_{0};
+};
+
+#endif // HYBRID_LATENCY_HISTOGRAM_HPP
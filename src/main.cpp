@@ -1,20 +1,73 @@
 #include "HybridSDNApp.hpp"
-#define FD_SETSIZE 4096
-#include <sys/select.h>
-	
+#include "shard.hpp"
+
+#include <csignal>
+#include <pthread.h>
+#include <thread>
+
+// SIGINT / SIGTERM → app.stop()，run() 存完快照才返回。
+// 訊號在建立 app 執行緒之前就擋下，只由專屬執行緒的 sigwait 收，stop() 不必是 async-signal-safe
+class StopOnSignal {
+public:
+  explicit StopOnSignal(HybridSDNApp& app) {
+    sigemptyset(&set_);
+    sigaddset(&set_, SIGINT);
+    sigaddset(&set_, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &set_, nullptr);
+    th_ = std::thread([this, &app]{
+      int sig = 0;
+      sigwait(&set_, &sig);
+      if (!done_) std::cerr << "[HybridOF] signal " << sig << ", stopping\n";
+      app.stop();
+    });
+  }
+  ~StopOnSignal() {
+    done_ = true;
+    pthread_kill(th_.native_handle(), SIGTERM);   // run() 自己結束時叫醒 sigwait
+    th_.join();
+  }
+private:
+  sigset_t set_{};
+  std::atomic<bool> done_{false};
+  std::thread th_;
+};
+
+// hybrid_of [port] [--shards K]
 int main(int argc, char** argv){
-  uint16_t port = (argc>1)? static_cast<uint16_t>(std::atoi(argv[1])) : 6633;
+  uint16_t port = 6633;
+  int shards = 1;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--shards" && i + 1 < argc) shards = std::max(1, std::atoi(argv[++i]));
+    else port = static_cast<uint16_t>(std::atoi(argv[i]));
+  }
   HybridSDNApp::Paths paths;
    paths.graph_json = "config/NSFNET.json";
    paths.flows_csv  = "config/flows.csv";
+   paths.state_file = "hybrid_of.state";
+   paths.journal_file = "hybrid_of.journal";
+
+  // 多行程：supervisor fork K 個 worker，各自跑一份 app；快照檔依 shard 分開
+  if (shards > 1) {
+    ShardSupervisor sup(shards);
+    return sup.run([&](ShardContext& ctx) {
+      HybridSDNApp::Paths p = paths;
+      p.state_file += ".shard" + std::to_string(ctx.index());
+      p.journal_file += ".shard" + std::to_string(ctx.index());
+      HybridSDNApp app(port, p, &ctx);
+      StopOnSignal sig(app);
+      app.run();
+      return 0;
+    });
+  }
 
   try {
     HybridSDNApp app(port, paths);
-    app.run();                    // blocks until you externally stop / signal
+    StopOnSignal sig(app);
+    app.run();                    // blocks until SIGINT / SIGTERM
   } catch (const std::exception& ex) {
     std::cerr << "[fatal] " << ex.what() << "\n";
     return 1;
   }
   return 0;
 }
-
@@ -54,7 +54,7 @@ bool MILP_TE::solve(const Weights& w, TE_Output* out, double time_limit_sec) {
   CoinPackedMatrix mat(false, 0, 0);
   std::vector<double> rowLower, rowUpper;
 
-  // 1) 每個 flow 恰選一條 path：sum_p x_{f,p} = 1
+  // 1) 每個 flow 恰選一條 path（可分割時為份額和）：sum_p x_{f,p} = 1
   for (const auto& fk : F_) {
     const auto& f = fk.second;
     CoinPackedVector row;
@@ -94,19 +94,35 @@ bool MILP_TE::solve(const Weights& w, TE_Output* out, double time_limit_sec) {
   // 載入到求解器
   OsiClpSolverInterface si;
   std::vector<double> colLower(ncols, 0.0), colUpper(ncols, 1.0);
+  for (const auto& e : G_.keep_on)
+    if (auto it = be_col_.find(e); it != be_col_.end()) colLower[it->second] = 1.0;
   si.setObjSense(1.0); // minimize
   si.loadProblem(mat, colLower.data(), colUpper.data(),
                  obj.data(), rowLower.data(), rowUpper.data());
 
-  // 整數變數（x 與 β）
+  // 整數變數（x 與 β；可分割時 x 為連續，但標為不可分割的 flow 仍為 0/1）
   std::vector<int> intIdx; intIdx.reserve(x_col_.size()+be_col_.size());
-  for (const auto& kv : x_col_)  intIdx.push_back(kv.second);
+  for (const auto& kv : x_col_)
+    if (!splittable_ || !F_.at(kv.first.f).splittable) intIdx.push_back(kv.second);
+  const size_t x_int = intIdx.size();
   for (const auto& kv : be_col_) intIdx.push_back(kv.second);
   if (!intIdx.empty()) si.setInteger(intIdx.data(), (int)intIdx.size());
 
   // CBC
   CbcModel model(si);
   if (time_limit_sec > 0.0) model.setMaximumSeconds(time_limit_sec);
+  // 分支順序：依整數欄位由小到大（先 x 再 β）給優先度，數字小者先分支
+  if (!G_.beta_priority.empty()) {
+    const int after = int(G_.beta_priority.size()) + 1;
+    std::vector<int> prio;
+    prio.reserve(intIdx.size());
+    prio.insert(prio.end(), x_int, after + 1);
+    for (const auto& e : be_index_) {
+      auto it = G_.beta_priority.find(e);
+      prio.push_back(it == G_.beta_priority.end() ? after : it->second);
+    }
+    model.passInPriorities(prio.data(), false);
+  }
   model.setLogLevel(1);
   model.setIntegerTolerance(1e-6);
   model.branchAndBound();
@@ -126,16 +142,21 @@ bool MILP_TE::solve(const Weights& w, TE_Output* out, double time_limit_sec) {
     else           out->beta[e] = 1;
   }
 
-  // 每個 flow 選到的 path
+  // 每個 flow 選到的 path 與份額（去掉數值雜訊後重新正規化）
   out->chosen_path.clear();
+  out->split.clear();
   for (const auto& fk : F_) {
     const auto& f = fk.second;
-    int best_pid = -1; double best = -1.0;
+    int best_pid = -1; double best = -1.0, sum = 0.0;
+    auto& sp = out->split[f.id];
     for (int pid : f.cand_path_ids) {
       double val = sol[x_col_.at({f.id, pid})];
       if (val > best) { best = val; best_pid = pid; }
+      if (val > 1e-6) { sp[pid] = val; sum += val; }
     }
     out->chosen_path[f.id] = best_pid;
+    if (sum > 0.0) for (auto& kv : sp) kv.second /= sum;
+    else if (best_pid >= 0) sp[best_pid] = 1.0;
   }
 
   // link 負載
@@ -25,6 +25,7 @@ struct Flow {
   int s{0}, d{0};
   double demand_mbps{0.0};      // 流量需求
   std::vector<int> cand_path_ids; // 候選路徑 id
+  bool splittable{true};        // false：可分割模式下也只選一條（資料平面切不開，見 Actuator::splittable）
 };
 
 struct GraphCaps {
@@ -33,6 +34,11 @@ struct GraphCaps {
   std::map<LinkId, bool>   is_sdn;         // SDN link 才有 β_e 決策；legacy 固定 1
   std::map<LinkId, double> power_cost;     // P_e（能耗權重；可自定）
 
+  // 結構提示（見 topo_metrics.hpp）：keep_on 的 β 固定 1（bridge，關掉就斷網）；
+  // beta_priority 小者先分支，未列出的 β 在其後，x 最後
+  std::set<LinkId> keep_on;
+  std::map<LinkId, int> beta_priority;
+
   double cap(const LinkId& e) const {
     auto it = capacity_mbps.find(e);
     return it==capacity_mbps.end()? 0.0 : it->second;
@@ -51,7 +57,8 @@ struct GraphCaps {
 struct Weights { double ewr{0.5}; double lwr{0.5}; };
 
 struct TE_Output {
-  std::map<int /*flow_id*/, int /*chosen_path_id*/> chosen_path;
+  std::map<int /*flow_id*/, int /*chosen_path_id*/> chosen_path;   // 最大份額的 path
+  std::map<int /*flow_id*/, std::map<int /*path_id*/, double>> split; // 各 path 份額（和為 1；不可分割時只有一條）
   std::map<LinkId, int /*0/1*/> beta;      // link 開關（legacy 預設 1）
   std::map<LinkId, double> load_mbps;      // 各 link 的負載
   double objective{0.0};
@@ -66,6 +73,9 @@ public:
           const std::vector<Path>& paths,
           const std::vector<Flow>& flows);
 
+  // 可分割路由：x_{f,p} 放寬為 [0,1] 連續（β 仍為 0/1），份額寫入 TE_Output::split
+  void set_splittable(bool on) { splittable_ = on; }
+
   // 求解；time_limit_sec=0 表示不限時
   bool solve(const Weights& w, TE_Output* out, double time_limit_sec = 0.0);
 
@@ -89,6 +99,7 @@ private:
 
 private:
   const GraphCaps G_;
+  bool splittable_{false};
   std::map<int, Path> P_;
   std::map<int, Flow> F_;
   std::vector<LinkId> links_;
@@ -39,7 +39,14 @@ Monitor::Monitor(OFController* ctl,
                  std::chrono::milliseconds period)
   : ctl_(ctl),
     cap_mbps_(std::move(capacity_mbps)),
-    period_(period) {}
+    period_(period) {
+  ctl_->on_stats_reply([this](int swid){
+    if (!running_.load()) return;
+    std::lock_guard<std::mutex> lk(wake_mtx_);
+    dirty_swids_.insert(swid);
+    wake_cv_.notify_one();
+  });
+}
 
 Monitor::~Monitor() { stop(); }
 
@@ -59,7 +66,11 @@ Monitor::compute_rates_and_update(const std::map<LinkId, PortStats>& now) {
     uint64_t drx = 0, dtx = 0;
 
     if (last.valid) {
-      dt  = std::chrono::duration<double>(tnow - last.t).count();
+      // OF1.3 回報埠存活時間：以 switch 端的時間差計算，不受 controller 排程抖動影響
+      if (ps.duration_ns > last.duration_ns && last.duration_ns > 0)
+        dt = double(ps.duration_ns - last.duration_ns) / 1e9;
+      else
+        dt = std::chrono::duration<double>(tnow - last.t).count();
       drx = (ps.rx_bytes >= last.rx_bytes) ? (ps.rx_bytes - last.rx_bytes) : 0;
       dtx = (ps.tx_bytes >= last.tx_bytes) ? (ps.tx_bytes - last.tx_bytes) : 0;
     }
@@ -67,6 +78,7 @@ Monitor::compute_rates_and_update(const std::map<LinkId, PortStats>& now) {
     // Update last counters
     last.rx_bytes = ps.rx_bytes;
     last.tx_bytes = ps.tx_bytes;
+    last.duration_ns = ps.duration_ns;
     last.t = tnow;
     last.valid = true;
 
@@ -110,24 +122,35 @@ void Monitor::start() {
   ctl_->set_stats_period(period_);
 
   bg_ = std::thread([this](){
-    auto next = Clock::now();
     while (running_.load()) {
-      auto now = Clock::now();
-      if (now >= next) {
-        try {
-          (void)sample_once();
-        } catch (const std::exception& e) {
-          std::cerr << "[monitor] sample_once error: " << e.what() << "\n";
+      std::set<int> dirty;
+      {
+        std::unique_lock<std::mutex> lk(wake_mtx_);
+        wake_cv_.wait_for(lk, period_, [this]{ return !dirty_swids_.empty() || !running_.load(); });
+        dirty.swap(dirty_swids_);
+      }
+      if (dirty.empty()) continue;
+      try {
+        // 只更新有回覆的 switch，避免把尚未更新的計數誤算成 0 Mbps
+        auto counters = ctl_->port_stats_snapshot();
+        for (auto it = counters.begin(); it != counters.end(); ) {
+          if (!dirty.count(it->first.u)) it = counters.erase(it);
+          else ++it;
         }
-        next = now + period_;
+        (void)compute_rates_and_update(counters);
+      } catch (const std::exception& e) {
+        std::cerr << "[monitor] sample error: " << e.what() << "\n";
       }
-      std::this_thread::sleep_for(std::chrono::milliseconds(20));
     }
   });
 }
 
 void Monitor::stop() {
   if (!running_.exchange(false)) return;
+  {
+    std::lock_guard<std::mutex> lk(wake_mtx_);
+    wake_cv_.notify_one();
+  }
   if (bg_.joinable()) bg_.join();
 }
 
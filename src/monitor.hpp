@@ -4,10 +4,12 @@
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <functional>
 #include <map>
 #include <mutex>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -44,7 +46,9 @@ public:
   // Take one synchronous sample now; returns per-link datapoints.
   std::vector<Sample> sample_once();
 
-  // Start/stop background periodic sampling into internal time series.
+  // Start/stop background sampling into internal time series. The background
+  // thread is driven by the controller's stats replies (on_stats_reply) and
+  // only recomputes links of switches that actually replied.
   void start();
   void stop();
 
@@ -72,6 +76,7 @@ private:
   struct LastCounter {
     uint64_t rx_bytes{0};
     uint64_t tx_bytes{0};
+    uint64_t duration_ns{0};  // switch-side port age (OF1.3), 0 = unknown
     Clock::time_point t{};
     bool valid{false};
   };
@@ -94,9 +99,12 @@ private:
   std::map<LinkId, LinkRate> last_rates_;
   std::map<LinkId, std::vector<Sample>> series_; // append-only time series per link
 
-  // Background thread
+  // Background thread (woken by on_stats_reply)
   std::atomic<bool> running_{false};
   std::thread bg_;
+  std::mutex wake_mtx_;
+  std::condition_variable wake_cv_;
+  std::set<int> dirty_swids_;
 };
 
 #endif // HYBRID_MONITOR_HPP
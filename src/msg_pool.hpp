@@ -0,0 +1,92 @@
+#pragma once
+#ifndef HYBRID_MSG_POOL_HPP
+#define HYBRID_MSG_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//
+//  Message Buffer Pool
+//  -----------------------------------------------
+//  Per-reactor free list of byte buffers shared by the OpenFlow encoders, the
+//  per-connection receive buffers and multipart reassembly. A buffer keeps its
+//  capacity when it is returned, so once the pool is warm, encoding or
+//  receiving a message does not touch the allocator.
+//
+//  Fresh buffers reserve kSlabSize, which covers every control message this
+//  controller sends. Buffers that had to grow past kMaxPooled (large
+//  packet-outs, big multipart bodies) are freed on release rather than kept,
+//  so one burst cannot pin memory.
+//
+//  Not thread-safe: a pool belongs to one reactor and is used under its lock.
+//
+class MsgPool {
+public:
+  static constexpr size_t kSlabSize  = 2048;
+  static constexpr size_t kMaxPooled = 64 * 1024;
+  static constexpr size_t kMaxFree   = 1024;
+
+  struct Stats {
+    uint64_t acquired{0};
+    uint64_t reused{0};        // served from the free list
+    uint64_t oversize{0};      // released buffers freed because they outgrew kMaxPooled
+    size_t   free{0};
+  };
+
+  // RAII handle: an empty buffer on acquire, returned to the pool on destruction.
+  class Lease {
+  public:
+    Lease() = default;
+    Lease(Lease&& o) noexcept : pool_(std::exchange(o.pool_, nullptr)), buf_(std::move(o.buf_)) {}
+    Lease& operator=(Lease&& o) noexcept {
+      if (this != &o) { give_back_(); pool_ = std::exchange(o.pool_, nullptr); buf_ = std::move(o.buf_); }
+      return *this;
+    }
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    ~Lease() { give_back_(); }
+
+    std::vector<uint8_t>& operator*()  { return buf_; }
+    std::vector<uint8_t>* operator->() { return &buf_; }
+    const std::vector<uint8_t>& operator*()  const { return buf_; }
+    const std::vector<uint8_t>* operator->() const { return &buf_; }
+
+  private:
+    friend class MsgPool;
+    Lease(MsgPool* p, std::vector<uint8_t>&& b) : pool_(p), buf_(std::move(b)) {}
+    void give_back_() { if (pool_) { pool_->release_(std::move(buf_)); pool_ = nullptr; } }
+
+    MsgPool* pool_{nullptr};
+    std::vector<uint8_t> buf_;
+  };
+
+  Lease acquire() {
+    ++stats_.acquired;
+    std::vector<uint8_t> b;
+    if (!free_.empty()) {
+      b = std::move(free_.back());
+      free_.pop_back();
+      ++stats_.reused;
+    } else {
+      b.reserve(kSlabSize);
+    }
+    return Lease(this, std::move(b));
+  }
+
+  Stats stats() const { Stats s = stats_; s.free = free_.size(); return s; }
+
+private:
+  void release_(std::vector<uint8_t>&& b) {
+    if (b.capacity() > kMaxPooled) { ++stats_.oversize; return; }
+    if (free_.size() >= kMaxFree) return;
+    b.clear();
+    free_.push_back(std::move(b));
+  }
+
+  std::vector<std::vector<uint8_t>> free_;
+  Stats stats_;
+};
+
+#endif // HYBRID_MSG_POOL_HPP
@@ -0,0 +1,552 @@
+#pragma once
+#ifndef HYBRID_OF_CODEC_HPP
+#define HYBRID_OF_CODEC_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+//
+//  OpenFlow Wire Codec
+//  -----------------------------------------------
+//  OF1.0 / OF1.3 wire structures plus the small layer te_controller.cpp uses
+//  to read and write them:
+//
+//    Bytes     bounds-checked read-only view over received bytes (no copy)
+//    View<T>   typed view of a packed struct inside a Bytes; get(&T::field)
+//              returns the field in host order
+//    Out<T>    appends a T to an output buffer; set(&T::field, v) stores
+//              big-endian, close() patches header length and xid
+//    make<T,Type>()  constexpr fixed-size message with the header filled in
+//
+//  Everything is header-only and constexpr where the language allows, so the
+//  encoders inline down to stores of pre-swapped constants. Struct sizes are
+//  static_assert'ed against the spec below.
+//
+namespace of {
+
+// -----------------------------
+// OpenFlow 1.0 wire structures
+// -----------------------------
+#pragma pack(push, 1)
+struct ofp_header { uint8_t version, type; uint16_t length; uint32_t xid; };
+
+enum {
+  OFP_VERSION = 0x01,
+  OFPT_HELLO=0, OFPT_ERROR, OFPT_ECHO_REQUEST, OFPT_ECHO_REPLY, OFPT_VENDOR,
+  OFPT_FEATURES_REQUEST, OFPT_FEATURES_REPLY, OFPT_GET_CONFIG_REQUEST,
+  OFPT_GET_CONFIG_REPLY, OFPT_SET_CONFIG, OFPT_PACKET_IN, OFPT_FLOW_REMOVED,
+  OFPT_PORT_STATUS, OFPT_PACKET_OUT, OFPT_FLOW_MOD, OFPT_PORT_MOD,
+  OFPT_STATS_REQUEST=16, OFPT_STATS_REPLY=17, OFPT_BARRIER_REQUEST=18, OFPT_BARRIER_REPLY=19
+};
+
+struct ofp_switch_features {
+  ofp_header header;
+  uint64_t datapath_id;
+  uint32_t n_buffers;
+  uint8_t  n_tables; uint8_t pad[3];
+  uint32_t capabilities;
+  uint32_t actions;
+  // ofp_phy_port ports[]...
+};
+
+struct ofp_phy_port {
+  uint16_t port_no;
+  uint8_t  hw_addr[6];
+  char     name[16];
+  uint32_t config;
+  uint32_t state;
+  uint32_t curr;        // current features (OFPPF_*)
+  uint32_t advertised;  // features being advertised by the port
+  uint32_t supported;
+  uint32_t peer;
+};
+
+struct ofp_port_status {
+  ofp_header header;
+  uint8_t  reason; uint8_t pad[7];
+  ofp_phy_port desc;
+};
+
+enum { OFPPR_ADD=0, OFPPR_DELETE=1, OFPPR_MODIFY=2 };
+
+struct ofp_switch_config {
+  ofp_header header;
+  uint16_t flags;
+  uint16_t miss_send_len;
+};
+
+struct ofp_match {
+  uint32_t wildcards;
+  uint16_t in_port;
+  uint8_t  dl_src[6], dl_dst[6];
+  uint16_t dl_vlan;
+  uint8_t  dl_vlan_pcp; uint8_t pad1;
+  uint16_t dl_type;
+  uint8_t  nw_tos, nw_proto; uint8_t pad2[2];
+  uint8_t  nw_src[4], nw_dst[4];
+  uint16_t tp_src, tp_dst;
+};
+
+enum {
+  OFPFW_IN_PORT     = 1<<0,
+  OFPFW_DL_VLAN     = 1<<1,
+  OFPFW_DL_SRC      = 1<<2,
+  OFPFW_DL_DST      = 1<<3,
+  OFPFW_DL_TYPE     = 1<<4,
+  OFPFW_NW_PROTO    = 1<<5,
+  OFPFW_TP_SRC      = 1<<6,
+  OFPFW_TP_DST      = 1<<7,
+  OFPFW_NW_SRC_SHIFT = 8,   // 6-bit 欄位：被 wildcard 的低位數（>=32 = 全部）
+  OFPFW_NW_DST_SHIFT = 14,
+  OFPFW_DL_VLAN_PCP = 1<<20,
+  OFPFW_NW_TOS      = 1<<21,
+};
+
+struct ofp_action_output { uint16_t type, len; uint16_t port, max_len; };
+enum { OFPAT_OUTPUT = 0 };
+
+struct ofp_flow_mod {
+  ofp_header header;
+  ofp_match match;
+  uint64_t cookie;
+  uint16_t command;
+  uint16_t idle_timeout, hard_timeout;
+  uint16_t priority;
+  uint32_t buffer_id;
+  uint16_t out_port;
+  uint16_t flags;
+};
+
+enum {
+  OFPFC_ADD=0, OFPFC_MODIFY=1, OFPFC_MODIFY_STRICT=2,
+  OFPFC_DELETE=3, OFPFC_DELETE_STRICT=4
+};
+
+struct ofp_packet_out {
+  ofp_header header;
+  uint32_t buffer_id;
+  uint16_t in_port;
+  uint16_t actions_len;
+  // actions...
+  // payload...
+};
+
+struct ofp_packet_in {
+  ofp_header header;
+  uint32_t buffer_id;
+  uint16_t total_len;
+  uint16_t in_port;
+  uint8_t  reason; uint8_t pad;
+  // frame...
+};
+
+struct ofp_stats_request {
+  ofp_header header;
+  uint16_t type;
+  uint16_t flags;
+  // body...
+};
+
+struct ofp_stats_reply {
+  ofp_header header;
+  uint16_t type;
+  uint16_t flags;
+  // body...
+};
+
+enum { OFPST_DESC=0, OFPST_FLOW=1, OFPST_AGGREGATE=2, OFPST_TABLE=3, OFPST_PORT=4 };
+enum { OFPSF_REPLY_MORE = 1<<0 };
+
+struct ofp_port_stats_request { uint16_t port_no; uint8_t pad[6]; };
+
+struct ofp_port_stats {
+  uint16_t port_no; uint8_t pad[6];
+  uint64_t rx_packets, tx_packets, rx_bytes, tx_bytes;
+  uint64_t rx_dropped, tx_dropped, rx_errors, tx_errors;
+  uint64_t rx_frame_err, rx_over_err, rx_crc_err, collisions;
+};
+
+struct ofp_port_mod {
+  ofp_header header;
+  uint16_t port_no;
+  uint8_t  hw_addr[6];
+  uint32_t config, mask;
+  uint32_t advertise;
+  uint8_t  pad[4];
+};
+
+enum { OFPPC_PORT_DOWN = 1<<0 };
+enum { OFPPS_LINK_DOWN = 1<<0 };
+enum { OFPP_MAX = 0xff00, OFPP_NONE = 0xffff, OFPP_CONTROLLER = 0xfffd, OFPP_FLOOD = 0xfffb };
+enum {
+  OFPPF_10MB_HD  = 1<<0,  OFPPF_10MB_FD  = 1<<1,
+  OFPPF_100MB_HD = 1<<2,  OFPPF_100MB_FD = 1<<3,
+  OFPPF_1GB_HD   = 1<<4,  OFPPF_1GB_FD   = 1<<5,
+  OFPPF_10GB_FD  = 1<<6,
+};
+
+// -----------------------------
+// OpenFlow 1.3 wire structures
+// （ofp_header 與 0..14 號訊息型別和 1.0 相同；之後的型別號碼不同）
+// -----------------------------
+enum {
+  OFP13_VERSION = 0x04,
+  OFPT13_GROUP_MOD = 15, OFPT13_PORT_MOD = 16,
+  OFPT13_MULTIPART_REQUEST = 18, OFPT13_MULTIPART_REPLY = 19,
+  OFPT13_BARRIER_REQUEST = 20,   OFPT13_BARRIER_REPLY = 21,
+  OFPT13_METER_MOD = 29,
+};
+
+struct ofp_hello_elem_header { uint16_t type, length; };
+enum { OFPHET_VERSIONBITMAP = 1 };
+enum { OFPET_HELLO_FAILED = 0, OFPHFC_INCOMPATIBLE = 0 };
+
+struct ofp13_switch_features {
+  ofp_header header;
+  uint64_t datapath_id;
+  uint32_t n_buffers;
+  uint8_t  n_tables; uint8_t auxiliary_id; uint8_t pad[2];
+  uint32_t capabilities;
+  uint32_t reserved;
+  // 1.3 不再附埠清單，改用 OFPMP_PORT_DESC
+};
+
+struct ofp13_port {
+  uint32_t port_no; uint8_t pad[4];
+  uint8_t  hw_addr[6]; uint8_t pad2[2];
+  char     name[16];
+  uint32_t config, state;
+  uint32_t curr, advertised, supported, peer;
+  uint32_t curr_speed, max_speed;   // kbps
+};
+
+struct ofp13_port_status {
+  ofp_header header;
+  uint8_t  reason; uint8_t pad[7];
+  ofp13_port desc;
+};
+
+struct ofp13_multipart_request {
+  ofp_header header;
+  uint16_t type, flags;
+  uint8_t  pad[4];
+  // body...
+};
+struct ofp13_multipart_reply {
+  ofp_header header;
+  uint16_t type, flags;
+  uint8_t  pad[4];
+  // body...
+};
+enum { OFPMP_PORT_STATS = 4, OFPMP_PORT_DESC = 13 };
+
+struct ofp13_port_stats_request { uint32_t port_no; uint8_t pad[4]; };
+
+struct ofp13_port_stats {
+  uint32_t port_no; uint8_t pad[4];
+  uint64_t rx_packets, tx_packets, rx_bytes, tx_bytes;
+  uint64_t rx_dropped, tx_dropped, rx_errors, tx_errors;
+  uint64_t rx_frame_err, rx_over_err, rx_crc_err, collisions;
+  uint32_t duration_sec, duration_nsec;
+};
+
+struct ofp13_match_header { uint16_t type, length; /* oxm_fields..., pad to 8 */ };
+enum { OFPMT_OXM = 1 };
+enum { OFPXMC_OPENFLOW_BASIC = 0x8000 };
+enum {
+  OFPXMT_IN_PORT = 0, OFPXMT_ETH_DST = 3, OFPXMT_ETH_SRC = 4, OFPXMT_ETH_TYPE = 5,
+  OFPXMT_IP_PROTO = 10, OFPXMT_IPV4_SRC = 11, OFPXMT_IPV4_DST = 12,
+  OFPXMT_TCP_SRC = 13, OFPXMT_TCP_DST = 14, OFPXMT_UDP_SRC = 15, OFPXMT_UDP_DST = 16,
+};
+
+struct ofp13_flow_mod {
+  ofp_header header;
+  uint64_t cookie, cookie_mask;
+  uint8_t  table_id, command;
+  uint16_t idle_timeout, hard_timeout;
+  uint16_t priority;
+  uint32_t buffer_id;
+  uint32_t out_port, out_group;
+  uint16_t flags; uint8_t pad[2];
+  // ofp_match (variable), instructions...
+};
+
+struct ofp13_instruction_actions     { uint16_t type, len; uint8_t pad[4]; /* actions... */ };
+struct ofp13_instruction_goto_table  { uint16_t type, len; uint8_t table_id; uint8_t pad[3]; };
+struct ofp13_instruction_meter       { uint16_t type, len; uint32_t meter_id; };
+enum { OFPIT_GOTO_TABLE = 1, OFPIT_APPLY_ACTIONS = 4, OFPIT_METER = 6 };
+
+struct ofp13_action_output { uint16_t type, len; uint32_t port; uint16_t max_len; uint8_t pad[6]; };
+struct ofp13_action_group  { uint16_t type, len; uint32_t group_id; };
+enum { OFPAT13_GROUP = 22 };
+
+struct ofp13_group_mod {
+  ofp_header header;
+  uint16_t command;
+  uint8_t  type; uint8_t pad;
+  uint32_t group_id;
+  // ofp13_bucket buckets[]...
+};
+struct ofp13_bucket {
+  uint16_t len, weight;
+  uint32_t watch_port, watch_group;
+  uint8_t  pad[4];
+  // actions...
+};
+struct ofp13_meter_mod {
+  ofp_header header;
+  uint16_t command, flags;
+  uint32_t meter_id;
+  // ofp13_meter_band bands[]...
+};
+// drop 與 dscp_remark 的 band 都是 16 bytes（dscp_remark 的 pad 首位元組放 prec_level）
+struct ofp13_meter_band {
+  uint16_t type, len;
+  uint32_t rate, burst_size;
+  uint8_t  prec_level; uint8_t pad[3];
+};
+enum { OFPMF_KBPS = 1 << 0, OFPMF_BURST = 1 << 2 };
+enum { OFPCML_NO_BUFFER = 0xffff };
+
+struct ofp13_packet_out {
+  ofp_header header;
+  uint32_t buffer_id;
+  uint32_t in_port;
+  uint16_t actions_len; uint8_t pad[6];
+  // actions..., payload...
+};
+
+struct ofp13_packet_in {
+  ofp_header header;
+  uint32_t buffer_id;
+  uint16_t total_len;
+  uint8_t  reason, table_id;
+  uint64_t cookie;
+  // ofp_match (variable), pad[2], frame...
+};
+
+struct ofp13_port_mod {
+  ofp_header header;
+  uint32_t port_no; uint8_t pad[4];
+  uint8_t  hw_addr[6]; uint8_t pad2[2];
+  uint32_t config, mask;
+  uint32_t advertise; uint8_t pad3[4];
+};
+
+enum { OFPPF13_40GB_FD = 1<<7, OFPPF13_100GB_FD = 1<<8, OFPPF13_1TB_FD = 1<<9 };
+// 本 controller 的 ECHO_REQUEST：payload 為 8-byte 發送時間（steady_clock ns）
+struct ofp_echo_stamp { ofp_header header; uint64_t ts_ns; };
+
+constexpr uint32_t OFPP13_MAX        = 0xffffff00u;
+constexpr uint32_t OFPP13_CONTROLLER = 0xfffffffdu;
+constexpr uint32_t OFPP13_ANY        = 0xffffffffu;
+constexpr uint32_t OFPG13_ANY        = 0xffffffffu;
+constexpr uint32_t OFP_NO_BUFFER     = 0xffffffffu;
+#pragma pack(pop)
+
+static_assert(sizeof(ofp_header)            == 8,   "ofp_header");
+static_assert(sizeof(ofp_switch_features)   == 32,  "ofp_switch_features");
+static_assert(sizeof(ofp_phy_port)          == 48,  "ofp_phy_port");
+static_assert(sizeof(ofp_port_status)       == 64,  "ofp_port_status");
+static_assert(sizeof(ofp_switch_config)     == 12,  "ofp_switch_config");
+static_assert(sizeof(ofp_match)             == 40,  "ofp_match");
+static_assert(sizeof(ofp_action_output)     == 8,   "ofp_action_output");
+static_assert(sizeof(ofp_flow_mod)          == 72,  "ofp_flow_mod");
+static_assert(sizeof(ofp_packet_out)        == 16,  "ofp_packet_out");
+static_assert(sizeof(ofp_packet_in)         == 18,  "ofp_packet_in");
+static_assert(sizeof(ofp_stats_request)     == 12,  "ofp_stats_request");
+static_assert(sizeof(ofp_stats_reply)       == 12,  "ofp_stats_reply");
+static_assert(sizeof(ofp_port_stats)        == 104, "ofp_port_stats");
+static_assert(sizeof(ofp_port_mod)          == 32,  "ofp_port_mod");
+static_assert(sizeof(ofp_echo_stamp)        == 16,  "ofp_echo_stamp");
+static_assert(sizeof(ofp13_switch_features) == 32,  "ofp13_switch_features");
+static_assert(sizeof(ofp13_port)            == 64,  "ofp13_port");
+static_assert(sizeof(ofp13_port_status)     == 80,  "ofp13_port_status");
+static_assert(sizeof(ofp13_multipart_request) == 16, "ofp13_multipart_request");
+static_assert(sizeof(ofp13_multipart_reply) == 16,  "ofp13_multipart_reply");
+static_assert(sizeof(ofp13_port_stats)      == 112, "ofp13_port_stats");
+static_assert(sizeof(ofp13_flow_mod)        == 48,  "ofp13_flow_mod");
+static_assert(sizeof(ofp13_instruction_actions)    == 8, "ofp13_instruction_actions");
+static_assert(sizeof(ofp13_instruction_goto_table) == 8, "ofp13_instruction_goto_table");
+static_assert(sizeof(ofp13_instruction_meter)      == 8, "ofp13_instruction_meter");
+static_assert(sizeof(ofp13_action_output)   == 16,  "ofp13_action_output");
+static_assert(sizeof(ofp13_action_group)    == 8,   "ofp13_action_group");
+static_assert(sizeof(ofp13_packet_out)      == 24,  "ofp13_packet_out");
+static_assert(sizeof(ofp13_packet_in)       == 24,  "ofp13_packet_in");
+static_assert(sizeof(ofp13_port_mod)        == 40,  "ofp13_port_mod");
+static_assert(sizeof(ofp13_group_mod)       == 16,  "ofp13_group_mod");
+static_assert(sizeof(ofp13_bucket)          == 16,  "ofp13_bucket");
+static_assert(sizeof(ofp13_meter_mod)       == 16,  "ofp13_meter_mod");
+static_assert(sizeof(ofp13_meter_band)      == 16,  "ofp13_meter_band");
+
+// -----------------------------
+// Byte order
+// -----------------------------
+template<class U>
+constexpr U bswap(U v){
+  static_assert(std::is_integral_v<U> || std::is_enum_v<U>, "bswap: integral field");
+  if constexpr (sizeof(U) == 1) return v;
+  else if constexpr (sizeof(U) == 2) return U(__builtin_bswap16(uint16_t(v)));
+  else if constexpr (sizeof(U) == 4) return U(__builtin_bswap32(uint32_t(v)));
+  else { static_assert(sizeof(U) == 8, "bswap: 1/2/4/8 bytes"); return U(__builtin_bswap64(uint64_t(v))); }
+}
+// 網路序 <-> 主機序（互為反函數）
+template<class U>
+constexpr U to_be(U v){
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return bswap(v);
+#else
+  return v;
+#endif
+}
+template<class U> constexpr U from_be(U v){ return to_be(v); }
+
+constexpr uint16_t htobe16_u(uint16_t v){ return to_be(v); }
+constexpr uint32_t htobe32_u(uint32_t v){ return to_be(v); }
+constexpr uint64_t htobe64_u(uint64_t v){ return to_be(v); }
+
+// 從未對齊的 buffer 讀 big-endian 整數
+constexpr uint16_t rd16(const uint8_t* p){ return uint16_t((p[0]<<8) | p[1]); }
+constexpr uint32_t rd32(const uint8_t* p){ return (uint32_t(p[0])<<24)|(uint32_t(p[1])<<16)|(uint32_t(p[2])<<8)|p[3]; }
+constexpr uint64_t rd64(const uint8_t* p){ return (uint64_t(rd32(p))<<32) | rd32(p+4); }
+inline void put16(std::vector<uint8_t>& b, uint16_t v){ b.push_back(uint8_t(v>>8)); b.push_back(uint8_t(v)); }
+inline void put32(std::vector<uint8_t>& b, uint32_t v){ put16(b, uint16_t(v>>16)); put16(b, uint16_t(v)); }
+constexpr size_t pad8(size_t n){ return (n + 7) / 8 * 8; }
+
+// -----------------------------
+// Read side: views over received bytes
+// -----------------------------
+// 唯讀 byte 區段；所有存取都檢查邊界，越界時得到空區段 / 0，而不是讀到 buffer 外。
+class Bytes {
+public:
+  constexpr Bytes() = default;
+  constexpr Bytes(const uint8_t* p, size_t n) : p_(p), n_(n) {}
+
+  constexpr const uint8_t* data() const { return p_; }
+  constexpr size_t size() const { return n_; }
+  constexpr bool   empty() const { return n_ == 0; }
+  constexpr bool   has(size_t off, size_t n) const { return off <= n_ && n <= n_ - off; }
+  constexpr const uint8_t* begin() const { return p_; }
+  constexpr const uint8_t* end()   const { return p_ + n_; }
+
+  // [off, off+n)，超出範圍的部分截掉
+  constexpr Bytes sub(size_t off, size_t n = size_t(-1)) const {
+    if(off > n_) return {};
+    return Bytes(p_ + off, n < n_ - off ? n : n_ - off);
+  }
+  constexpr uint8_t  u8 (size_t off) const { return has(off, 1) ? p_[off] : 0; }
+  constexpr uint16_t u16(size_t off) const { return has(off, 2) ? rd16(p_ + off) : 0; }
+  constexpr uint32_t u32(size_t off) const { return has(off, 4) ? rd32(p_ + off) : 0; }
+  constexpr uint64_t u64(size_t off) const { return has(off, 8) ? rd64(p_ + off) : 0; }
+
+private:
+  const uint8_t* p_{nullptr};
+  size_t n_{0};
+};
+
+// 封包結構的型別化檢視：只有在剩餘長度 >= sizeof(T) 時才建得出來。
+template<class T>
+class View {
+  static_assert(std::is_trivially_copyable_v<T> && alignof(T) == 1, "View<T>: packed wire struct");
+public:
+  static constexpr std::optional<View> at(Bytes b, size_t off = 0){
+    if(!b.has(off, sizeof(T))) return std::nullopt;
+    return View(b.sub(off));
+  }
+
+  // 整數欄位轉成主機序
+  template<class M>
+  constexpr M get(M T::* m) const { return from_be(raw().*m); }
+  // 內嵌結構（例如 port_status.desc）
+  template<class S>
+  constexpr View<S> sub(S T::* m) const {
+    const auto* p = reinterpret_cast<const uint8_t*>(&(raw().*m));
+    return View<S>(b_.sub(size_t(p - b_.data())));
+  }
+  // 陣列等非整數欄位（hw_addr、name）直接取原始結構
+  const T& raw() const { return *reinterpret_cast<const T*>(b_.data()); }
+
+  constexpr Bytes bytes() const { return b_; }                 // 從 T 起算到 buffer 結尾
+  constexpr Bytes tail()  const { return b_.sub(sizeof(T)); }  // 固定部分之後（變長內容）
+
+private:
+  template<class> friend class View;
+  constexpr explicit View(Bytes b) : b_(b) {}
+  Bytes b_;
+};
+
+// 依序走訪 b 中每個完整的 T（port 清單、port stats 等定長陣列），尾端殘缺部分忽略
+template<class T, class F>
+void for_each(Bytes b, F&& f){
+  for(size_t off = 0; b.has(off, sizeof(T)); off += sizeof(T)) f(*View<T>::at(b, off));
+}
+
+// -----------------------------
+// Write side
+// -----------------------------
+// 編譯期建好的 header：version 於執行期填入，length 預設為 sizeof(T)
+template<class T, uint8_t Type>
+constexpr T make(uint8_t version, uint32_t xid){
+  static_assert(std::is_trivially_copyable_v<T> && alignof(T) == 1, "make<T>: packed wire struct");
+  static_assert(sizeof(T) >= sizeof(ofp_header) && sizeof(T) <= 0xffff, "make<T>: fits one message");
+  T t{};
+  ofp_header h{version, Type, to_be(uint16_t(sizeof(T))), to_be(xid)};
+  if constexpr (std::is_same_v<T, ofp_header>) t = h;
+  else t.header = h;
+  return t;
+}
+
+// 在輸出 buffer 尾端附加一個 T；記 offset 而非指標，之後再 append 造成的重新配置不影響
+template<class T>
+class Out {
+  static_assert(std::is_trivially_copyable_v<T> && alignof(T) == 1, "Out<T>: packed wire struct");
+public:
+  // 全零的定長紀錄（action、bucket、band…）
+  static Out append(std::vector<uint8_t>& b){
+    const size_t off = b.size();
+    b.resize(off + sizeof(T));
+    return Out(b, off);
+  }
+  // 訊息開頭：header 由 make<T,Type>() 產生
+  template<uint8_t Type>
+  static Out message(std::vector<uint8_t>& b, uint8_t version){
+    static constexpr T kZeroXid = make<T, Type>(0, 0);
+    const size_t off = b.size();
+    const auto* p = reinterpret_cast<const uint8_t*>(&kZeroXid);
+    b.insert(b.end(), p, p + sizeof(T));
+    Out o(b, off);
+    o.raw_header().version = version;
+    return o;
+  }
+
+  template<class M, class V>
+  Out& set(M T::* m, V v){ raw().*m = to_be(M(v)); return *this; }
+  T& raw(){ return *reinterpret_cast<T*>(b_->data() + off_); }
+  size_t offset() const { return off_; }
+  // 從 T 起算到目前 buffer 結尾的長度
+  size_t length() const { return b_->size() - off_; }
+
+  // 變長紀錄：把長度欄位補成實際長度（bucket.len、instruction.len…）
+  template<class M>
+  Out& close_len(M T::* len_field){ return set(len_field, length()); }
+  // 訊息：補 header.length 與 xid
+  void close(uint32_t xid){
+    raw_header().length = to_be(uint16_t(length()));
+    raw_header().xid    = to_be(xid);
+  }
+
+private:
+  Out(std::vector<uint8_t>& b, size_t off) : b_(&b), off_(off) {}
+  ofp_header& raw_header(){ return *reinterpret_cast<ofp_header*>(b_->data() + off_); }
+
+  std::vector<uint8_t>* b_;
+  size_t off_;
+};
+
+} // namespace of
+
+#endif // HYBRID_OF_CODEC_HPP
@@ -2,11 +2,13 @@
 #define HYBRID_OF_CONTROLLER_HPP
 #pragma once
 #include "models.hpp"
+#include <array>
 #include <cstdint>
 #include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <set>
 #include <functional>
 #include <mutex>
@@ -31,6 +33,7 @@ struct PortStats {
   uint64_t rx_bytes{0};
   uint64_t tx_bytes{0};
   uint32_t speedMbps{0};  // current link speed (administrative or measured)
+  uint64_t duration_ns{0}; // time the port has been alive (OF1.3 only; 0 = not reported)
 };
 
 // Logical link identifier used in aggregated network views
@@ -46,7 +49,10 @@ struct PortStats {
 struct PortInfo {
   int port_no{0};
   bool up{true};
-  uint32_t curr_speedMbps{0};
+  uint32_t curr_speedMbps{0};       // from 'curr' feature bits (falls back to advertised)
+  uint32_t adv_speedMbps{0};        // highest speed in 'advertised' feature bits
+  uint32_t curr_features{0};        // raw OFPPF_* bits as reported by the switch
+  uint32_t advertised_features{0};
   PortStats last; // last sampled stats
 };
 
@@ -55,6 +61,11 @@ struct SwitchInfo {
   int swid{0};                 // internal software ID
   uint64_t dpid{0};            // datapath ID reported by switch
   bool connected{false};
+  uint8_t of_version{0};       // negotiated wire version (0x01 / 0x04; 0 = not yet)
+  int n_tables{0};             // flow tables reported in FEATURES_REPLY
+  bool pipeline{false};        // OF1.3 two-stage pipeline (kTableTE -> kTableL2) installed
+  std::map<int, uint64_t> flow_mods_by_table;  // flow_mods sent per table (update churn)
+  double handshake_ms{0.0};    // accept -> READY, including time queued for a handshake slot
   std::map<int, PortInfo> ports; // key = port number
 };
 
@@ -70,8 +81,92 @@ struct PacketIn {
 struct LLDPEvent {
   int src_swid{0}, src_port{0};
   int dst_swid{0}, dst_port{0};
+  uint64_t seq{0};   // publish order on the event bus (shared with LinkDownEvent)
 };
 
+// A port that stopped carrying traffic. Published ahead of every queued event
+// so topology and TE can react before the next discovery round.
+struct LinkDownEvent {
+  enum class Cause : uint8_t { PortStatus, ProbeLoss };
+  int swid{0}, port{0};
+  Cause cause{Cause::PortStatus};   // PORT_STATUS link-down / delete, or kLldpHotProbes missed probes
+  uint64_t seq{0};                  // publish order; LLDP with a lower seq was received before it
+};
+
+// Control-channel liveness / latency (controller-initiated ECHO_REQUEST)
+struct EchoStats {
+  uint64_t sent{0};                // probes sent
+  uint64_t replies{0};             // replies received
+  uint64_t missed{0};              // probes that timed out
+  uint32_t consecutive_missed{0};  // current run of unanswered probes
+  uint64_t samples{0};             // RTT samples in the histogram
+  double   min_ms{0.0}, p50_ms{0.0}, p99_ms{0.0}, max_ms{0.0};
+};
+
+// Control-channel metrics of one switch connection (since it connected)
+struct ChannelMetrics {
+  uint64_t dpid{0};
+  std::map<uint8_t, uint64_t> msgs_in, msgs_out;  // by OFPT type (numbering of the negotiated version)
+  uint64_t bytes_in{0}, bytes_out{0};
+  uint64_t packet_ins{0};
+  double   packet_in_rate{0.0};      // per second, over the most recent ~1 s window
+  uint32_t queue_depth{0};           // complete messages found in the last read batch
+  uint32_t queue_depth_max{0};
+  size_t   rx_backlog_bytes{0};      // partial message bytes still buffered
+  size_t   tx_backlog_bytes{0};      // bytes queued behind a full socket buffer
+  uint64_t send_stalls{0};           // sends that found the socket buffer full
+  uint64_t send_stall_ms{0};         // time until the queued bytes drained
+  // wait: poll wakeup -> handler start; handle: time inside the handler
+  double   wait_p50_us{0.0},   wait_p99_us{0.0},   wait_max_us{0.0};
+  double   handle_p50_us{0.0}, handle_p99_us{0.0}, handle_max_us{0.0};
+};
+
+// Connection handshake (HELLO -> FEATURES -> CONFIG -> READY) admission
+struct HandshakeStats {
+  size_t   in_progress{0};         // admitted, not yet READY
+  size_t   queued{0};              // accepted, waiting for a slot
+  uint64_t completed{0};
+  uint64_t timed_out{0};
+  double   p50_ms{0.0}, p99_ms{0.0}, max_ms{0.0};   // accept -> READY
+};
+
+// Event bus counters (see event_bus.hpp)
+struct EventBusStats {
+  size_t   capacity{0};            // ring slots
+  size_t   depth{0};               // approximate queued events
+  uint64_t published{0};
+  uint64_t dispatched{0};
+  uint64_t dropped{0};             // ring full at publish time
+  std::map<std::string, uint64_t> dropped_by_kind;
+};
+
+// Warm-restart state for one switch (persisted by StateStore, see state_snapshot.hpp)
+struct WarmSwitchState {
+  uint64_t dpid{0};
+  int swid{0};                     // handed out again when this dpid reconnects
+  std::vector<std::pair<std::array<uint8_t,6>, int>> macs;  // learned MAC -> port
+};
+
+// Group table bucket (OpenFlow 1.3)
+struct GroupBucket {
+  uint16_t weight{0};                   // select groups only
+  uint32_t watch_port{0xffffffff};      // fast-failover liveness port (ANY = none)
+  uint32_t watch_group{0xffffffff};     // fast-failover liveness group (ANY = none)
+  std::vector<uint32_t> out_ports;      // output actions (OFController::kInPort = back out in_port)
+};
+enum class GroupType    : uint8_t  { All = 0, Select = 1, Indirect = 2, FastFailover = 3 };
+enum class GroupCommand : uint16_t { Add = 0, Modify = 1, Delete = 2 };
+
+// Meter band (OpenFlow 1.3); rates are in kb/s
+struct MeterBand {
+  enum class Type : uint16_t { Drop = 1, DscpRemark = 2 };
+  Type type{Type::Drop};
+  uint32_t rate_kbps{0};
+  uint32_t burst_kb{0};                 // 0 = switch default
+  uint8_t  prec_level{1};               // DscpRemark: drop-precedence increase
+};
+enum class MeterCommand : uint16_t { Add = 0, Modify = 1, Delete = 2 };
+
 // ---------------------------
 // Callback function types
 // ---------------------------
@@ -81,6 +176,7 @@ using OnPacketIn      = std::function<void(const PacketIn& pki)>; // any packet-
 using OnLLDP          = std::function<void(const LLDPEvent& e)>;  // LLDP discovery event
 using OnError         = std::function<void(int swid, uint16_t type, uint16_t code, const std::string& msg)>; // error messages
 using OnStatsReply    = std::function<void(int swid)>;             // asynchronous stats callback
+using OnLinkDown      = std::function<void(const LinkDownEvent& e)>; // port lost its link (priority)
 using Clock           = std::chrono::steady_clock;
 
 // ---------------------------
@@ -92,51 +188,158 @@ public:
   OFController();
   ~OFController();
 
+  // OpenFlow wire versions understood by this controller
+  static constexpr uint8_t kOFVersion10 = 0x01;
+  static constexpr uint8_t kOFVersion13 = 0x04;
+  // Reserved output port: send the packet back out of its ingress port
+  static constexpr uint32_t kInPort = 0xfff8;
+  // OF1.3 pipeline (switches with >= 2 tables): TE classification in table 0,
+  // misses continue to L2 destination forwarding in table 1, whose misses go
+  // to the controller. Single-table and OF1.0 switches keep everything in table 0.
+  static constexpr uint8_t kTableTE = 0;
+  static constexpr uint8_t kTableL2 = 1;
+
   // ---- Controller lifecycle ----
   bool start(uint16_t of_port);  // Start the OpenFlow controller server (e.g., 6633/6653)
   void run();                    // Optional blocking loop (if not using internal thread)
   void stop();                   // Stop and cleanup
 
+  // Versions offered in HELLO (bit n = wire version n; default 1.0|1.3).
+  // Each connection runs at the highest version both ends support.
+  void set_supported_versions(uint32_t bitmap);
+
   // ---- Switch and port inventory ----
+  // swids do not depend on connection order: a pinned dpid gets its configured
+  // id, dpids 1..4096 get themselves, others keep the id they had before
+  // (see switch_registry.hpp). Pin before switches connect.
+  void set_switch_ids(const std::map<uint64_t, int>& dpid_to_swid);
   std::vector<int> switch_ids() const;
   std::optional<SwitchInfo> switch_info(int swid) const;
   std::vector<int> ports_of(int swid) const;
+  // Link speed derived from the port's feature bits (0 = unknown)
+  uint32_t port_speed_mbps(int swid, int port_no) const;
+  uint8_t switch_version(int swid) const;  // negotiated wire version, 0 = unknown
 
   // ---- Packet-out / LLDP ----
   void packet_out(int swid, int out_port, const uint8_t* eth, size_t len);
   void send_lldp(int swid, int out_port);
+  // One LLDP round over every up port of every local switch (swid = 0) or of
+  // one switch. A switch's probes go out as one batch under a single lock
+  // hold. Returns the number of probes sent. The reactor runs a round every
+  // LLDP period by itself; call this only to probe out of turn.
+  size_t send_lldp_round(int swid = 0);
 
   // ---- Monitoring ----
   std::map<LinkId, PortStats> poll_port_stats();  // aggregated (swid,port) view
   std::map<int, PortStats>    poll_port_stats(int swid); // per-switch raw
+  // Latest counters from the periodic stats round; never sends or sleeps.
+  std::map<LinkId, PortStats> port_stats_snapshot() const;
 
   // ---- Control: Flows and Ports ----
-  void flow_mod(int swid,
+  // With shard hooks set, flow/group/meter/port mods, barriers and packet-outs
+  // for a switch held by another shard are encoded here and forwarded to it.
+  // match: "in=1,src=10.0.0.0/24,dst=...,proto=6,sport=..,dport=.." (see ip_match)
+  // actions: comma-separated "output:N" / "output:in_port" and, on OF1.3,
+  // "group:G" / "goto:T" / "meter:M". table_id != 0, group, goto or meter needs an OF1.3 switch;
+  // on OF1.0 the call is ignored. False if nothing was sent (unknown switch or
+  // OF1.0); throws like the other sends when the queue is full.
+  bool flow_mod(int swid,
                 const std::string& match,
                 const std::string& actions,
                 int priority = 100,
                 bool add = true,
                 std::optional<uint16_t> idle_timeout = {},
                 std::optional<uint16_t> hard_timeout = {},
-                std::optional<uint64_t> cookie = {});
+                std::optional<uint64_t> cookie = {},
+                uint8_t table_id = 0);
+
+  // Group table entry; false if the switch is unknown or speaks OF1.0.
+  bool group_mod(int swid, GroupCommand cmd, uint32_t group_id,
+                 GroupType type = GroupType::All,
+                 const std::vector<GroupBucket>& buckets = {});
+
+  // Meter table entry; false if the switch is unknown or speaks OF1.0.
+  bool meter_mod(int swid, MeterCommand cmd, uint32_t meter_id,
+                 const std::vector<MeterBand>& bands = {});
+
+  // Delete every rule in one table (OF1.3) and restore its miss rule; clearing
+  // the L2 table also forgets learned MACs. False if unknown or OF1.0.
+  bool clear_table(int swid, uint8_t table_id);
 
   void port_mod(int swid, int port_no, bool up, int speedMbps);
   void barrier(int swid);
 
   // ---- Periodic timers ----
-  void set_lldp_period(std::chrono::milliseconds p);   // default 1000 ms
+  void set_lldp_period(std::chrono::milliseconds p);   // default 1000 ms (LLDP round)
+  // Adaptive LLDP: each port is probed on its own schedule. Ports whose
+  // probes keep coming back double their interval up to 'ceiling'; new ports,
+  // ports with a PORT_STATUS, a missed probe or a changed neighbour are probed
+  // every period/4 for a few rounds. 0 (default) = every port every period.
+  void set_lldp_backoff(std::chrono::milliseconds ceiling);
   void set_stats_period(std::chrono::milliseconds p);  // default 2000 ms
 
+  // ---- Handshake admission ----
+  // At most 'max_inflight' switches handshake at once (default 256); further
+  // connections wait in accept order without being read. A handshake that is
+  // not READY within 'timeout' (default 10 s, 0 = never) is dropped.
+  void set_handshake_limits(size_t max_inflight, std::chrono::milliseconds timeout);
+  HandshakeStats handshake_stats() const;
+
+  // ---- Echo probing ----
+  // Send ECHO_REQUEST every 'interval' (0 disables); after 'max_missed' consecutive
+  // unanswered probes the switch is declared dead and on_switch_state(swid,false) fires.
+  void set_echo_probe(std::chrono::milliseconds interval, int max_missed); // default 200 ms, 3
+  std::map<int, EchoStats> echo_stats() const;       // keyed by swid
+
+  // ---- Control-channel metrics ----
+  // Per-switch message/byte counters, packet-in rate, read queue depth,
+  // handler latency and send stalls; keyed by swid.
+  std::map<int, ChannelMetrics> metrics_snapshot() const;
+
   // ---- Callbacks ----
+  // Each call adds a subscriber. Events are queued by the I/O thread and
+  // dispatched on the controller's event thread (or the executor below), so
+  // callbacks may call back into the controller. PacketIn::data is only valid
+  // for the duration of the callback.
   void on_switch_state(OnSwitchState cb);
   void on_packet_in(OnPacketIn cb);
   void on_lldp(OnLLDP cb);
   void on_error(OnError cb);
   void on_stats_reply(OnStatsReply cb);
+  void on_link_down(OnLinkDown cb);
+  void set_event_executor(std::function<void(std::function<void()>)> ex);
+  EventBusStats event_bus_stats() const;
 
   // ---- Thread-safe inventory access ----
   std::map<int, SwitchInfo> inventory_snapshot() const;
 
+  // ---- Warm restart ----
+  // Connected switches plus switches remembered from an import or a disconnect.
+  std::vector<WarmSwitchState> export_warm_state() const;
+  // When a remembered dpid connects it gets its old swid back (if free) and its
+  // MAC table preloaded, instead of a new id and a round of floods.
+  void import_warm_state(const std::vector<WarmSwitchState>& st);
+
+  // ---- Multi-process sharding (see shard.hpp) ----
+  // Hooks into a shared switch directory and the other worker processes; all
+  // optional. Set before start().
+  struct ShardHooks {
+    std::function<int(uint64_t dpid, int preferred)> swid_for;  // global swid; <= 0 = use preferred
+    std::function<bool(uint64_t dpid)> owns;               // false = hand the connection to its owner
+    std::function<void(int fd, uint8_t version, uint64_t dpid)> hand_off;  // takes ownership of fd
+    std::function<int(uint64_t dpid)> lookup;              // swid of a switch up in another shard, -1 = none
+    std::function<uint8_t(int swid)> remote_version;       // wire version of a remote switch, 0 = not reachable
+    std::function<bool(int swid, const uint8_t* msg, size_t len)> forward;  // encoded message to its owner
+    std::function<void(int swid, uint64_t dpid, uint8_t version, bool up)> on_state;  // local switch up/down
+    bool reuse_port{false};                                // listen with SO_REUSEPORT
+  };
+  void set_shard_hooks(ShardHooks h);
+  // Take over a connection whose HELLO was already exchanged by another shard;
+  // the handshake restarts at FEATURES_REQUEST.
+  bool adopt_connection(int fd, uint8_t version);
+  // Write an encoded message (forwarded by another shard) to a local switch.
+  bool send_raw(int swid, const uint8_t* msg, size_t len);
+
   // ---- Utility ----
   static std::string ip_match(int in_port,
                               const std::string& src, const std::string& dst,
@@ -149,24 +352,10 @@ private:
   OFController(const OFController&) = delete;
   OFController& operator=(const OFController&) = delete;
 
-  // Implementation hidden (PIMPL)
+  // Implementation hidden (PIMPL): sockets, switch tables, callbacks and the
+  // I/O thread are all per-instance, so several controllers can coexist.
   struct Impl;
-  Impl* impl_; // internal socket/event manager
-
-  // Periods
-  std::chrono::milliseconds lldp_period_{1000};
-  std::chrono::milliseconds stats_period_{2000};
-
-  // Callback functions
-  OnSwitchState cb_switch_state_;
-  OnPacketIn    cb_packet_in_;
-  OnLLDP        cb_lldp_;
-  OnError       cb_error_;
-  OnStatsReply  cb_stats_;
-
-  // Shared state (protected by mutex)
-  mutable std::mutex mtx_;
-  std::map<int, SwitchInfo> sws_;
+  std::unique_ptr<Impl> impl_;
 };
 
 #endif // HYBRID_OF_CONTROLLER_HPP
@@ -0,0 +1,527 @@
+// src/shard.cpp
+#include "shard.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <new>
+#include <set>
+#include <tuple>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// 共享區裡的 atomic 要能跨行程使用，必須是 lock-free（不依賴行程內的鎖表）
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory atomics must be lock-free");
+static_assert(std::atomic<int64_t>::is_always_lock_free,  "shared-memory atomics must be lock-free");
+
+namespace {
+
+constexpr uint64_t kMagic        = 0x484f4653484d3031ULL;   // "HOFSHM01"
+constexpr int      kReadRetries  = 64;     // 讀者遇到寫入中的 region 最多重試幾次
+constexpr size_t   kOutboxMax    = 4096;   // 每個目的 shard 最多積壓幾則，超過就丟
+constexpr size_t   kMaxInboxMsg  = 65535;  // OpenFlow length 欄位上限
+
+// ---- 共享區內的固定格式紀錄（trivially copyable，不含指標）----
+struct ShmEdge { int32_t u, v, u_port, v_port; int64_t seen_ns; };
+struct ShmHost { uint8_t mac[6]; uint16_t port; int32_t swid; };
+struct ShmRate { int32_t swid, port; uint32_t speed_mbps, pad; double rx_mbps, tx_mbps; };
+
+// 每個 shard 一塊，只有該 shard 寫；seq 為奇數 = 寫入中（seqlock）
+struct Region {
+  std::atomic<uint64_t> seq;
+  std::atomic<int64_t>  heartbeat_ns;
+  uint32_t n_edges, n_hosts, n_rates;
+  ShmEdge edges[ShardSegment::kMaxEdges];
+  ShmHost hosts[ShardSegment::kMaxHosts];
+  ShmRate rates[ShardSegment::kMaxRates];
+};
+
+// 目錄 slot：dpid 以 CAS 從 0 認領；state = up(bit 0) | version(bit 8..15) | owner+1(bit 16..23)
+struct Slot {
+  std::atomic<uint64_t> dpid;
+  std::atomic<uint32_t> state;
+};
+
+uint32_t pack_state(int owner, uint8_t version, bool up) {
+  return uint32_t(up) | (uint32_t(version) << 8) | (uint32_t(owner + 1) << 16);
+}
+
+// dpid → shard：splitmix64 打散，連號 dpid 也能平均分配
+uint64_t mix64(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+int64_t steady_ns(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+// ---- inbox 訊息：header + （Raw 的）OpenFlow 訊息；Adopt 以 SCM_RIGHTS 附帶 fd ----
+enum : uint8_t { kMsgAdopt = 1, kMsgRaw = 2 };
+struct InboxHdr {
+  uint8_t  kind;
+  uint8_t  version;
+  uint16_t pad;
+  int32_t  swid;
+  uint64_t dpid;
+};
+
+volatile sig_atomic_t g_stop = 0;
+void on_stop_signal(int) { g_stop = 1; }
+
+} // namespace
+
+struct ShardSegment::Layout {
+  uint64_t magic;
+  int32_t  shards;
+  Slot     dir[kMaxSwitches];
+  Region   region[1];    // 實際映射 shards 個
+};
+
+// ============ ShardSegment ============
+std::unique_ptr<ShardSegment> ShardSegment::create(int shards) {
+  if (shards < 1 || shards > kMaxShards) {
+    std::cerr << "[shard] shard count must be 1.." << kMaxShards << "\n";
+    return nullptr;
+  }
+  // 匿名共享映射：fork 後父子行程看到同一份實體頁；頁面用到才配置
+  const size_t bytes = sizeof(Layout) + sizeof(Region) * size_t(shards - 1);
+  void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    std::cerr << "[shard] mmap " << bytes << " bytes: " << std::strerror(errno) << "\n";
+    return nullptr;
+  }
+  auto* m = new (p) Layout;   // 記憶體已清為 0：slot 皆空、seq 皆為偶數
+  m->magic  = kMagic;
+  m->shards = shards;
+  return std::unique_ptr<ShardSegment>(new ShardSegment(m, bytes));
+}
+
+ShardSegment::~ShardSegment() {
+  if (m_) ::munmap(m_, bytes_);
+}
+
+int ShardSegment::shards() const { return m_->shards; }
+
+int ShardSegment::owner(uint64_t dpid) const {
+  return int(mix64(dpid) % uint64_t(m_->shards));
+}
+
+// 依 slot 順序找 dpid 或認領第一個空 slot；swid 因此與單一行程時一樣小而連續
+int ShardSegment::swid_for(uint64_t dpid) {
+  if (!dpid) return -1;
+  for (int i = 0; i < kMaxSwitches; ++i) {
+    auto& d = m_->dir[i].dpid;
+    uint64_t cur = d.load(std::memory_order_acquire);
+    if (cur == 0) {
+      if (d.compare_exchange_strong(cur, dpid, std::memory_order_acq_rel)) return i + 1;
+      // 被別的 shard 搶先：cur 是對方寫入的 dpid
+    }
+    if (cur == dpid) return i + 1;
+  }
+  return -1;
+}
+
+bool ShardSegment::reserve(uint64_t dpid, int swid) {
+  if (!dpid || swid < 1 || swid > kMaxSwitches) return false;
+  if (const int have = find(dpid); have > 0) return have == swid;
+  uint64_t cur = 0;
+  return m_->dir[swid - 1].dpid.compare_exchange_strong(cur, dpid, std::memory_order_acq_rel) || cur == dpid;
+}
+
+int ShardSegment::find(uint64_t dpid) const {
+  if (!dpid) return -1;
+  // 不在第一個空位停下：reserve() 認領的 slot 可能在空位之後
+  for (int i = 0; i < kMaxSwitches; ++i)
+    if (m_->dir[i].dpid.load(std::memory_order_acquire) == dpid) return i + 1;
+  return -1;
+}
+
+std::optional<ShardSegment::Switch> ShardSegment::entry(int swid) const {
+  if (swid < 1 || swid > kMaxSwitches) return std::nullopt;
+  const Slot& s = m_->dir[swid - 1];
+  Switch e;
+  e.dpid = s.dpid.load(std::memory_order_acquire);
+  if (!e.dpid) return std::nullopt;
+  const uint32_t st = s.state.load(std::memory_order_acquire);
+  e.up      = st & 1u;
+  e.version = uint8_t(st >> 8);
+  e.owner   = int((st >> 16) & 0xffu) - 1;
+  return e;
+}
+
+void ShardSegment::set_state(int swid, uint64_t dpid, int owner, uint8_t version, bool up) {
+  if (swid < 1 || swid > kMaxSwitches) return;
+  Slot& s = m_->dir[swid - 1];
+  if (s.dpid.load(std::memory_order_acquire) != dpid) return;   // 本地配的 id，不在目錄裡
+  s.state.store(pack_state(owner, version, up), std::memory_order_release);
+}
+
+void ShardSegment::drop_owner(int shard) {
+  for (int i = 0; i < kMaxSwitches; ++i) {
+    Slot& s = m_->dir[i];
+    if (!s.dpid.load(std::memory_order_acquire)) continue;
+    uint32_t st = s.state.load(std::memory_order_acquire);
+    // 只改仍屬於該 shard 的 slot；新 owner 同時寫入時以對方為準
+    while ((st & 1u) && int((st >> 16) & 0xffu) - 1 == shard &&
+           !s.state.compare_exchange_weak(st, st & ~1u, std::memory_order_acq_rel)) {}
+  }
+}
+
+void ShardSegment::publish(int shard, const View& v) {
+  if (shard < 0 || shard >= m_->shards) return;
+  Region& r = m_->region[shard];
+  // 先把 seq 設成奇數；前一個寫者若死在半途（奇數）也能接續
+  const uint64_t s = r.seq.load(std::memory_order_relaxed) | 1u;
+  r.seq.store(s, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  r.n_edges = uint32_t(std::min<size_t>(v.edges.size(), kMaxEdges));
+  for (uint32_t i = 0; i < r.n_edges; ++i) {
+    const auto& e = v.edges[i];
+    r.edges[i] = ShmEdge{e.u, e.v, e.u_port, e.v_port, steady_ns(e.last_seen)};
+  }
+  r.n_hosts = uint32_t(std::min<size_t>(v.hosts.size(), kMaxHosts));
+  for (uint32_t i = 0; i < r.n_hosts; ++i) {
+    const auto& h = v.hosts[i];
+    ShmHost& o = r.hosts[i];
+    std::memcpy(o.mac, h.mac.data(), 6);
+    o.port = uint16_t(h.port);
+    o.swid = h.swid;
+  }
+  r.n_rates = uint32_t(std::min<size_t>(v.rates.size(), kMaxRates));
+  for (uint32_t i = 0; i < r.n_rates; ++i) {
+    const auto& x = v.rates[i];
+    r.rates[i] = ShmRate{x.swid, x.port, x.speed_mbps, 0, x.rx_mbps, x.tx_mbps};
+  }
+  r.heartbeat_ns.store(steady_ns(std::chrono::steady_clock::now()), std::memory_order_relaxed);
+  r.seq.store(s + 1, std::memory_order_release);
+}
+
+ShardSegment::View ShardSegment::read(int shard) const {
+  if (shard < 0 || shard >= m_->shards) return {};
+  const Region& r = m_->region[shard];
+  for (int tries = 0; tries < kReadRetries; ++tries) {
+    const uint64_t s1 = r.seq.load(std::memory_order_acquire);
+    if (s1 & 1u) { std::this_thread::yield(); continue; }
+    // 計數可能與寫者交錯而讀到一半的值：先夾在陣列範圍內，seq 不符時整份丟掉重讀
+    View v;
+    const uint32_t ne = std::min<uint32_t>(r.n_edges, kMaxEdges);
+    const uint32_t nh = std::min<uint32_t>(r.n_hosts, kMaxHosts);
+    const uint32_t nr = std::min<uint32_t>(r.n_rates, kMaxRates);
+    v.edges.reserve(ne); v.hosts.reserve(nh); v.rates.reserve(nr);
+    for (uint32_t i = 0; i < ne; ++i) {
+      const ShmEdge e = r.edges[i];
+      v.edges.push_back(TopoViewer::Edge{e.u, e.v, e.u_port, e.v_port,
+                        std::chrono::steady_clock::time_point(std::chrono::nanoseconds(e.seen_ns))});
+    }
+    for (uint32_t i = 0; i < nh; ++i) {
+      const ShmHost h = r.hosts[i];
+      Host o; std::memcpy(o.mac.data(), h.mac, 6); o.port = h.port; o.swid = h.swid;
+      v.hosts.push_back(o);
+    }
+    for (uint32_t i = 0; i < nr; ++i) {
+      const ShmRate x = r.rates[i];
+      v.rates.push_back(Rate{x.swid, x.port, x.speed_mbps, x.rx_mbps, x.tx_mbps});
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (r.seq.load(std::memory_order_relaxed) == s1) return v;
+  }
+  return {};
+}
+
+// 各 shard 的聯集；同一條鏈路兩個方向的 LLDP 可能落在不同 shard，依 (u,v,port) 去重取最新
+ShardSegment::View ShardSegment::global() const {
+  View out;
+  std::map<std::tuple<int,int,int,int>, size_t> edge_at;
+  for (int k = 0; k < m_->shards; ++k) {
+    View v = read(k);
+    for (auto& e : v.edges) {
+      const auto key = std::make_tuple(e.u, e.v, e.u_port, e.v_port);
+      auto it = edge_at.find(key);
+      if (it == edge_at.end()) { edge_at[key] = out.edges.size(); out.edges.push_back(e); }
+      else if (out.edges[it->second].last_seen < e.last_seen) out.edges[it->second].last_seen = e.last_seen;
+    }
+    out.hosts.insert(out.hosts.end(), v.hosts.begin(), v.hosts.end());
+    out.rates.insert(out.rates.end(), v.rates.begin(), v.rates.end());
+  }
+  return out;
+}
+
+void ShardSegment::clear(int shard) {
+  publish(shard, View{});
+  if (shard >= 0 && shard < m_->shards) m_->region[shard].heartbeat_ns.store(0, std::memory_order_relaxed);
+}
+
+// ============ ShardContext ============
+ShardContext::ShardContext(int index, ShardSegment* seg, std::vector<int> inbox_tx, int inbox_rx)
+  : index_(index), seg_(seg), inbox_tx_(std::move(inbox_tx)), inbox_rx_(inbox_rx), outbox_(inbox_tx_.size()) {}
+
+ShardContext::~ShardContext() {
+  stop();
+  for (auto& q : outbox_)
+    for (const auto& m : q) if (m.fd >= 0) ::close(m.fd);
+}
+
+void ShardContext::attach(OFController& ctl) {
+  ctl_ = &ctl;
+  OFController::ShardHooks h;
+  h.reuse_port = true;
+  // 本地挑的 id（設定檔 / dpid / 舊 id）在目錄裡還空著就用它，否則由目錄配
+  h.swid_for = [this](uint64_t dpid, int preferred) {
+    return (preferred > 0 && seg_->reserve(dpid, preferred)) ? preferred : seg_->swid_for(dpid);
+  };
+  h.owns     = [this](uint64_t dpid) { return seg_->owner(dpid) == index_; };
+  h.hand_off = [this](int fd, uint8_t version, uint64_t dpid) { hand_off_(fd, version, dpid); };
+  h.lookup   = [this](uint64_t dpid) {
+    const int swid = seg_->find(dpid);
+    const auto e = seg_->entry(swid);
+    return (e && e->up) ? swid : -1;
+  };
+  h.remote_version = [this](int swid) {
+    const auto e = seg_->entry(swid);
+    return (e && e->up && e->owner != index_) ? e->version : uint8_t(0);
+  };
+  h.forward  = [this](int swid, const uint8_t* msg, size_t len) { return forward_(swid, msg, len); };
+  h.on_state = [this](int swid, uint64_t dpid, uint8_t version, bool up) {
+    seg_->set_state(swid, dpid, index_, version, up);
+  };
+  ctl.set_shard_hooks(std::move(h));
+}
+
+void ShardContext::start() {
+  if (running_.exchange(true)) return;
+  th_ = std::thread([this] { inbox_loop_(); });
+}
+
+void ShardContext::stop() {
+  if (!running_.exchange(false)) return;
+  if (th_.joinable()) th_.join();
+}
+
+// 送出一則 inbox 訊息，不等待：1 = 送出，0 = 對方佇列滿，-1 = 失敗
+static int send_inbox(int sock, const std::vector<uint8_t>& bytes, int pass_fd) {
+  iovec iov{const_cast<uint8_t*>(bytes.data()), bytes.size()};
+  msghdr mh{};
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  alignas(cmsghdr) char cbuf[CMSG_SPACE(sizeof(int))];
+  if (pass_fd >= 0) {
+    std::memset(cbuf, 0, sizeof(cbuf));
+    mh.msg_control = cbuf;
+    mh.msg_controllen = sizeof(cbuf);
+    cmsghdr* c = CMSG_FIRSTHDR(&mh);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type  = SCM_RIGHTS;
+    c->cmsg_len   = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(c), &pass_fd, sizeof(int));
+  }
+  for (;;) {
+    if (::sendmsg(sock, &mh, MSG_DONTWAIT | MSG_NOSIGNAL) >= 0) return 1;
+    if (errno == EINTR) continue;
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+  }
+}
+
+static std::vector<uint8_t> inbox_msg(const InboxHdr& h, const uint8_t* body, size_t len) {
+  std::vector<uint8_t> v(sizeof(h) + len);
+  std::memcpy(v.data(), &h, sizeof(h));
+  if (len) std::memcpy(v.data() + sizeof(h), body, len);
+  return v;
+}
+
+void ShardContext::hand_off_(int fd, uint8_t version, uint64_t dpid) {
+  const int to = seg_->owner(dpid);
+  if (to == index_) ::close(fd);
+  // fd 跟著訊息排隊，送出（對方已持有自己的副本）或放棄時才關閉
+  if (to == index_ || !enqueue_(to, Outgoing{inbox_msg(InboxHdr{kMsgAdopt, version, 0, 0, dpid}, nullptr, 0), fd}))
+    std::cerr << "[shard] " << index_ << ": hand-off of dpid 0x" << std::hex << dpid << std::dec
+              << " to shard " << to << " failed; switch will reconnect\n";
+}
+
+bool ShardContext::forward_(int swid, const uint8_t* msg, size_t len) {
+  const auto e = seg_->entry(swid);
+  if (!e || !e->up || e->owner == index_ || e->owner < 0 || e->owner >= count() || len > kMaxInboxMsg) return false;
+  return enqueue_(e->owner, Outgoing{inbox_msg(InboxHdr{kMsgRaw, e->version, 0, swid, e->dpid}, msg, len), -1});
+}
+
+// 佇列是空的就直接送；送不下的排隊，維持同一目的地的順序。失敗時 m.fd 已關閉
+bool ShardContext::enqueue_(int to, Outgoing m) {
+  std::lock_guard<std::mutex> lk(out_mtx_);
+  auto& q = outbox_[size_t(to)];
+  if (q.empty()) {
+    const int r = send_inbox(inbox_tx_[size_t(to)], m.bytes, m.fd);
+    if (r != 0) {
+      if (m.fd >= 0) ::close(m.fd);
+      return r > 0;
+    }
+  }
+  if (q.size() >= kOutboxMax) {
+    if (m.fd >= 0) ::close(m.fd);
+    return false;
+  }
+  q.push_back(std::move(m));
+  return true;
+}
+
+// 呼叫端持有 out_mtx_
+void ShardContext::flush_locked_(int to) {
+  auto& q = outbox_[size_t(to)];
+  while (!q.empty()) {
+    const int r = send_inbox(inbox_tx_[size_t(to)], q.front().bytes, q.front().fd);
+    if (r == 0) return;
+    if (r < 0) std::cerr << "[shard] " << index_ << ": dropped queued message for shard " << to << "\n";
+    if (q.front().fd >= 0) ::close(q.front().fd);
+    q.pop_front();
+  }
+}
+
+void ShardContext::inbox_loop_() {
+  std::vector<uint8_t> buf(sizeof(InboxHdr) + kMaxInboxMsg);
+  std::vector<pollfd> pfds;
+  std::vector<int> dest;
+  while (running_) {
+    // inbox 之外，也等有積壓的目的 shard 變得可寫
+    pfds.assign(1, pollfd{inbox_rx_, POLLIN, 0});
+    dest.clear();
+    {
+      std::lock_guard<std::mutex> lk(out_mtx_);
+      for (size_t k = 0; k < outbox_.size(); ++k) {
+        if (outbox_[k].empty()) continue;
+        pfds.push_back(pollfd{inbox_tx_[k], POLLOUT, 0});
+        dest.push_back(int(k));
+      }
+    }
+    const int rv = ::poll(pfds.data(), nfds_t(pfds.size()), dest.empty() ? 200 : 20);
+    if (rv <= 0) continue;
+    if (!dest.empty()) {
+      std::lock_guard<std::mutex> lk(out_mtx_);
+      for (size_t i = 1; i < pfds.size(); ++i)
+        if (pfds[i].revents) flush_locked_(dest[i - 1]);
+    }
+    if (!(pfds[0].revents & POLLIN)) continue;
+
+    iovec iov{buf.data(), buf.size()};
+    alignas(cmsghdr) char cbuf[CMSG_SPACE(sizeof(int) * 4)];
+    msghdr mh{};
+    mh.msg_iov = &iov; mh.msg_iovlen = 1;
+    mh.msg_control = cbuf; mh.msg_controllen = sizeof(cbuf);
+    const ssize_t n = ::recvmsg(inbox_rx_, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (n < 0) continue;
+
+    std::vector<int> fds;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+      if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+      const size_t k = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (size_t i = 0; i < k; ++i) {
+        int fd; std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+        fds.push_back(fd);
+      }
+    }
+    if (size_t(n) < sizeof(InboxHdr) || !ctl_) { for (int fd : fds) ::close(fd); continue; }
+    InboxHdr h; std::memcpy(&h, buf.data(), sizeof(h));
+
+    if (h.kind == kMsgAdopt && fds.size() == 1) {
+      if (!ctl_->adopt_connection(fds[0], h.version)) ::close(fds[0]);
+      continue;
+    }
+    for (int fd : fds) ::close(fd);
+    if (h.kind == kMsgRaw && !ctl_->send_raw(h.swid, buf.data() + sizeof(h), size_t(n) - sizeof(h)))
+      std::cerr << "[shard] " << index_ << ": dropped forwarded message for swid " << h.swid << "\n";
+  }
+}
+
+// ============ ShardSupervisor ============
+ShardSupervisor::ShardSupervisor(int shards) : shards_(shards) {}
+
+int ShardSupervisor::run(const Worker& worker) {
+  auto seg = ShardSegment::create(shards_);
+  if (!seg) return 1;
+
+  // 每個 shard 一個 datagram inbox；兩端都在 fork 前建立，重啟的 worker 直接繼承
+  std::vector<int> tx(size_t(shards_), -1), rx(size_t(shards_), -1);
+  for (int k = 0; k < shards_; ++k) {
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) < 0) { perror("socketpair"); return 1; }
+    rx[size_t(k)] = sv[0];
+    tx[size_t(k)] = sv[1];
+  }
+
+  struct sigaction sa{};
+  sa.sa_handler = on_stop_signal;   // 不設 SA_RESTART：讓 waitpid 被中斷
+  sigemptyset(&sa.sa_mask);
+  ::sigaction(SIGINT, &sa, nullptr);
+  ::sigaction(SIGTERM, &sa, nullptr);
+
+  using SteadyClock = std::chrono::steady_clock;
+  std::vector<pid_t> pid(size_t(shards_), -1);
+  std::vector<SteadyClock::time_point> started(static_cast<size_t>(shards_));
+
+  auto spawn = [&](int k) {
+    const pid_t p = ::fork();
+    if (p < 0) { perror("fork"); return; }
+    if (p == 0) {
+      ::signal(SIGINT, SIG_DFL);
+      ::signal(SIGTERM, SIG_DFL);
+      ::prctl(PR_SET_PDEATHSIG, SIGTERM);   // supervisor 消失時一併結束
+      int rc = 1;
+      try {
+        ShardContext ctx(k, seg.get(), tx, rx[size_t(k)]);
+        rc = worker(ctx);
+      } catch (const std::exception& ex) {
+        std::cerr << "[shard] " << k << ": " << ex.what() << "\n";
+      }
+      ::_exit(rc);   // 不跑父行程留下的 atexit / 靜態解構
+    }
+    pid[size_t(k)] = p;
+    started[size_t(k)] = SteadyClock::now();
+    std::cerr << "[shard] worker " << k << "/" << shards_ << " pid " << p << "\n";
+  };
+
+  for (int k = 0; k < shards_; ++k) spawn(k);
+
+  while (!g_stop) {
+    int st = 0;
+    const pid_t p = ::waitpid(-1, &st, 0);
+    if (p < 0) {
+      if (errno == EINTR) continue;
+      if (errno == ECHILD) break;
+      perror("waitpid");
+      break;
+    }
+    const auto it = std::find(pid.begin(), pid.end(), p);
+    if (it == pid.end()) continue;
+    const int k = int(it - pid.begin());
+    *it = -1;
+    if (WIFSIGNALED(st)) std::cerr << "[shard] worker " << k << " killed by signal " << WTERMSIG(st);
+    else                 std::cerr << "[shard] worker " << k << " exited with " << WEXITSTATUS(st);
+    std::cerr << (g_stop ? "\n" : "; restarting\n");
+
+    // 它的 switch 全數下線、發布的狀態作廢；其他 shard 不受影響
+    seg->drop_owner(k);
+    seg->clear(k);
+    if (g_stop) break;
+    // 啟動不久就掛掉：退避 1 秒，避免 crash loop 吃滿 CPU
+    if (SteadyClock::now() - started[size_t(k)] < std::chrono::seconds(5))
+      for (int i = 0; i < 10 && !g_stop; ++i) ::usleep(100 * 1000);
+    if (!g_stop) spawn(k);
+  }
+
+  for (pid_t p : pid) if (p > 0) ::kill(p, SIGTERM);
+  for (pid_t p : pid) if (p > 0) ::waitpid(p, nullptr, 0);
+  for (int fd : tx) ::close(fd);
+  for (int fd : rx) ::close(fd);
+  return 0;
+}
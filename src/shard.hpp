@@ -0,0 +1,158 @@
+#pragma once
+#ifndef HYBRID_SHARD_HPP
+#define HYBRID_SHARD_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "of_controller.hpp"
+#include "topo_viewer.hpp"   // TopoViewer::Edge
+
+//
+//  Multi-process Sharding
+//  -----------------------------------------------
+//  `hybrid_of --shards K` runs a supervisor that forks K worker processes, each
+//  with its own controller, reactor and modules. Every worker listens on the
+//  OpenFlow port with SO_REUSEPORT, so the kernel spreads new connections over
+//  them. A switch belongs to shard owner(dpid); a worker that accepted someone
+//  else's switch passes the socket to the owner after FEATURES_REPLY (the
+//  first point the dpid is known) over a unix socket with SCM_RIGHTS.
+//
+//  Global state lives in one shared anonymous mapping created before fork:
+//    directory : dpid -> swid slots, claimed by CAS in slot order, so swids
+//                stay small, dense and stable across reconnects and shard
+//                restarts; each slot also carries owner / wire version / up
+//    regions   : one per shard, single writer under a seqlock: the links seen
+//                by the shard's switches, learned hosts and link rates
+//  Readers never block the writer and nothing takes a lock.
+//
+//  Shard 0 runs TE over the union of all regions. Messages for switches held
+//  by another shard are encoded locally and forwarded to the owner, which
+//  writes them to the switch. The supervisor restarts a crashed worker on its
+//  own; its switches reconnect and land on the new process.
+//
+class ShardSegment {
+public:
+  static constexpr int kMaxShards   = 32;
+  static constexpr int kMaxSwitches = 4096;   // directory slots; swid = slot + 1
+  static constexpr int kMaxEdges    = 8192;   // per shard
+  static constexpr int kMaxHosts    = 8192;
+  static constexpr int kMaxRates    = 8192;
+
+  struct Host {
+    std::array<uint8_t,6> mac{};
+    int swid{0};
+    int port{0};
+  };
+  struct Rate {
+    int swid{0}, port{0};
+    uint32_t speed_mbps{0};     // from the port's feature bits (0 = unknown)
+    double rx_mbps{0.0}, tx_mbps{0.0};
+  };
+  struct View {
+    std::vector<TopoViewer::Edge> edges;
+    std::vector<Host> hosts;
+    std::vector<Rate> rates;
+  };
+  struct Switch {
+    uint64_t dpid{0};
+    int owner{-1};
+    uint8_t version{0};
+    bool up{false};
+  };
+
+  // Map the segment; call in the supervisor before forking.
+  static std::unique_ptr<ShardSegment> create(int shards);
+  ~ShardSegment();
+  ShardSegment(const ShardSegment&) = delete;
+  ShardSegment& operator=(const ShardSegment&) = delete;
+
+  int shards() const;
+  int owner(uint64_t dpid) const;
+
+  // ---- Directory ----
+  int  swid_for(uint64_t dpid);                 // find or claim; -1 if dpid == 0 or full
+  bool reserve(uint64_t dpid, int swid);        // claim a specific swid if free (or already dpid's)
+  int  find(uint64_t dpid) const;               // -1 if never seen
+  std::optional<Switch> entry(int swid) const;
+  void set_state(int swid, uint64_t dpid, int owner, uint8_t version, bool up);   // ignored unless swid is dpid's slot
+  void drop_owner(int shard);                   // mark every switch of a dead shard down
+
+  // ---- Per-shard regions ----
+  void publish(int shard, const View& v);       // single writer: the shard itself
+  View read(int shard) const;                   // empty if the writer never finished
+  View global() const;                          // union over all shards
+  void clear(int shard);                        // supervisor, after the writer died
+
+private:
+  struct Layout;
+  ShardSegment(Layout* m, size_t bytes) : m_(m), bytes_(bytes) {}
+  Layout* m_;
+  size_t bytes_;
+};
+
+// One worker's view of the shard group: its index, the segment and the inboxes.
+class ShardContext {
+public:
+  ShardContext(int index, ShardSegment* seg, std::vector<int> inbox_tx, int inbox_rx);
+  ~ShardContext();
+
+  int  index() const { return index_; }
+  int  count() const { return seg_->shards(); }
+  bool leader() const { return index_ == 0; }   // shard 0 runs TE
+  ShardSegment& segment() { return *seg_; }
+
+  // Install the controller hooks (directory swids, ownership and hand-off,
+  // remote lookups and forwarding). Call before ctl.start().
+  void attach(OFController& ctl);
+  // Serve this shard's inbox: adopted connections and forwarded messages.
+  void start();
+  void stop();
+
+private:
+  // A datagram waiting for room in another shard's inbox (fd: SCM_RIGHTS, -1 = none)
+  struct Outgoing {
+    std::vector<uint8_t> bytes;
+    int fd{-1};
+  };
+  void hand_off_(int fd, uint8_t version, uint64_t dpid);
+  bool forward_(int swid, const uint8_t* msg, size_t len);
+  bool enqueue_(int to, Outgoing m);
+  void flush_locked_(int to);
+  void inbox_loop_();
+
+  int index_;
+  ShardSegment* seg_;
+  std::vector<int> inbox_tx_;   // per shard, datagram socket to its inbox
+  int inbox_rx_;
+  OFController* ctl_{nullptr};
+  // Hooks run under the controller lock, so they never wait on a full inbox:
+  // what does not fit is queued here and sent by the inbox thread on POLLOUT.
+  std::mutex out_mtx_;
+  std::vector<std::deque<Outgoing>> outbox_;   // per destination shard
+  std::atomic<bool> running_{false};
+  std::thread th_;
+};
+
+// Forks and babysits the workers; run() returns after SIGINT / SIGTERM.
+class ShardSupervisor {
+public:
+  using Worker = std::function<int(ShardContext&)>;   // runs in the child; return = exit code
+
+  explicit ShardSupervisor(int shards);
+  int run(const Worker& worker);
+
+private:
+  int shards_;
+};
+
+#endif // HYBRID_SHARD_HPP
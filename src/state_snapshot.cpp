@@ -0,0 +1,280 @@
+// src/state_snapshot.cpp
+#include "state_snapshot.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char     kMagic[8]   = {'H','O','F','S','N','A','P','\0'};
+constexpr size_t   kHeaderSize = 32;   // magic(8) version(4) reserved(4) payload_len(8) fnv1a(8)
+
+enum : uint32_t { kSecSwitches = 1, kSecShadow = 2, kSecPlan = 3 };
+
+uint64_t fnv1a(const uint8_t* p, size_t n) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < n; ++i) { h ^= p[i]; h *= 0x100000001b3ULL; }
+  return h;
+}
+
+// ---- little-endian writer / reader ----
+struct Writer {
+  std::vector<uint8_t> b;
+  void u8(uint8_t v) { b.push_back(v); }
+  void u16(uint16_t v) { for (int i = 0; i < 2; ++i) b.push_back(uint8_t(v >> (8 * i))); }
+  void u32(uint32_t v) { for (int i = 0; i < 4; ++i) b.push_back(uint8_t(v >> (8 * i))); }
+  void u64(uint64_t v) { for (int i = 0; i < 8; ++i) b.push_back(uint8_t(v >> (8 * i))); }
+  void i32(int32_t v)  { u32(uint32_t(v)); }
+  void f64(double v)   { uint64_t x; std::memcpy(&x, &v, 8); u64(x); }
+  void str(const std::string& s) { u32(uint32_t(s.size())); b.insert(b.end(), s.begin(), s.end()); }
+  // 區段：tag + 長度（先佔位，結束時回填）
+  size_t begin(uint32_t tag) { u32(tag); const size_t at = b.size(); u64(0); return at; }
+  void end(size_t at) {
+    const uint64_t len = b.size() - at - 8;
+    for (int i = 0; i < 8; ++i) b[at + i] = uint8_t(len >> (8 * i));
+  }
+};
+
+struct Reader {
+  const uint8_t* p; size_t n; size_t off{0};
+  Reader(const uint8_t* p_, size_t n_) : p(p_), n(n_) {}
+  void need(size_t k) const { if (k > n - off) throw std::out_of_range("snapshot truncated"); }
+  uint64_t le(int bytes) {
+    need(size_t(bytes));
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= uint64_t(p[off + i]) << (8 * i);
+    off += size_t(bytes);
+    return v;
+  }
+  uint8_t  u8()  { return uint8_t(le(1)); }
+  uint16_t u16() { return uint16_t(le(2)); }
+  uint32_t u32() { return uint32_t(le(4)); }
+  uint64_t u64() { return le(8); }
+  int32_t  i32() { return int32_t(u32()); }
+  double   f64() { const uint64_t x = u64(); double v; std::memcpy(&v, &x, 8); return v; }
+  std::string str() { const uint32_t k = u32(); need(k); std::string s((const char*)p + off, k); off += k; return s; }
+  size_t count(size_t min_elem_size) {   // 元素數；防止損壞的長度撐爆記憶體
+    const uint32_t k = u32();
+    need(size_t(k) * min_elem_size);
+    return k;
+  }
+};
+
+void put_link(Writer& w, const te::LinkId& id) { w.i32(id.u); w.i32(id.v); }
+te::LinkId get_link(Reader& r) { te::LinkId id; id.u = r.i32(); id.v = r.i32(); return id; }
+
+} // namespace
+
+StateStore::StateStore(std::string path) : path_(std::move(path)) {}
+
+std::vector<uint8_t> StateStore::encode(const StateSnapshot& s) {
+  Writer w;
+  w.b.resize(kHeaderSize);
+
+  {
+    const size_t at = w.begin(kSecSwitches);
+    w.u32(uint32_t(s.switches.size()));
+    for (const auto& sw : s.switches) {
+      w.u64(sw.dpid); w.i32(sw.swid);
+      w.u32(uint32_t(sw.macs.size()));
+      for (const auto& m : sw.macs) { w.b.insert(w.b.end(), m.first.begin(), m.first.end()); w.i32(m.second); }
+    }
+    w.end(at);
+  }
+  {
+    const size_t at = w.begin(kSecShadow);
+    w.u32(uint32_t(s.shadow.size()));
+    for (const auto& kv : s.shadow) {
+      w.i32(kv.first);
+      const auto& ins = kv.second;
+      w.u32(uint32_t(ins.rules.size()));
+      for (const auto& r : ins.rules) { w.i32(r.swid); w.str(r.match); w.str(r.actions); w.i32(r.priority); }
+      w.u32(uint32_t(ins.groups.size()));
+      for (const auto& g : ins.groups) {
+        w.i32(g.swid); w.u32(g.id); w.u8(uint8_t(g.type));
+        w.u32(uint32_t(g.buckets.size()));
+        for (const auto& bk : g.buckets) {
+          w.u16(bk.weight); w.u32(bk.watch_port); w.u32(bk.watch_group);
+          w.u32(uint32_t(bk.out_ports.size()));
+          for (uint32_t p : bk.out_ports) w.u32(p);
+        }
+      }
+      w.u32(uint32_t(ins.meters.size()));
+      for (const auto& m : ins.meters) {
+        w.i32(m.swid); w.u32(m.id);
+        w.u16(uint16_t(m.band.type)); w.u32(m.band.rate_kbps); w.u32(m.band.burst_kb); w.u8(m.band.prec_level);
+      }
+    }
+    w.end(at);
+  }
+  if (s.plan) {
+    const auto& p = *s.plan;
+    const size_t at = w.begin(kSecPlan);
+    w.u32(uint32_t(p.chosen_path.size()));
+    for (const auto& kv : p.chosen_path) { w.i32(kv.first); w.i32(kv.second); }
+    w.u32(uint32_t(p.split.size()));
+    for (const auto& kv : p.split) {
+      w.i32(kv.first); w.u32(uint32_t(kv.second.size()));
+      for (const auto& pw : kv.second) { w.i32(pw.first); w.f64(pw.second); }
+    }
+    w.u32(uint32_t(p.beta.size()));
+    for (const auto& kv : p.beta) { put_link(w, kv.first); w.i32(kv.second); }
+    w.u32(uint32_t(p.load_mbps.size()));
+    for (const auto& kv : p.load_mbps) { put_link(w, kv.first); w.f64(kv.second); }
+    w.f64(p.objective); w.u8(p.optimal ? 1 : 0); w.str(p.status_text);
+    w.end(at);
+  }
+
+  // header
+  const uint64_t plen = w.b.size() - kHeaderSize;
+  const uint64_t sum  = fnv1a(w.b.data() + kHeaderSize, plen);
+  Writer h;
+  h.b.insert(h.b.end(), kMagic, kMagic + 8);
+  h.u32(kFormatVersion); h.u32(0); h.u64(plen); h.u64(sum);
+  std::memcpy(w.b.data(), h.b.data(), kHeaderSize);
+  return std::move(w.b);
+}
+
+std::optional<StateSnapshot> StateStore::decode(const uint8_t* p, size_t n) {
+  if (n < kHeaderSize || std::memcmp(p, kMagic, 8) != 0) return std::nullopt;
+  Reader hr(p + 8, kHeaderSize - 8);
+  const uint32_t ver = hr.u32(); hr.u32();
+  const uint64_t plen = hr.u64(), sum = hr.u64();
+  if (ver != kFormatVersion) {
+    std::cerr << "[snapshot] format version " << ver << " != " << kFormatVersion << ", ignored\n";
+    return std::nullopt;
+  }
+  if (plen != n - kHeaderSize || fnv1a(p + kHeaderSize, plen) != sum) {
+    std::cerr << "[snapshot] checksum/length mismatch, ignored\n";
+    return std::nullopt;
+  }
+
+  StateSnapshot s;
+  try {
+    Reader r(p + kHeaderSize, plen);
+    while (r.off < r.n) {
+      const uint32_t tag = r.u32();
+      const uint64_t len = r.u64();
+      r.need(len);
+      Reader sec(r.p + r.off, len);
+      r.off += len;
+      switch (tag) {
+        case kSecSwitches: {
+          for (size_t i = 0, k = sec.count(16); i < k; ++i) {
+            WarmSwitchState sw;
+            sw.dpid = sec.u64(); sw.swid = sec.i32();
+            for (size_t j = 0, km = sec.count(10); j < km; ++j) {
+              std::array<uint8_t,6> mac{};
+              for (auto& b : mac) b = sec.u8();
+              sw.macs.push_back({mac, sec.i32()});
+            }
+            s.switches.push_back(std::move(sw));
+          }
+          break;
+        }
+        case kSecShadow: {
+          for (size_t i = 0, k = sec.count(16); i < k; ++i) {
+            const int fid = sec.i32();
+            Actuator::Installed ins;
+            for (size_t j = 0, kr = sec.count(16); j < kr; ++j) {
+              Actuator::Rule rule;
+              rule.swid = sec.i32(); rule.match = sec.str(); rule.actions = sec.str(); rule.priority = sec.i32();
+              ins.rules.push_back(std::move(rule));
+            }
+            for (size_t j = 0, kg = sec.count(13); j < kg; ++j) {
+              Actuator::Group g;
+              g.swid = sec.i32(); g.id = sec.u32(); g.type = GroupType(sec.u8());
+              for (size_t b = 0, kb = sec.count(14); b < kb; ++b) {
+                GroupBucket bk;
+                bk.weight = sec.u16(); bk.watch_port = sec.u32(); bk.watch_group = sec.u32();
+                for (size_t o = 0, ko = sec.count(4); o < ko; ++o) bk.out_ports.push_back(sec.u32());
+                g.buckets.push_back(std::move(bk));
+              }
+              ins.groups.push_back(std::move(g));
+            }
+            for (size_t j = 0, km = sec.count(19); j < km; ++j) {
+              Actuator::Meter m;
+              m.swid = sec.i32(); m.id = sec.u32();
+              m.band.type = MeterBand::Type(sec.u16()); m.band.rate_kbps = sec.u32();
+              m.band.burst_kb = sec.u32(); m.band.prec_level = sec.u8();
+              ins.meters.push_back(m);
+            }
+            s.shadow[fid] = std::move(ins);
+          }
+          break;
+        }
+        case kSecPlan: {
+          te::TE_Output plan;
+          for (size_t i = 0, k = sec.count(8); i < k; ++i) { const int f = sec.i32(); plan.chosen_path[f] = sec.i32(); }
+          for (size_t i = 0, k = sec.count(8); i < k; ++i) {
+            const int f = sec.i32();
+            auto& m = plan.split[f];
+            for (size_t j = 0, kp = sec.count(12); j < kp; ++j) { const int pid = sec.i32(); m[pid] = sec.f64(); }
+          }
+          for (size_t i = 0, k = sec.count(12); i < k; ++i) { const auto id = get_link(sec); plan.beta[id] = sec.i32(); }
+          for (size_t i = 0, k = sec.count(16); i < k; ++i) { const auto id = get_link(sec); plan.load_mbps[id] = sec.f64(); }
+          plan.objective = sec.f64(); plan.optimal = sec.u8() != 0; plan.status_text = sec.str();
+          s.plan = std::move(plan);
+          break;
+        }
+        default: break;   // 未知區段（同版本內新增的選用資料）略過
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "[snapshot] decode failed: " << e.what() << "\n";
+    return std::nullopt;
+  }
+  return s;
+}
+
+bool StateStore::save(const StateSnapshot& s) {
+  const auto img = encode(s);
+  // header 已帶 payload 長度與 FNV-1a：和上次寫出的一樣就不必再 msync + rename
+  Reader hr(img.data() + 16, 16);
+  const uint64_t plen = hr.u64(), sum = hr.u64();
+  if (saved_len_ && plen == saved_len_ && sum == saved_sum_) return true;
+  const std::string tmp = path_ + ".tmp";
+  const int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) { std::cerr << "[snapshot] open " << tmp << ": " << std::strerror(errno) << "\n"; return false; }
+  bool ok = ::ftruncate(fd, off_t(img.size())) == 0;
+  if (ok) {
+    void* m = ::mmap(nullptr, img.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) ok = false;
+    else {
+      std::memcpy(m, img.data(), img.size());
+      ok = ::msync(m, img.size(), MS_SYNC) == 0;
+      ::munmap(m, img.size());
+    }
+  }
+  ::close(fd);
+  if (ok) ok = ::rename(tmp.c_str(), path_.c_str()) == 0;
+  if (!ok) {
+    std::cerr << "[snapshot] write " << path_ << ": " << std::strerror(errno) << "\n";
+    ::unlink(tmp.c_str());
+    saved_len_ = saved_sum_ = 0;
+  } else {
+    saved_len_ = plen; saved_sum_ = sum;
+  }
+  return ok;
+}
+
+std::optional<StateSnapshot> StateStore::load() const {
+  const int fd = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return std::nullopt;   // 沒有快照 = 冷啟動
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 || st.st_size < off_t(kHeaderSize)) { ::close(fd); return std::nullopt; }
+  const size_t n = size_t(st.st_size);
+  void* m = ::mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (m == MAP_FAILED) return std::nullopt;
+  auto s = decode(static_cast<const uint8_t*>(m), n);
+  ::munmap(m, n);
+  return s;
+}
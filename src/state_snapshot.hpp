@@ -0,0 +1,59 @@
+#pragma once
+#ifndef HYBRID_STATE_SNAPSHOT_HPP
+#define HYBRID_STATE_SNAPSHOT_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "of_controller.hpp"  // WarmSwitchState
+#include "actuator.hpp"       // Actuator::Shadow
+#include "milp_te.hpp"        // te::TE_Output
+
+//
+//  Warm-restart State Snapshot
+//  -----------------------------------------------
+//  Controller + app state that is expensive to relearn: switch dpid -> swid
+//  assignments and MAC tables, the actuator's installed-rule shadow and the
+//  last TE plan. Stored as one versioned binary file:
+//
+//    header  : magic "HOFSNAP\0", format version, payload length, FNV-1a of payload
+//    payload : tagged sections (switches, shadow, plan)
+//
+//  save() writes a temp file through a shared mmap, msyncs it and rename()s it
+//  over the old one, so a crash mid-write leaves the previous snapshot intact.
+//  load() maps the file read-only; a bad magic, unknown version, truncation or
+//  checksum mismatch returns nullopt (cold start) instead of half a state.
+//
+//  The app saves after every TE wake-up; save() skips the write when the image
+//  matches the one this store wrote last (same length and checksum).
+//
+struct StateSnapshot {
+  std::vector<WarmSwitchState>  switches;
+  Actuator::Shadow              shadow;
+  std::optional<te::TE_Output>  plan;
+};
+
+class StateStore {
+public:
+  static constexpr uint32_t kFormatVersion = 1;
+
+  explicit StateStore(std::string path);
+
+  const std::string& path() const { return path_; }
+
+  // True if the file holds 's' afterwards (written now or unchanged since).
+  bool save(const StateSnapshot& s);
+  std::optional<StateSnapshot> load() const;
+
+  // Whole-file image (header + payload); exposed for tooling.
+  static std::vector<uint8_t> encode(const StateSnapshot& s);
+  static std::optional<StateSnapshot> decode(const uint8_t* p, size_t n);
+
+private:
+  std::string path_;
+  uint64_t saved_len_{0}, saved_sum_{0};   // 上次寫出的 payload；0 = 還沒寫過
+};
+
+#endif // HYBRID_STATE_SNAPSHOT_HPP
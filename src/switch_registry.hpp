@@ -0,0 +1,147 @@
+#pragma once
+#ifndef HYBRID_SWITCH_REGISTRY_HPP
+#define HYBRID_SWITCH_REGISTRY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+//
+//  Switch Registry
+//  -----------------------------------------------
+//  dpid -> swid assignment plus the live swid <-> connection bindings of one
+//  controller. The swid a switch gets does not depend on connection order:
+//
+//    1. pinned     : dpid -> node id from the topology config
+//    2. derived    : dpid itself when 1 <= dpid <= kMaxDerived (Mininet and
+//                    most lab setups number datapaths like the graph nodes)
+//    3. remembered : the swid this dpid had before (warm restart / reconnect)
+//    4. otherwise the lowest id nobody is bound to or has reserved
+//
+//  A pinned or remembered id is reserved for its dpid, so no other switch can
+//  take it while the owner is away. Lookups swid -> fd and fd -> swid are flat
+//  arrays, dpid -> swid a hash map; nothing on the hot path walks a map.
+//
+//  Not thread-safe: owned by the controller and used under its lock.
+//
+class SwitchRegistry {
+public:
+  static constexpr int kNone = -1;
+  static constexpr uint64_t kMaxDerived = 4096;
+
+  // ---- Assignment policy ----
+  void pin(uint64_t dpid, int swid) {
+    if (!dpid || swid <= 0) return;
+    if (auto it = pinned_.find(dpid); it != pinned_.end()) reserved_.erase(it->second);
+    pinned_[dpid] = swid;
+    reserved_[swid] = dpid;
+  }
+  void remember(uint64_t dpid, int swid) {
+    if (!dpid || swid <= 0 || pinned_.count(dpid)) return;
+    if (auto r = reserved_.find(swid); r != reserved_.end() && r->second != dpid) return;   // 已被別人保留
+    if (auto it = remembered_.find(dpid); it != remembered_.end() && it->second != swid) reserved_.erase(it->second);
+    remembered_[dpid] = swid;
+    reserved_[swid] = dpid;
+  }
+
+  // 依上述順序挑一個目前可用的 swid（不綁定）
+  int allocate(uint64_t dpid) const {
+    if (dpid) {
+      if (auto it = pinned_.find(dpid); it != pinned_.end() && available_(it->second, dpid)) return it->second;
+      if (dpid <= kMaxDerived && available_(int(dpid), dpid)) return int(dpid);
+      if (auto it = remembered_.find(dpid); it != remembered_.end() && available_(it->second, dpid)) return it->second;
+    }
+    int id = 1;
+    while (!available_(id, dpid)) ++id;
+    return id;
+  }
+
+  // ---- Bindings ----
+  // 綁定 swid ↔ fd；同一 dpid 的舊連線（尚未偵測到斷線）被新連線取代。
+  // swid 已屬於另一個 dpid 時拒絕，避免把規則送到錯的 switch。
+  bool bind(int swid, int fd, uint64_t dpid) {
+    if (swid <= 0 || fd < 0) return false;
+    grow_(fd_of_swid_, size_t(swid));
+    grow_(swid_of_fd_, size_t(fd));
+    if (dpid_at_.size() <= size_t(swid)) dpid_at_.resize(size_t(swid) + 1, 0);
+    const int old = fd_of_swid_[size_t(swid)];
+    if (old != kNone && old != fd) {
+      if (dpid_at_[size_t(swid)] != dpid) return false;
+      swid_of_fd_[size_t(old)] = kNone;
+      release_swid_(swid);
+    }
+    unbind_fd(fd);
+    if (dpid) {
+      if (auto it = swid_of_dpid_.find(dpid); it != swid_of_dpid_.end() && it->second != swid) release_swid_(it->second);
+      swid_of_dpid_[dpid] = swid;
+    }
+    fd_of_swid_[size_t(swid)] = fd;
+    swid_of_fd_[size_t(fd)] = swid;
+    dpid_at_[size_t(swid)] = dpid;
+    ++bound_;
+    return true;
+  }
+  void unbind_fd(int fd) {
+    const int swid = swid_of(fd);
+    if (swid == kNone) return;
+    swid_of_fd_[size_t(fd)] = kNone;
+    if (fd_of(swid) == fd) release_swid_(swid);
+  }
+  void clear() {
+    fd_of_swid_.clear(); swid_of_fd_.clear(); dpid_at_.clear(); swid_of_dpid_.clear(); bound_ = 0;
+  }
+
+  int fd_of(int swid) const {
+    return (swid > 0 && size_t(swid) < fd_of_swid_.size()) ? fd_of_swid_[size_t(swid)] : kNone;
+  }
+  int swid_of(int fd) const {
+    return (fd >= 0 && size_t(fd) < swid_of_fd_.size()) ? swid_of_fd_[size_t(fd)] : kNone;
+  }
+  int swid_of_dpid(uint64_t dpid) const {
+    auto it = swid_of_dpid_.find(dpid);
+    return it == swid_of_dpid_.end() ? kNone : it->second;
+  }
+  int fd_of_dpid(uint64_t dpid) const { return fd_of(swid_of_dpid(dpid)); }
+  size_t size() const { return bound_; }
+
+  // 依 swid 遞增走訪已綁定的 (swid, fd)
+  template<class F> void for_each(F&& f) const {
+    for (size_t s = 1; s < fd_of_swid_.size(); ++s)
+      if (fd_of_swid_[s] != kNone) f(int(s), fd_of_swid_[s]);
+  }
+  std::vector<int> ids() const {
+    std::vector<int> v; v.reserve(bound_);
+    for_each([&](int swid, int) { v.push_back(swid); });
+    return v;
+  }
+
+private:
+  static void grow_(std::vector<int>& v, size_t i) { if (v.size() <= i) v.resize(i + 1, kNone); }
+
+  bool available_(int swid, uint64_t dpid) const {
+    if (fd_of(swid) != kNone && dpid_at_[size_t(swid)] != dpid) return false;
+    auto r = reserved_.find(swid);
+    return r == reserved_.end() || r->second == dpid;
+  }
+  void release_swid_(int swid) {
+    if (size_t(swid) >= fd_of_swid_.size() || fd_of_swid_[size_t(swid)] == kNone) return;
+    const int fd = fd_of_swid_[size_t(swid)];
+    if (swid_of(fd) == swid) swid_of_fd_[size_t(fd)] = kNone;
+    fd_of_swid_[size_t(swid)] = kNone;
+    --bound_;
+    const uint64_t dpid = dpid_at_[size_t(swid)];
+    if (auto it = swid_of_dpid_.find(dpid); dpid && it != swid_of_dpid_.end() && it->second == swid) swid_of_dpid_.erase(it);
+    dpid_at_[size_t(swid)] = 0;
+  }
+
+  std::map<uint64_t, int> pinned_, remembered_;
+  std::map<int, uint64_t> reserved_;             // swid -> dpid（pinned 或 remembered）
+  std::vector<int> fd_of_swid_, swid_of_fd_;     // flat：index = swid / fd
+  std::vector<uint64_t> dpid_at_;                // index = swid；綁定中的 dpid
+  std::unordered_map<uint64_t, int> swid_of_dpid_;
+  size_t bound_{0};
+};
+
+#endif // HYBRID_SWITCH_REGISTRY_HPP
@@ -1,16 +1,26 @@
 // te_controller.cpp
-// Minimal OpenFlow 1.0 controller wrapped as class OFController (C++17)
+// Minimal OpenFlow 1.0 / 1.3 controller wrapped as class OFController (C++17)
 
 #include "of_controller.hpp"
+#include "latency_histogram.hpp"
+#include "event_bus.hpp"
+#include "msg_pool.hpp"
+#include "switch_registry.hpp"
+#include "of_codec.hpp"
 
 #include <arpa/inet.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/socket.h>
-#include <sys/select.h>
 #include <unistd.h>
+#include <deque>
 
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -19,565 +29,1468 @@
 #include <thread>
 #include <vector>
 #include <map>
+#include <memory>
+#include <set>
 #include <unordered_map>
 #include <cerrno>
+#include <climits>
 #include <sstream>
 #include <algorithm>
 using namespace std;
-
-// Minimal definitions so the linker can find them.
-OFController::OFController() : impl_(nullptr) {}
-OFController::~OFController() {}
+using namespace of;
 
 // -----------------------------
-// OpenFlow 1.0 wire structures
+// Helpers
 // -----------------------------
-#pragma pack(push, 1)
-struct ofp_header { uint8_t version, type; uint16_t length; uint32_t xid; };
-
-enum {
-  OFP_VERSION = 0x01,
-  OFPT_HELLO=0, OFPT_ERROR, OFPT_ECHO_REQUEST, OFPT_ECHO_REPLY, OFPT_VENDOR,
-  OFPT_FEATURES_REQUEST, OFPT_FEATURES_REPLY, OFPT_GET_CONFIG_REQUEST,
-  OFPT_GET_CONFIG_REPLY, OFPT_SET_CONFIG, OFPT_PACKET_IN, OFPT_FLOW_REMOVED,
-  OFPT_PORT_STATUS, OFPT_PACKET_OUT, OFPT_FLOW_MOD, OFPT_PORT_MOD,
-  OFPT_STATS_REQUEST=16, OFPT_STATS_REPLY=17, OFPT_BARRIER_REQUEST=18, OFPT_BARRIER_REPLY=19
-};
-
-struct ofp_switch_features {
-  ofp_header header;
-  uint64_t datapath_id;
-  uint32_t n_buffers;
-  uint8_t  n_tables; uint8_t pad[3];
-  uint32_t capabilities;
-  uint32_t actions;
-};
-
-struct ofp_switch_config {
-  ofp_header header;
-  uint16_t flags;
-  uint16_t miss_send_len;
-};
-
-struct ofp_match {
-  uint32_t wildcards;
-  uint16_t in_port;
-  uint8_t  dl_src[6], dl_dst[6];
-  uint16_t dl_vlan;
-  uint8_t  dl_vlan_pcp; uint8_t pad1;
-  uint16_t dl_type;
-  uint8_t  nw_tos, nw_proto;
-  uint8_t  nw_src[4], nw_dst[4];
-  uint16_t tp_src, tp_dst;
-};
-
-enum {
-  OFPFW_IN_PORT     = 1<<0,
-  OFPFW_DL_VLAN     = 1<<1,
-  OFPFW_DL_SRC      = 1<<2,
-  OFPFW_DL_DST      = 1<<3,
-  OFPFW_DL_TYPE     = 1<<4,
-  OFPFW_NW_TOS      = 1<<5,
-  OFPFW_NW_PROTO    = 1<<6,
-  OFPFW_TP_SRC      = 1<<7,
-  OFPFW_TP_DST      = 1<<8,
-  OFPFW_DL_VLAN_PCP = 1<<20,
-};
-
-struct ofp_action_output { uint16_t type, len; uint16_t port, max_len; };
-enum { OFPAT_OUTPUT = 0 };
-
-struct ofp_flow_mod {
-  ofp_header header;
-  ofp_match match;
-  uint64_t cookie;
-  uint16_t command;
-  uint16_t idle_timeout, hard_timeout;
-  uint16_t priority;
-  uint32_t buffer_id;
-  uint16_t out_port;
-  uint16_t flags;
-};
-
-enum {
-  OFPFC_ADD=0, OFPFC_MODIFY=1, OFPFC_MODIFY_STRICT=2,
-  OFPFC_DELETE=3, OFPFC_DELETE_STRICT=4
-};
+// 由 OFPPF_* 特徵位取最高速率（Mbps）；未知回傳 0。
+// 1.0 的 bit 7 是 COPPER，1.3 的 bit 7..9 才是 40G/100G/1T，因此需依版本解碼。
+static uint32_t speed_mbps_from_features(uint8_t ver, uint32_t bits){
+  if(ver >= OFP13_VERSION){
+    if(bits & OFPPF13_1TB_FD)   return 1000000;
+    if(bits & OFPPF13_100GB_FD) return 100000;
+    if(bits & OFPPF13_40GB_FD)  return 40000;
+  }
+  if(bits & OFPPF_10GB_FD) return 10000;
+  if(bits & OFPPF_1GB_FD  || bits & OFPPF_1GB_HD)   return 1000;
+  if(bits & OFPPF_100MB_FD|| bits & OFPPF_100MB_HD) return 100;
+  if(bits & OFPPF_10MB_FD || bits & OFPPF_10MB_HD)  return 10;
+  return 0;
+}
+static uint32_t advertise_mask_for_speed(uint8_t ver, int speedMbps){
+  if(ver >= OFP13_VERSION){
+    if(speedMbps>=100000) return OFPPF13_100GB_FD;
+    if(speedMbps>=40000)  return OFPPF13_40GB_FD;
+  }
+  if(speedMbps>=10000) return OFPPF_10GB_FD;
+  if(speedMbps>=1000)  return OFPPF_1GB_FD;
+  if(speedMbps>=100)   return OFPPF_100MB_FD;
+  if(speedMbps>=10)    return OFPPF_10MB_FD;
+  return 0;
+}
+// 內部一律用 1.0 的埠號表示法（保留埠 0xff00..0xffff）；送 1.3 時擴成 32-bit
+static uint32_t port_to_of13(uint32_t p){
+  if(p == OFPP_NONE) return OFPP13_ANY;
+  return (p >= OFPP_MAX && p <= 0xffff) ? (p | 0xffff0000u) : p;
+}
+static string mac_to_key(const uint8_t m[6]){
+  char buf[32]; snprintf(buf,sizeof(buf),"%02x:%02x:%02x:%02x:%02x:%02x",m[0],m[1],m[2],m[3],m[4],m[5]);
+  return string(buf);
+}
 
-struct ofp_packet_out {
-  ofp_header header;
-  uint32_t buffer_id;
-  uint16_t in_port;
-  uint16_t actions_len;
-  // actions...
-  // payload...
+// -----------------------------
+// Version-independent flow description
+// -----------------------------
+// flow_mod() 與 L2 學習共用；encode_flow_mod() 依連線協商的版本編成 1.0 或 1.3 訊息。
+struct FlowMatch {
+  uint32_t in_port{0};                          // 0 = wildcard
+  std::optional<std::array<uint8_t,6>> dl_dst;
+  bool     ipv4{false};                         // dl_type=0x0800（下列欄位的前提）
+  uint8_t  nw_proto{0};                         // 0 = wildcard
+  uint32_t nw_src{0}, nw_dst{0};                // network order
+  uint8_t  src_plen{0}, dst_plen{0};            // 前綴長度，0 = wildcard
+  std::optional<uint16_t> tp_src, tp_dst;
 };
 
-struct ofp_packet_in {
-  ofp_header header;
-  uint32_t buffer_id;
-  uint16_t total_len;
-  uint16_t in_port;
-  uint8_t  reason; uint8_t pad;
-  uint8_t  data[0];
+struct FlowSpec {
+  FlowMatch match;
+  uint16_t command{OFPFC_ADD};
+  uint64_t cookie{0};
+  uint16_t idle_timeout{0}, hard_timeout{0};
+  uint16_t priority{0};
+  uint32_t buffer_id{OFP_NO_BUFFER};
+  uint8_t  table_id{0};                         // 1.3 only
+  std::vector<uint32_t> out_ports;              // apply-actions: output（1.0 埠號表示法）
+  std::optional<uint32_t> group;                // apply-actions: group（1.3 only）
+  std::optional<uint8_t> goto_table;            // 1.3 only
+  std::optional<uint32_t> meter;                // 1.3 only
 };
 
-struct ofp_stats_request {
-  ofp_header header;
-  uint16_t type;
-  uint16_t flags;
-  uint8_t  body[0];
-};
+// 編碼器一律寫進呼叫端給的（通常來自 MsgPool 的）空 buffer
+static void append_action_output10(std::vector<uint8_t>& b, uint32_t port){
+  Out<ofp_action_output>::append(b)
+    .set(&ofp_action_output::type, OFPAT_OUTPUT)
+    .set(&ofp_action_output::len,  sizeof(ofp_action_output))
+    .set(&ofp_action_output::port, uint16_t(port));
+}
 
-struct ofp_stats_reply {
-  ofp_header header;
-  uint16_t type;
-  uint16_t flags;
-  uint8_t  body[0];
-};
+static void encode_flow_mod10(std::vector<uint8_t>& b, const FlowSpec& f, uint32_t xid){
+  const FlowMatch& m = f.match;
+  ofp_match mt{};
+  uint32_t wc = OFPFW_DL_VLAN | OFPFW_DL_SRC | OFPFW_DL_VLAN_PCP | OFPFW_NW_TOS;
+  if(m.in_port) mt.in_port = htobe16_u(uint16_t(m.in_port)); else wc |= OFPFW_IN_PORT;
+  if(m.dl_dst)  memcpy(mt.dl_dst, m.dl_dst->data(), 6);      else wc |= OFPFW_DL_DST;
+  if(m.ipv4)    mt.dl_type = htobe16_u(0x0800);               else wc |= OFPFW_DL_TYPE;
+  if(m.ipv4 && m.nw_proto) mt.nw_proto = m.nw_proto;         else wc |= OFPFW_NW_PROTO;
+  const uint32_t src_wc = m.ipv4 ? 32u - std::min<uint32_t>(32, m.src_plen) : 32u;
+  const uint32_t dst_wc = m.ipv4 ? 32u - std::min<uint32_t>(32, m.dst_plen) : 32u;
+  memcpy(mt.nw_src, &m.nw_src, 4);
+  memcpy(mt.nw_dst, &m.nw_dst, 4);
+  wc |= (src_wc << OFPFW_NW_SRC_SHIFT) | (dst_wc << OFPFW_NW_DST_SHIFT);
+  if(m.ipv4 && m.tp_src) mt.tp_src = htobe16_u(*m.tp_src); else wc |= OFPFW_TP_SRC;
+  if(m.ipv4 && m.tp_dst) mt.tp_dst = htobe16_u(*m.tp_dst); else wc |= OFPFW_TP_DST;
+  mt.wildcards = htobe32_u(wc);
+
+  auto fm = Out<ofp_flow_mod>::message<OFPT_FLOW_MOD>(b, OFP_VERSION);
+  fm.raw().match = mt;
+  fm.set(&ofp_flow_mod::cookie,       f.cookie)
+    .set(&ofp_flow_mod::command,      f.command)
+    .set(&ofp_flow_mod::idle_timeout, f.idle_timeout)
+    .set(&ofp_flow_mod::hard_timeout, f.hard_timeout)
+    .set(&ofp_flow_mod::priority,     f.priority)
+    .set(&ofp_flow_mod::buffer_id,    f.buffer_id)
+    .set(&ofp_flow_mod::out_port,     OFPP_NONE);
+  for(uint32_t p : f.out_ports) append_action_output10(b, p);
+  fm.close(xid);
+}
 
-enum { OFPST_DESC=0, OFPST_FLOW=1, OFPST_AGGREGATE=2, OFPST_TABLE=3, OFPST_PORT=4 };
+// 一個 OXM TLV（OpenFlow basic class）；mask 非空時帶 HASMASK
+static void put_oxm(std::vector<uint8_t>& b, uint8_t field, const void* val, size_t len, const void* mask = nullptr){
+  put16(b, OFPXMC_OPENFLOW_BASIC);
+  b.push_back(uint8_t((field << 1) | (mask ? 1 : 0)));
+  b.push_back(uint8_t(mask ? 2*len : len));
+  const uint8_t* v = (const uint8_t*)val; b.insert(b.end(), v, v+len);
+  if(mask){ const uint8_t* k = (const uint8_t*)mask; b.insert(b.end(), k, k+len); }
+}
+static void put_oxm_ipv4(std::vector<uint8_t>& b, uint8_t field, uint32_t addr_be, uint8_t plen){
+  if(plen >= 32){ put_oxm(b, field, &addr_be, 4); return; }
+  const uint32_t mask = htonl(~0u << (32 - plen));
+  const uint32_t val  = addr_be & mask;
+  put_oxm(b, field, &val, 4, &mask);
+}
 
-struct ofp_port_stats_request { uint16_t port_no; uint8_t pad[6]; };
+// ofp_match（OXM）附加到 b 尾端，含補齊 8 bytes
+static void append_match13(std::vector<uint8_t>& b, const FlowMatch& m){
+  const size_t start = b.size();
+  put16(b, OFPMT_OXM); put16(b, 0);
+  if(m.in_port){ const uint32_t p = htonl(m.in_port); put_oxm(b, OFPXMT_IN_PORT, &p, 4); }
+  if(m.dl_dst) put_oxm(b, OFPXMT_ETH_DST, m.dl_dst->data(), 6);
+  if(m.ipv4){
+    const uint16_t et = htons(0x0800); put_oxm(b, OFPXMT_ETH_TYPE, &et, 2);
+    if(m.nw_proto) put_oxm(b, OFPXMT_IP_PROTO, &m.nw_proto, 1);
+    if(m.src_plen) put_oxm_ipv4(b, OFPXMT_IPV4_SRC, m.nw_src, m.src_plen);
+    if(m.dst_plen) put_oxm_ipv4(b, OFPXMT_IPV4_DST, m.nw_dst, m.dst_plen);
+    // L4 埠以 ip_proto 為前提（1.0 不檢查，1.3 會回 BAD_PREREQ），非 TCP/UDP 時略過
+    if(m.nw_proto == 6 || m.nw_proto == 17){
+      const bool tcp = (m.nw_proto == 6);
+      if(m.tp_src){ const uint16_t v = htons(*m.tp_src); put_oxm(b, tcp ? OFPXMT_TCP_SRC : OFPXMT_UDP_SRC, &v, 2); }
+      if(m.tp_dst){ const uint16_t v = htons(*m.tp_dst); put_oxm(b, tcp ? OFPXMT_TCP_DST : OFPXMT_UDP_DST, &v, 2); }
+    }
+  }
+  const uint16_t mlen = uint16_t(b.size() - start);
+  b[start+2] = uint8_t(mlen >> 8); b[start+3] = uint8_t(mlen);
+  b.resize(start + pad8(mlen), 0);
+}
 
-struct ofp_port_stats {
-  uint16_t port_no; uint8_t pad[6];
-  uint64_t rx_packets, tx_packets, rx_bytes, tx_bytes;
-  uint64_t rx_dropped, tx_dropped, rx_errors, tx_errors;
-  uint64_t rx_frame_err, rx_over_err, rx_crc_err, collisions;
-};
+static void append_action_output13(std::vector<uint8_t>& b, uint32_t port){
+  Out<ofp13_action_output>::append(b)
+    .set(&ofp13_action_output::type,    OFPAT_OUTPUT)
+    .set(&ofp13_action_output::len,     sizeof(ofp13_action_output))
+    .set(&ofp13_action_output::port,    port_to_of13(port))
+    .set(&ofp13_action_output::max_len, port == OFPP_CONTROLLER ? OFPCML_NO_BUFFER : 0);
+}
+static void append_action_group13(std::vector<uint8_t>& b, uint32_t group_id){
+  Out<ofp13_action_group>::append(b)
+    .set(&ofp13_action_group::type,     OFPAT13_GROUP)
+    .set(&ofp13_action_group::len,      sizeof(ofp13_action_group))
+    .set(&ofp13_action_group::group_id, group_id);
+}
 
-struct ofp_port_mod {
-  ofp_header header;
-  uint16_t port_no;
-  uint8_t  hw_addr[6];
-  uint32_t config, mask;
-  uint32_t advertise;
-  uint8_t  pad[4];
-};
+static void encode_flow_mod13(std::vector<uint8_t>& b, const FlowSpec& f, uint32_t xid){
+  auto fm = Out<ofp13_flow_mod>::message<OFPT_FLOW_MOD>(b, OFP13_VERSION);
+  fm.set(&ofp13_flow_mod::cookie,       f.cookie)
+    .set(&ofp13_flow_mod::table_id,     f.table_id)
+    .set(&ofp13_flow_mod::command,      f.command)
+    .set(&ofp13_flow_mod::idle_timeout, f.idle_timeout)
+    .set(&ofp13_flow_mod::hard_timeout, f.hard_timeout)
+    .set(&ofp13_flow_mod::priority,     f.priority)
+    .set(&ofp13_flow_mod::buffer_id,    f.buffer_id)
+    .set(&ofp13_flow_mod::out_port,     OFPP13_ANY)
+    .set(&ofp13_flow_mod::out_group,    OFPG13_ANY);
+  append_match13(b, f.match);
+  if(f.meter){   // meter 指令先於 apply-actions 執行
+    Out<ofp13_instruction_meter>::append(b)
+      .set(&ofp13_instruction_meter::type,     OFPIT_METER)
+      .set(&ofp13_instruction_meter::len,      sizeof(ofp13_instruction_meter))
+      .set(&ofp13_instruction_meter::meter_id, *f.meter);
+  }
+  if(!f.out_ports.empty() || f.group){
+    auto ins = Out<ofp13_instruction_actions>::append(b);
+    ins.set(&ofp13_instruction_actions::type, OFPIT_APPLY_ACTIONS);
+    for(uint32_t p : f.out_ports) append_action_output13(b, p);
+    if(f.group) append_action_group13(b, *f.group);
+    ins.close_len(&ofp13_instruction_actions::len);
+  }
+  if(f.goto_table){
+    Out<ofp13_instruction_goto_table>::append(b)
+      .set(&ofp13_instruction_goto_table::type,     OFPIT_GOTO_TABLE)
+      .set(&ofp13_instruction_goto_table::len,      sizeof(ofp13_instruction_goto_table))
+      .set(&ofp13_instruction_goto_table::table_id, *f.goto_table);
+  }
+  fm.close(xid);
+}
 
-enum { OFPPC_PORT_DOWN = 1<<0 };
-enum { OFPP_NONE = 0xffff, OFPP_CONTROLLER = 0xfffd, OFPP_FLOOD = 0xfffb };
-enum {
-  OFPPF_10MB_HD  = 1<<0,  OFPPF_10MB_FD  = 1<<1,
-  OFPPF_100MB_HD = 1<<2,  OFPPF_100MB_FD = 1<<3,
-  OFPPF_1GB_HD   = 1<<4,  OFPPF_1GB_FD   = 1<<5,
-  OFPPF_10GB_FD  = 1<<6,
-};
-#pragma pack(pop)
+static void encode_flow_mod(std::vector<uint8_t>& b, uint8_t ver, const FlowSpec& f, uint32_t xid){
+  if(ver == OFP13_VERSION) encode_flow_mod13(b, f, xid); else encode_flow_mod10(b, f, xid);
+}
 
-// -----------------------------
-// Helpers
-// -----------------------------
-static uint16_t htobe16_u(uint16_t v){return htons(v);}
-static uint32_t htobe32_u(uint32_t v){return htonl(v);}
-static uint64_t htobe64_u(uint64_t v){
-  uint32_t hi = htonl(uint32_t(v>>32)), lo = htonl(uint32_t(v&0xffffffff));
-  return (uint64_t(lo) << 32) | hi;
+static void encode_group_mod13(std::vector<uint8_t>& b, uint32_t xid, uint16_t command, uint8_t type, uint32_t group_id,
+                               const std::vector<GroupBucket>& buckets){
+  auto gm = Out<ofp13_group_mod>::message<OFPT13_GROUP_MOD>(b, OFP13_VERSION);
+  gm.set(&ofp13_group_mod::command,  command)
+    .set(&ofp13_group_mod::type,     type)
+    .set(&ofp13_group_mod::group_id, group_id);
+  for(const auto& bk : buckets){
+    auto ob = Out<ofp13_bucket>::append(b);
+    ob.set(&ofp13_bucket::weight,      bk.weight)
+      .set(&ofp13_bucket::watch_port,  port_to_of13(bk.watch_port))
+      .set(&ofp13_bucket::watch_group, bk.watch_group);
+    for(uint32_t p : bk.out_ports) append_action_output13(b, p);
+    ob.close_len(&ofp13_bucket::len);
+  }
+  gm.close(xid);
 }
-static uint32_t advertise_mask_for_speed(int speedMbps){
-  if(speedMbps>=10000) return OFPPF_10GB_FD;
-  if(speedMbps>=1000)  return OFPPF_1GB_FD;
-  if(speedMbps>=100)   return OFPPF_100MB_FD;
-  if(speedMbps>=10)    return OFPPF_10MB_FD;
-  return 0;
+
+static void encode_meter_mod13(std::vector<uint8_t>& b, uint32_t xid, uint16_t command, uint32_t meter_id,
+                               const std::vector<MeterBand>& bands){
+  auto mm = Out<ofp13_meter_mod>::message<OFPT13_METER_MOD>(b, OFP13_VERSION);
+  uint16_t flags = OFPMF_KBPS;
+  for(const auto& mb : bands){
+    if(mb.burst_kb) flags |= OFPMF_BURST;
+    Out<ofp13_meter_band>::append(b)
+      .set(&ofp13_meter_band::type,       uint16_t(mb.type))
+      .set(&ofp13_meter_band::len,        sizeof(ofp13_meter_band))
+      .set(&ofp13_meter_band::rate,       mb.rate_kbps)
+      .set(&ofp13_meter_band::burst_size, mb.burst_kb)
+      .set(&ofp13_meter_band::prec_level, mb.type == MeterBand::Type::DscpRemark ? mb.prec_level : 0);
+  }
+  mm.set(&ofp13_meter_mod::command,  command)
+    .set(&ofp13_meter_mod::flags,    flags)
+    .set(&ofp13_meter_mod::meter_id, meter_id)
+    .close(xid);
 }
-static string mac_to_key(const uint8_t m[6]){
-  char buf[32]; snprintf(buf,sizeof(buf),"%02x:%02x:%02x:%02x:%02x:%02x",m[0],m[1],m[2],m[3],m[4],m[5]);
-  return string(buf);
+
+// PACKET_OUT：單一 output 動作；buffer_id 無效時附上 frame
+static void encode_packet_out(std::vector<uint8_t>& buf, uint8_t ver, uint32_t xid, uint32_t buffer_id,
+                              uint32_t in_port, uint32_t out_port,
+                              const uint8_t* data, size_t len){
+  if(buffer_id != OFP_NO_BUFFER) len = 0;
+  if(ver == OFP13_VERSION){
+    auto po = Out<ofp13_packet_out>::message<OFPT_PACKET_OUT>(buf, OFP13_VERSION);
+    po.set(&ofp13_packet_out::buffer_id,   buffer_id)
+      .set(&ofp13_packet_out::in_port,     in_port == OFPP_NONE ? OFPP13_CONTROLLER : port_to_of13(in_port))
+      .set(&ofp13_packet_out::actions_len, sizeof(ofp13_action_output));
+    append_action_output13(buf, out_port);
+    if(len) buf.insert(buf.end(), data, data+len);
+    po.close(xid);
+  } else {
+    auto po = Out<ofp_packet_out>::message<OFPT_PACKET_OUT>(buf, OFP_VERSION);
+    po.set(&ofp_packet_out::buffer_id,   buffer_id)
+      .set(&ofp_packet_out::in_port,     uint16_t(in_port))
+      .set(&ofp_packet_out::actions_len, sizeof(ofp_action_output));
+    append_action_output10(buf, out_port);
+    if(len) buf.insert(buf.end(), data, data+len);
+    po.close(xid);
+  }
 }
 
 // =============================
 // class OFController (impl.)
 // =============================
-class OFControllerImpl {
-public:
+// 每個 OFController 擁有自己的 Impl：socket、switch 表、回呼、執行緒皆為實例狀態，
+// 同一行程可在不同埠上同時跑多個 controller。
+struct OFController::Impl {
   std::atomic<uint32_t> xid{1};
-  std::mutex mtx;
+  mutable std::mutex mtx;
   std::thread loop_thread;
   int listen_fd{-1};
-  bool running{false};
+  std::atomic<bool> running{false};
+
+  // 週期設定（ms）
+  std::atomic<int64_t> lldp_period_ms{1000};
+  std::atomic<int64_t> stats_period_ms{2000};
+  // 自適應 LLDP 的退避上限；0 = 關閉（每輪每埠都探測）
+  std::atomic<int64_t> lldp_ceiling_ms{0};
+  static constexpr int kLldpHotProbes = 3;   // 變動後以快速週期探測的次數 / 有鄰居的埠容許連續漏接數
+
+  // HELLO 協商允許的版本（bit n = wire version n）
+  std::atomic<uint32_t> supported_versions{(1u<<OFP_VERSION) | (1u<<OFP13_VERSION)};
+
+  // I/O 執行緒 → 訂閱者（on_switch_state / on_packet_in / on_lldp / on_error / on_stats_reply）
+  EventBus bus;
+
+  // 由 FEATURES_REPLY / PORT_DESC / PORT_STATUS 得到的埠描述（host order）
+  struct PortDesc {
+    uint8_t  ver{OFP_VERSION};        // 決定 curr/advertised 的位元意義
+    uint32_t config{0}, state{0};
+    uint32_t curr{0}, advertised{0};
+    uint32_t curr_speed_kbps{0};      // 1.3 才有；0 = 未回報
+    std::array<uint8_t,6> hw_addr{};  // PORT_MOD 需帶正確的 hw_addr
+    bool up() const { return !(config & OFPPC_PORT_DOWN) && link_up(); }
+    // 只看實體鏈路；管理性關閉（含 TE 讓鏈路休眠）不算
+    bool link_up() const { return !(state & OFPPS_LINK_DOWN); }
+    // 1.3 以 curr_speed 為準；否則取 curr 特徵位，switch 沒回報 curr 時退回 advertised
+    uint32_t speed_mbps() const {
+      if(curr_speed_kbps) return curr_speed_kbps / 1000;
+      uint32_t s = speed_mbps_from_features(ver, curr);
+      return s ? s : speed_mbps_from_features(ver, advertised);
+    }
+  };
+
+  // 埠計數（host order）；duration_ns 只有 1.3 回報，1.0 為 0
+  struct PortCounters {
+    uint64_t rx_packets{0}, tx_packets{0}, rx_bytes{0}, tx_bytes{0};
+    uint64_t rx_dropped{0}, tx_dropped{0}, rx_errors{0}, tx_errors{0};
+    uint64_t duration_ns{0};
+  };
+
+  // 每個埠的 LLDP 探測排程（自適應模式）：
+  //   穩定（有回音、無 PORT_STATUS）→ 間隔倍增到上限
+  //   新埠 / PORT_STATUS / 漏接 / 鄰居改變 → 接下來 kLldpHotProbes 次用快速週期
+  //   沒鄰居的埠（連續漏接）→ 同樣退避到上限
+  // 有鄰居的埠送出後 lldp_fast_ms 內沒回音就算漏接（不等到下一次排程），
+  // 連續 kLldpHotProbes 次 → 發布 LinkDown(ProbeLoss)
+  struct LldpProbe {
+    int64_t interval_ms{0};                        // 0 = 尚未探測過
+    std::chrono::steady_clock::time_point due{};
+    std::chrono::steady_clock::time_point sent_at{};
+    bool awaiting{false};    // 已送出，還沒收到自己的 LLDP
+    bool linked{false};      // 最近收到過回音
+    int  misses{0};
+    int  hot{kLldpHotProbes};
+    int  peer_sw{0}, peer_port{0};
+  };
+
+  // 握手狀態：Queued（等名額）→ Hello → Features → Config → Ready
+  enum class Hs : uint8_t { Queued, Hello, Features, Config, Ready };
+
+  // 控制通道計量：收發都在持有 mtx 時發生（reactor 與 API 呼叫端皆然），
+  // 直接累加即可，不另外加鎖；metrics_snapshot() 取 mtx 複製
+  static constexpr size_t kTypeSlots = 32;   // OFPT 0..31（1.3 最大為 29）
+  struct ChanStats {
+    std::array<uint64_t, kTypeSlots> in{}, out{};
+    uint64_t bytes_in{0}, bytes_out{0};
+    uint64_t packet_ins{0};
+    uint64_t pin_window{0};                  // 目前 1 秒窗內的 packet-in
+    std::chrono::steady_clock::time_point pin_window_start{};
+    double   pin_rate{0.0};                  // 上一個完整窗的速率
+    uint32_t queue_depth{0}, queue_depth_max{0};
+    uint64_t send_stalls{0}, send_stall_ms{0};
+    LatencyHistogram wait_us, handle_us;
+  };
+  static size_t type_slot(uint8_t t){ return std::min<size_t>(t, kTypeSlots - 1); }
 
   struct SwCtx {
     int fd{-1};
+    Hs hs{Hs::Queued};
+    bool cfg_ok{false};      // GET_CONFIG_REPLY 已收到
+    bool ports_ok{false};    // 1.3：PORT_DESC 已收到
+    std::chrono::steady_clock::time_point accepted_at{}, admitted_at{};
+    double handshake_ms{0.0};  // accept → Ready（含排隊）
+    MsgPool::Lease rx;         // 非阻塞收包的未完成訊息
+    std::vector<uint8_t> tx;   // 送緩衝滿時還沒送出的位元組，POLLOUT 時續送
+    std::chrono::steady_clock::time_point tx_stalled_at{};
+    uint8_t version{0};      // HELLO 協商結果；0 = 尚未協商
     uint64_t dpid{0};
-    std::map<int/*port*/, ofp_port_stats> last_ps;
+    uint8_t n_tables{0};
+    bool pipeline{false};    // 1.3 且 n_tables ≥ 2：table 0 = TE、table 1 = L2
+    std::map<int/*table*/, uint64_t> flow_mods;  // 每張表送出的 flow_mod 數（churn）
+    bool connected{false};   // hs == Ready
+    bool handed_off{false};  // 分片模式：dpid 不屬於本 shard，關閉時把 fd 交給 owner 而非 close
+    std::map<int/*port*/, PortCounters> last_ps;
+    std::map<int/*port*/, PortDesc> port_desc;
+    std::map<int/*port*/, LldpProbe> lldp;
+    std::map<uint32_t/*xid*/, std::vector<uint8_t>> mp_partial;  // 分段中的 multipart body
     // 簡易 L2 學習表：mac -> port
     std::unordered_map<std::string,int> mac2port;
+    // echo 探測：未回覆的 xid（0 = 無）、RTT 直方圖
+    uint32_t echo_xid{0};
+    std::chrono::steady_clock::time_point echo_last_sent{};
+    uint32_t echo_consec_missed{0};
+    uint64_t echo_sent{0}, echo_replies{0}, echo_missed{0};
+    LatencyHistogram rtt_us;
+    ChanStats chan;
   };
-  std::map<int,int> sw_index_to_fd; // sw index (1..N) -> fd
+  MsgPool pool;                     // 本 reactor 的訊息 buffer（須在 sw 之前建構、之後解構）
+  SwitchRegistry reg;               // dpid → swid 指派與 swid ↔ fd 綁定（O(1) 查詢）
   std::map<int, SwCtx> sw;          // fd -> ctx
+  std::map<uint64_t, WarmSwitchState> warm;  // 未連線但記得的 dpid（匯入的快照或已斷線）
+
+  // 握手併發上限：超過的連線依 accept 順序排隊，不讀也不送
+  std::atomic<size_t>  hs_limit{256};
+  std::atomic<int64_t> hs_timeout_ms{10000};
+  size_t hs_active{0};
+  std::deque<int> hs_queue;
+  uint64_t hs_completed{0}, hs_timed_out{0};
+  LatencyHistogram hs_us;    // accept → Ready
+
+  // 分片 hooks（未設定 = 單一行程）；送往其他 shard 的 switch 以 -swid 當 fd
+  OFController::ShardHooks hooks;
+  static constexpr int kNoTarget = INT_MIN;
+  // swid → 本行程 fd；其他 shard 持有且可轉送的 switch 回傳 -swid；都不是回傳 kNoTarget
+  int target_locked(int swid) const {
+    if(const int fd = reg.fd_of(swid); fd >= 0) return fd;
+    if(swid > 0 && hooks.forward && hooks.remote_version && hooks.remote_version(swid)) return -swid;
+    return kNoTarget;
+  }
+
+  // 指派順序見 SwitchRegistry（設定檔指定 > dpid 本身 > 以前用過的 > 最小可用）；
+  // 分片模式再交給共享目錄確認，跨 shard 不重複
+  int alloc_swid_locked(uint64_t dpid) const {
+    const int want = reg.allocate(dpid);
+    if(hooks.swid_for && dpid){
+      const int id = hooks.swid_for(dpid, want);
+      if(id > 0) return id;
+    }
+    return want;
+  }
+  WarmSwitchState warm_of_locked(int fd, int swid) const {
+    WarmSwitchState st; st.dpid = sw.at(fd).dpid; st.swid = swid;
+    for(const auto& kv : sw.at(fd).mac2port){
+      std::array<uint8_t,6> m{}; unsigned b[6];
+      if(sscanf(kv.first.c_str(), "%x:%x:%x:%x:%x:%x", &b[0],&b[1],&b[2],&b[3],&b[4],&b[5]) != 6) continue;
+      for(int i = 0; i < 6; ++i) m[i] = uint8_t(b[i]);
+      st.macs.push_back({m, kv.second});
+    }
+    return st;
+  }
+
+  // echo 探測設定（0 = 關閉）
+  std::atomic<int64_t> echo_interval_ms{200};
+  std::atomic<int>     echo_max_missed{3};
+
+  int swid_of_fd_locked(int fd) const { return reg.swid_of(fd); }
+  uint8_t version_of(int fd) const {
+    if(fd < 0 && fd != kNoTarget && hooks.remote_version){
+      const uint8_t v = hooks.remote_version(-fd);
+      return v ? v : uint8_t(OFP_VERSION);
+    }
+    auto it = sw.find(fd);
+    return (it == sw.end() || !it->second.version) ? uint8_t(OFP_VERSION) : it->second.version;
+  }
+  void publish_switch_state(int swid, bool up){
+    OFEvent e; e.kind=OFEvent::Kind::SwitchState; e.swid=swid; e.up=up;
+    bus.publish(std::move(e));
+  }
+  void publish_link_down(int fd, int port, LinkDownEvent::Cause cause){
+    const int swid = swid_of_fd_locked(fd);
+    if(swid <= 0) return;
+    OFEvent e; e.kind=OFEvent::Kind::LinkDown; e.swid=swid;
+    e.link = LinkDownEvent{swid, port, cause};
+    bus.publish(std::move(e));
+  }
+  void mark_connected(int fd){
+    auto& s = sw[fd];
+    if(s.connected) return;
+    s.connected = true;
+    const int swid = swid_of_fd_locked(fd);
+    publish_switch_state(swid, true);
+    if(hooks.on_state) hooks.on_state(swid, s.dpid, s.version, true);
+  }
+  // Config 階段：1.0 等 GET_CONFIG_REPLY，1.3 另需 PORT_DESC
+  void maybe_ready(int fd){
+    auto& s = sw[fd];
+    if(s.hs != Hs::Config || !s.cfg_ok || (s.version == OFP13_VERSION && !s.ports_ok)) return;
+    s.hs = Hs::Ready;
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - s.accepted_at).count();
+    s.handshake_ms = us / 1000.0;
+    hs_us.record(uint64_t(us));
+    ++hs_completed;
+    if(hs_active) --hs_active;
+    mark_connected(fd);
+  }
+  // 依序放行排隊中的連線；送 HELLO 失敗者交給 dead
+  void admit_locked(std::vector<int>& dead){
+    while(hs_active < hs_limit.load() && !hs_queue.empty()){
+      const int fd = hs_queue.front(); hs_queue.pop_front();
+      auto it = sw.find(fd);
+      if(it == sw.end() || it->second.hs != Hs::Queued) continue;
+      it->second.hs = Hs::Hello;
+      it->second.admitted_at = std::chrono::steady_clock::now();
+      ++hs_active;
+      try { send_hello(fd); }   // FEATURES_REQUEST 等收到對方 HELLO 後再送
+      catch(const std::exception&){ dead.push_back(fd); }
+    }
+  }
 
   // --- send helpers ---
-  static void send_all(int fd, const void* buf, size_t len){
+  // socket 為非阻塞：送緩衝滿時剩下的排進 SwCtx::tx，由 reactor 在 POLLOUT 時續送，
+  // 不在 mtx 底下等；積壓超過 kSendQueueMax 視為斷線
+  static constexpr size_t kSendQueueMax = 4u << 20;
+  // 呼叫端持有 mtx；每次呼叫送一則完整訊息。fd < 0（見 target_locked）轉給持有該 switch 的 shard
+  // msgs：buf 內串接的訊息數（同型別批次，例如 LLDP 輪），計量用
+  void send_all(int fd, const void* buf, size_t len, size_t msgs = 1){
     const uint8_t* p=(const uint8_t*)buf; size_t off=0;
-    while(off<len){
-      ssize_t w=send(fd, p+off, len-off, 0);
+    if(fd < 0){
+      if(fd == kNoTarget || !hooks.forward || !hooks.forward(-fd, p, len)) throw std::runtime_error("forward failed");
+      return;
+    }
+    auto sit = sw.find(fd);
+    SwCtx* s = (sit == sw.end()) ? nullptr : &sit->second;
+    // 有積壓時先試著送掉，仍有剩就排在後面，維持訊息順序
+    if(s && !s->tx.empty() && !flush_locked(fd, *s)) throw std::runtime_error("send failed");
+    while(off<len && (!s || s->tx.empty())){
+      ssize_t w=send(fd, p+off, len-off, MSG_NOSIGNAL);
+      if(w<0 && (errno==EAGAIN || errno==EWOULDBLOCK)) break;
+      if(w<0 && errno==EINTR) continue;
       if(w<=0) throw std::runtime_error("send failed");
       off+=size_t(w);
     }
+    if(off<len){
+      if(!s || s->tx.size() + (len-off) > kSendQueueMax) throw std::runtime_error("send queue full");
+      if(s->tx.empty()){ ++s->chan.send_stalls; s->tx_stalled_at = std::chrono::steady_clock::now(); }
+      s->tx.insert(s->tx.end(), p+off, p+len);
+    }
+    if(s){
+      s->chan.bytes_out += len;
+      if(len >= sizeof(ofp_header)) s->chan.out[type_slot(p[1])] += msgs;
+    }
   }
-  static int listen_on(uint16_t port){
+  // 續送積壓；false = 連線已壞。送完時把積壓的時間記進 send_stall_ms
+  bool flush_locked(int fd, SwCtx& s){
+    size_t off = 0;
+    while(off < s.tx.size()){
+      ssize_t w = send(fd, s.tx.data()+off, s.tx.size()-off, MSG_NOSIGNAL);
+      if(w<0 && (errno==EAGAIN || errno==EWOULDBLOCK)) break;
+      if(w<0 && errno==EINTR) continue;
+      if(w<=0) return false;
+      off += size_t(w);
+    }
+    s.tx.erase(s.tx.begin(), s.tx.begin() + std::ptrdiff_t(off));
+    if(s.tx.empty() && off)
+      s.chan.send_stall_ms += uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::steady_clock::now() - s.tx_stalled_at).count());
+    return true;
+  }
+  // reuse_port：各 shard 各自 listen 同一埠，由 kernel 分配新連線
+  static int listen_on(uint16_t port, bool reuse_port){
     int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd<0){ perror("socket"); return -1; }
     int on=1; setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+    if(reuse_port && setsockopt(fd,SOL_SOCKET,SO_REUSEPORT,&on,sizeof(on))<0){ perror("SO_REUSEPORT"); close(fd); return -1; }
     sockaddr_in a{}; a.sin_family=AF_INET; a.sin_addr.s_addr=htonl(INADDR_ANY); a.sin_port=htons(port);
-    if(bind(fd,(sockaddr*)&a,sizeof(a))<0){ perror("bind"); return -1; }
-    if(listen(fd,64)<0){ perror("listen"); close(fd); return -1; }
+    if(bind(fd,(sockaddr*)&a,sizeof(a))<0){ perror("bind"); close(fd); return -1; }
+    if(listen(fd,SOMAXCONN)<0){ perror("listen"); close(fd); return -1; }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);   // accept 迴圈一次取完
     return fd;
   }
 
-  void send_hello(int fd){
-    ofp_header h{}; h.version=OFP_VERSION; h.type=OFPT_HELLO;
-    h.length=htobe16_u(sizeof(h)); h.xid=htobe32_u(xid++);
+  template<uint8_t Type>
+  void send_header_only(int fd){
+    const auto h = make<ofp_header, Type>(version_of(fd), xid++);
     send_all(fd,&h,sizeof(h));
   }
-  void send_features_req(int fd){
-    ofp_header h{}; h.version=OFP_VERSION; h.type=OFPT_FEATURES_REQUEST;
-    h.length=htobe16_u(sizeof(h)); h.xid=htobe32_u(xid++);
-    send_all(fd,&h,sizeof(h));
+  // 以支援的最高版本送 HELLO；>=1.3 時附 version bitmap element
+  void send_hello(int fd){
+    const uint32_t bm = supported_versions.load();
+    const uint8_t top = uint8_t(31 - __builtin_clz(bm));
+    auto buf = pool.acquire();
+    auto h = Out<ofp_header>::message<OFPT_HELLO>(*buf, top);
+    if(top >= OFP13_VERSION){
+      Out<ofp_hello_elem_header>::append(*buf)
+        .set(&ofp_hello_elem_header::type,   OFPHET_VERSIONBITMAP)
+        .set(&ofp_hello_elem_header::length, sizeof(ofp_hello_elem_header) + 4);
+      put32(*buf, bm);
+    }
+    h.close(xid++);
+    send_all(fd, buf->data(), buf->size());
   }
-  void send_get_config_req(int fd){
-    ofp_header h{}; h.version=OFP_VERSION; h.type=OFPT_GET_CONFIG_REQUEST;
-    h.length=htobe16_u(sizeof(h)); h.xid=htobe32_u(xid++);
-    send_all(fd,&h,sizeof(h));
+  void send_hello_failed(int fd, uint8_t peer_version){
+    static const char why[] = "no common OpenFlow version";
+    auto buf = pool.acquire();
+    auto h = Out<ofp_header>::message<OFPT_ERROR>(*buf, peer_version);
+    put16(*buf, OFPET_HELLO_FAILED); put16(*buf, OFPHFC_INCOMPATIBLE);
+    buf->insert(buf->end(), why, why + sizeof(why) - 1);
+    h.close(xid++);
+    send_all(fd, buf->data(), buf->size());
   }
+  void send_features_req(int fd)  { send_header_only<OFPT_FEATURES_REQUEST>(fd); }
+  void send_get_config_req(int fd){ send_header_only<OFPT_GET_CONFIG_REQUEST>(fd); }
   void send_set_config(int fd, uint16_t flags/*=0*/, uint16_t miss/*=0xffff*/){
-    ofp_switch_config c{}; c.header.version=OFP_VERSION; c.header.type=OFPT_SET_CONFIG;
-    c.flags=htobe16_u(flags); c.miss_send_len=htobe16_u(miss);
-    c.header.length=htobe16_u(sizeof(c)); c.header.xid=htobe32_u(xid++);
+    auto c = make<ofp_switch_config, OFPT_SET_CONFIG>(version_of(fd), xid++);
+    c.flags = to_be(flags); c.miss_send_len = to_be(miss);
     send_all(fd,&c,sizeof(c));
   }
-  void send_echo_reply(int fd, const ofp_header* req, const uint8_t* payload, size_t len){
-    std::vector<uint8_t> buf(sizeof(ofp_header)+len);
-    auto* h=(ofp_header*)buf.data(); h->version=OFP_VERSION; h->type=OFPT_ECHO_REPLY;
-    h->length=htobe16_u(buf.size()); h->xid=req->xid;
-    if(len) memcpy(buf.data()+sizeof(ofp_header), payload, len);
-    send_all(fd, buf.data(), buf.size());
+  // 原樣帶回 payload 與 xid
+  void send_echo_reply(int fd, View<ofp_header> req){
+    auto buf = pool.acquire();
+    auto h = Out<ofp_header>::message<OFPT_ECHO_REPLY>(*buf, req.get(&ofp_header::version));
+    const Bytes payload = req.tail();
+    buf->insert(buf->end(), payload.begin(), payload.end());
+    h.close(req.get(&ofp_header::xid));
+    send_all(fd, buf->data(), buf->size());
+  }
+  // ECHO 帶 8-byte 發送時間（steady_clock ns, big-endian）
+  uint32_t send_echo_request(int fd, std::chrono::steady_clock::time_point now){
+    const uint32_t x = xid++;
+    auto m = make<ofp_echo_stamp, OFPT_ECHO_REQUEST>(version_of(fd), x);
+    m.ts_ns = to_be(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count()));
+    send_all(fd,&m,sizeof(m));
+    return x;
   }
   void send_barrier(int fd){
-    ofp_header h{}; h.version=OFP_VERSION; h.type=OFPT_BARRIER_REQUEST;
-    h.length=htobe16_u(sizeof(h)); h.xid=htobe32_u(xid++);
-    send_all(fd,&h,sizeof(h));
+    if(version_of(fd) == OFP13_VERSION) send_header_only<OFPT13_BARRIER_REQUEST>(fd);
+    else send_header_only<OFPT_BARRIER_REQUEST>(fd);
+  }
+  void send_flow(int fd, const FlowSpec& f){
+    auto buf = pool.acquire();
+    encode_flow_mod(*buf, version_of(fd), f, xid++);
+    send_all(fd, buf->data(), buf->size());
+    if(auto it = sw.find(fd); it != sw.end()) ++it->second.flow_mods[f.table_id];
+  }
+  // 1.3 table-miss（1.3 預設是丟棄）：
+  //   單表          → table 0 送 controller
+  //   pipeline      → table 0（TE）未命中 goto table 1（L2），table 1 未命中送 controller
+  void install_table_miss(int fd, uint8_t table){
+    FlowSpec f; f.priority = 0; f.table_id = table;
+    if(sw[fd].pipeline && table == OFController::kTableTE) f.goto_table = OFController::kTableL2;
+    else f.out_ports = {OFPP_CONTROLLER};
+    send_flow(fd, f);
+  }
+  void install_pipeline(int fd){
+    auto& s = sw[fd];
+    s.pipeline = (s.version == OFP13_VERSION && s.n_tables > OFController::kTableL2);
+    install_table_miss(fd, OFController::kTableTE);
+    if(s.pipeline) install_table_miss(fd, OFController::kTableL2);
   }
 
-  static std::vector<uint8_t> build_lldp_eth(uint64_t chassis_id, uint16_t port_no){
-    std::vector<uint8_t> f;
+  static void build_lldp_eth(std::vector<uint8_t>& f, uint64_t chassis_id, uint16_t port_no){
     auto push16=[&](uint16_t v){ f.push_back(uint8_t(v>>8)); f.push_back(uint8_t(v)); };
-    uint8_t dst[6]={0x01,0x80,0xc2,0x00,0x00,0x0e};
-    uint8_t src[6]={0x02,0x00,0x00,0x00,0x00,0x01};
+    static const uint8_t dst[6]={0x01,0x80,0xc2,0x00,0x00,0x0e};
+    static const uint8_t src[6]={0x02,0x00,0x00,0x00,0x00,0x01};
     f.insert(end(f), dst,dst+6); f.insert(end(f), src,src+6); push16(0x88cc);
-    { std::vector<uint8_t> v; v.push_back(7);
-      for(int i=7;i>=0;--i) v.push_back(uint8_t((chassis_id>>(8*i))&0xff));
-      uint16_t tl=(1<<9)|(uint16_t(v.size())&0x1ff); push16(tl); f.insert(end(f),begin(v),end(v));
-    }
-    { std::vector<uint8_t> v; v.push_back(5); v.push_back(uint8_t(port_no>>8)); v.push_back(uint8_t(port_no));
-      uint16_t tl=(2<<9)|(uint16_t(v.size())&0x1ff); push16(tl); f.insert(end(f),begin(v),end(v));
+    { push16((1<<9)|9); f.push_back(7);                 // chassis id：subtype 7 + dpid
+      for(int i=7;i>=0;--i) f.push_back(uint8_t((chassis_id>>(8*i))&0xff));
     }
+    { push16((2<<9)|3); f.push_back(5); push16(port_no); } // port id：subtype 5 + 埠號
     { push16((3<<9)|2); push16(120); } // TTL
     { push16(0); } // End TLV
     if(f.size()<14+46) f.resize(14+46,0);
-    return f;
+  }
+
+  static constexpr size_t kLldpPortOff = 14 + 11 + 3;   // eth + chassis TLV + port TLV 標頭/subtype
+
+  int64_t lldp_fast_ms() const { return std::max<int64_t>(lldp_period_ms.load() / 4, 25); }
+  // 自適應模式下 reactor 以快速週期檢查到期的埠
+  int64_t lldp_tick_ms() const { return lldp_ceiling_ms.load() > 0 ? lldp_fast_ms() : lldp_period_ms.load(); }
+
+  // 這個埠本輪要不要探測；要的話結算上一次探測並排定下一次。
+  // force（手動觸發的一輪）一律送，但不打亂排程；*lost = 這次結算判定鄰居消失
+  bool lldp_due_locked(LldpProbe& p, std::chrono::steady_clock::time_point now, bool force, bool* lost){
+    const int64_t base = lldp_period_ms.load();
+    const int64_t ceil = std::max(lldp_ceiling_ms.load(), base);
+    if(lldp_ceiling_ms.load() <= 0) return true;
+    // 有鄰居的埠等回音只等一個快速週期，不必等退避後的下一次排程
+    const bool overdue = p.awaiting && p.linked && now - p.sent_at >= std::chrono::milliseconds(lldp_fast_ms());
+    if(now < p.due && !overdue){
+      if(force){ p.awaiting = true; p.sent_at = now; }
+      return force;
+    }
+    if(p.awaiting && p.linked){
+      if(++p.misses >= kLldpHotProbes){ p.linked = false; *lost = true; }   // 連續漏接：鄰居不在了，照常退避
+      else p.hot = kLldpHotProbes;
+    }
+    if(p.hot > 0){ --p.hot; p.interval_ms = lldp_fast_ms(); }
+    else p.interval_ms = std::min(std::max(p.interval_ms * 2, base), ceil);
+    p.awaiting = true;
+    p.sent_at = now;
+    p.due = now + std::chrono::milliseconds(p.interval_ms);
+    return true;
+  }
+  // 收到 (fd, port) 送出的 LLDP
+  void lldp_heard_locked(int fd, int port, int peer_sw, int peer_port){
+    auto sit = sw.find(fd);
+    if(sit == sw.end()) return;
+    auto& p = sit->second.lldp[port];
+    if(p.linked && (p.peer_sw != peer_sw || p.peer_port != peer_port)) lldp_hot(p);   // 鄰居換了：當作 flap
+    p.awaiting = false; p.linked = true; p.misses = 0;
+    p.peer_sw = peer_sw; p.peer_port = peer_port;
+  }
+  // PORT_STATUS 或 flap：下一輪立刻探測，之後維持快速幾次
+  static void lldp_hot(LldpProbe& p){ p.hot = kLldpHotProbes; p.due = {}; }
+
+  // 一台 switch 的 LLDP：探測框只建一次、逐埠改寫 port TLV，所有 PACKET_OUT
+  // 串在同一個 buffer，一次 send 出去。只探測 up 的實體埠（不含 LOCAL 等保留埠）。
+  size_t lldp_burst_locked(int fd, SwCtx& s, std::vector<uint8_t>& frame, std::vector<uint8_t>& batch,
+                           std::chrono::steady_clock::time_point now, bool force){
+    frame.clear(); batch.clear();
+    build_lldp_eth(frame, s.dpid ? s.dpid : 0xdeadbeef, 0);
+    const uint32_t max_port = (s.version == OFP13_VERSION) ? OFPP13_MAX : uint32_t(OFPP_MAX);
+    size_t n = 0;
+    auto emit = [&](int port){
+      if(port <= 0 || uint32_t(port) >= max_port) return;
+      bool lost = false;
+      const bool due = lldp_due_locked(s.lldp[port], now, force, &lost);
+      if(lost) publish_link_down(fd, port, LinkDownEvent::Cause::ProbeLoss);
+      if(!due) return;
+      frame[kLldpPortOff] = uint8_t(port >> 8); frame[kLldpPortOff + 1] = uint8_t(port);
+      encode_packet_out(batch, s.version, xid++, OFP_NO_BUFFER, OFPP_NONE, uint32_t(port), frame.data(), frame.size());
+      ++n;
+    };
+    // 埠描述 ∪ 只出現在統計裡的埠（與 ports_of 相同）
+    for(const auto& kv : s.port_desc) if(kv.second.up()) emit(kv.first);
+    for(const auto& kv : s.last_ps)   if(!s.port_desc.count(kv.first)) emit(kv.first);
+    if(!n) return 0;
+    try { send_all(fd, batch.data(), batch.size(), n); }
+    catch(const std::exception&){ return 0; }   // 斷線由下一輪 recv/echo 處理
+    return n;
+  }
+  // only_fd < 0：所有已就緒的本地 switch；force：不看排程，每個埠都送
+  size_t lldp_round_locked(int only_fd = -1, bool force = false){
+    auto frame = pool.acquire();
+    auto batch = pool.acquire();
+    const auto now = std::chrono::steady_clock::now();
+    size_t sent = 0;
+    for(auto& kv : sw){
+      if(only_fd >= 0 && kv.first != only_fd) continue;
+      if(!kv.second.connected || kv.second.handed_off) continue;
+      sent += lldp_burst_locked(kv.first, kv.second, *frame, *batch, now, force);
+    }
+    return sent;
   }
 
   void packet_out_lldp(int fd, uint16_t out_port, uint64_t dpid){
-    auto frame=build_lldp_eth(dpid,out_port);
-    ofp_action_output act{htobe16_u(OFPAT_OUTPUT),htobe16_u(sizeof(ofp_action_output)),
-                          htobe16_u(out_port),htobe16_u(0)};
-    ofp_packet_out po{};
-    po.header.version=OFP_VERSION; po.header.type=OFPT_PACKET_OUT;
-    po.buffer_id=htobe32_u(0xffffffff); po.in_port=htobe16_u(OFPP_NONE);
-    po.actions_len=htobe16_u(sizeof(act));
-    po.header.length=htobe16_u(sizeof(po)+sizeof(act)+frame.size());
-    po.header.xid=htobe32_u(xid++);
-    std::vector<uint8_t> buf(sizeof(po)+sizeof(act)+frame.size());
-    memcpy(buf.data(),&po,sizeof(po));
-    memcpy(buf.data()+sizeof(po),&act,sizeof(act));
-    memcpy(buf.data()+sizeof(po)+sizeof(act),frame.data(),frame.size());
-    send_all(fd,buf.data(),buf.size());
-  }
-
-  void send_packet_out_with_buffer(int fd, uint32_t buffer_id, uint16_t in_port, uint16_t out_port){
-    ofp_action_output act{htobe16_u(OFPAT_OUTPUT),htobe16_u(sizeof(ofp_action_output)),
-                          htobe16_u(out_port),htobe16_u(0)};
-    ofp_packet_out po{};
-    po.header.version=OFP_VERSION; po.header.type=OFPT_PACKET_OUT;
-    po.buffer_id=htobe32_u(buffer_id);
-    po.in_port = htobe16_u(in_port);
-    po.actions_len = htobe16_u(sizeof(act));
-    po.header.length = htobe16_u(sizeof(po)+sizeof(act));
-    po.header.xid = htobe32_u(xid++);
-    std::vector<uint8_t> buf(sizeof(po)+sizeof(act));
-    memcpy(buf.data(), &po, sizeof(po));
-    memcpy(buf.data()+sizeof(po), &act, sizeof(act));
-    send_all(fd, buf.data(), buf.size());
-  }
-
-  void send_port_stats_req(int fd, uint16_t port = 0xffff){
-    std::vector<uint8_t> buf(sizeof(ofp_stats_request)+sizeof(ofp_port_stats_request));
-    auto* req=(ofp_stats_request*)buf.data();
-    req->header.version=OFP_VERSION; req->header.type=OFPT_STATS_REQUEST;
-    req->type=htobe16_u(OFPST_PORT); req->flags=0; req->header.xid=htobe32_u(xid++);
-    req->header.length=htobe16_u(buf.size());
-    auto* pr=(ofp_port_stats_request*)req->body; pr->port_no=htobe16_u(port); memset(pr->pad,0,sizeof(pr->pad));
-    send_all(fd,buf.data(),buf.size());
+    auto frame = pool.acquire();
+    build_lldp_eth(*frame, dpid, out_port);
+    send_packet_out(fd, OFP_NO_BUFFER, OFPP_NONE, out_port, frame->data(), frame->size());
+  }
+
+  void send_packet_out(int fd, uint32_t buffer_id, uint32_t in_port, uint32_t out_port,
+                       const uint8_t* data = nullptr, size_t len = 0){
+    auto buf = pool.acquire();
+    encode_packet_out(*buf, version_of(fd), xid++, buffer_id, in_port, out_port, data, len);
+    send_all(fd, buf->data(), buf->size());
+  }
+
+  void send_port_stats_req(int fd){
+    auto buf = pool.acquire();
+    if(version_of(fd) == OFP13_VERSION){
+      auto req = Out<ofp13_multipart_request>::message<OFPT13_MULTIPART_REQUEST>(*buf, OFP13_VERSION);
+      req.set(&ofp13_multipart_request::type, OFPMP_PORT_STATS);
+      Out<ofp13_port_stats_request>::append(*buf).set(&ofp13_port_stats_request::port_no, OFPP13_ANY);
+      req.close(xid++);
+    } else {
+      auto req = Out<ofp_stats_request>::message<OFPT_STATS_REQUEST>(*buf, OFP_VERSION);
+      req.set(&ofp_stats_request::type, OFPST_PORT);
+      Out<ofp_port_stats_request>::append(*buf).set(&ofp_port_stats_request::port_no, OFPP_NONE);
+      req.close(xid++);
+    }
+    send_all(fd, buf->data(), buf->size());
+  }
+  void send_port_desc_req(int fd){
+    auto req = make<ofp13_multipart_request, OFPT13_MULTIPART_REQUEST>(OFP13_VERSION, xid++);
+    req.type = to_be(uint16_t(OFPMP_PORT_DESC));
+    send_all(fd,&req,sizeof(req));
   }
 
   // events
-  void on_features_reply(int fd, const ofp_switch_features* fr){
-    uint64_t dpid = ntohl(uint32_t(fr->datapath_id)) | (uint64_t(ntohl(uint32_t(fr->datapath_id>>32)))<<32);
-    std::lock_guard<std::mutex> lk(mtx);
+  static PortDesc decode_phy_port(View<ofp_phy_port> pp){
+    PortDesc d;
+    d.ver        = OFP_VERSION;
+    d.config     = pp.get(&ofp_phy_port::config);
+    d.state      = pp.get(&ofp_phy_port::state);
+    d.curr       = pp.get(&ofp_phy_port::curr);
+    d.advertised = pp.get(&ofp_phy_port::advertised);
+    memcpy(d.hw_addr.data(), pp.raw().hw_addr, 6);
+    return d;
+  }
+  static PortDesc decode_port13(View<ofp13_port> pp){
+    PortDesc d;
+    d.ver        = OFP13_VERSION;
+    d.config     = pp.get(&ofp13_port::config);
+    d.state      = pp.get(&ofp13_port::state);
+    d.curr       = pp.get(&ofp13_port::curr);
+    d.advertised = pp.get(&ofp13_port::advertised);
+    d.curr_speed_kbps = pp.get(&ofp13_port::curr_speed);
+    memcpy(d.hw_addr.data(), pp.raw().hw_addr, 6);
+    return d;
+  }
+
+  // ---- 以下 on_* 由 loop() 在持有 mtx 時呼叫 ----
+
+  // HELLO 協商：雙方都有 bitmap 取交集最高者，否則取 min(雙方版本) 且須在支援清單內
+  bool on_hello(int fd, Bytes msg){
+    const uint32_t ours = supported_versions.load();
+    const uint8_t peer = msg.u8(0);
+    uint32_t theirs = 0;
+    for(size_t off = sizeof(ofp_header); auto el = View<ofp_hello_elem_header>::at(msg, off); ){
+      const uint16_t et = el->get(&ofp_hello_elem_header::type), elen = el->get(&ofp_hello_elem_header::length);
+      if(elen < sizeof(ofp_hello_elem_header) || !msg.has(off, elen)) break;
+      if(et == OFPHET_VERSIONBITMAP && elen >= 8) theirs = msg.u32(off+4);  // 第一個 word 涵蓋版本 0..31
+      off += pad8(elen);
+    }
+    uint8_t v = 0;
+    if(theirs){
+      const uint32_t common = ours & theirs;
+      if(common) v = uint8_t(31 - __builtin_clz(common));
+    } else {
+      const uint8_t cand = std::min<uint8_t>(peer, uint8_t(31 - __builtin_clz(ours)));
+      if(cand < 32 && (ours & (1u << cand))) v = cand;
+    }
+    if(!v){
+      send_hello_failed(fd, std::min<uint8_t>(peer, uint8_t(31 - __builtin_clz(ours))));
+      std::cerr << "[of] HELLO from fd " << fd << ": no common version (peer 0x" << std::hex
+                << int(peer) << ", bitmap 0x" << theirs << ")" << std::dec << "\n";
+      return false;
+    }
+    sw[fd].version = v;
+    sw[fd].hs = Hs::Features;
+    send_features_req(fd);
+    return true;
+  }
+
+  void on_features_reply(int fd, Bytes msg){
+    // 1.0 / 1.3 的固定部分同為 32 bytes，dpid 與 n_tables 位置相同
+    const auto fr = View<ofp_switch_features>::at(msg);
+    if(!fr) return;
     auto& s = sw[fd];
-    s.dpid = dpid;
-    if(sw_index_to_fd.empty()) sw_index_to_fd[1]=fd;
-    else {
-      int maxIdx = sw_index_to_fd.rbegin()->first;
-      bool exists=false; for(auto& kv: sw_index_to_fd) if(kv.second==fd) exists=true;
-      if(!exists) sw_index_to_fd[maxIdx+1]=fd;
-    }
-    // 設定 miss_send_len，否則 PACKET_IN 不會帶 payload
+    s.dpid = fr->get(&ofp_switch_features::datapath_id);
+    s.n_tables = fr->get(&ofp_switch_features::n_tables);
+    // 分片模式：不屬於本 shard 的 switch 交給 owner（dispatch 回 false，關閉路徑轉交 fd）
+    if(s.dpid && hooks.owns && !hooks.owns(s.dpid)){ s.handed_off = true; return; }
+    if(s.version == OFP_VERSION){
+      // 1.0 回覆尾端帶 ofp_phy_port 陣列：記下每個實體埠的速率特徵
+      of::for_each<ofp_phy_port>(fr->tail(), [&](View<ofp_phy_port> pp){
+        const uint16_t port = pp.get(&ofp_phy_port::port_no);
+        if(port >= OFPP_MAX) return; // LOCAL 等保留埠
+        s.port_desc[port] = decode_phy_port(pp);
+      });
+    }
+    if(reg.swid_of(fd) == SwitchRegistry::kNone){
+      const int id = alloc_swid_locked(s.dpid);
+      if(!reg.bind(id, fd, s.dpid)){
+        // 共享目錄給的 id 在本地已屬於別的 dpid：改用本地可用的 id，絕不共用
+        std::cerr << "[of] swid " << id << " is bound to another datapath; dpid 0x" << std::hex << s.dpid
+                  << std::dec << " gets a local id\n";
+        reg.bind(reg.allocate(s.dpid), fd, s.dpid);
+      }
+    }
+    // 暖啟動：沿用記得的 MAC 表，免得重新泛洪學習
+    if(auto w = warm.find(s.dpid); w != warm.end()){
+      for(const auto& m : w->second.macs) s.mac2port[mac_to_key(m.first.data())] = m.second;
+      warm.erase(w);
+    }
+    // 設定 miss_send_len，否則 PACKET_IN 不會帶 payload；GET_CONFIG_REPLY 代表設定已生效
+    if(s.hs == Hs::Features) s.hs = Hs::Config;
     send_set_config(fd, /*flags*/0, /*miss*/0xffff);
     send_get_config_req(fd);
+    if(s.version == OFP13_VERSION){
+      install_pipeline(fd);
+      // 埠描述改由 multipart 取得；上線事件等 PORT_DESC 回覆後再發，訂閱者才看得到埠與速率
+      send_port_desc_req(fd);
+    }
+  }
+
+  void on_echo_reply(int fd, View<ofp_header> h){
+    auto now = std::chrono::steady_clock::now();
+    auto& s = sw[fd];
+    if(const auto st = View<ofp_echo_stamp>::at(h.bytes())){
+      const int64_t sent_ns = int64_t(st->get(&ofp_echo_stamp::ts_ns));
+      const int64_t now_ns  = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+      if(now_ns >= sent_ns) s.rtt_us.record(uint64_t(now_ns - sent_ns) / 1000);
+    }
+    ++s.echo_replies;
+    s.echo_consec_missed = 0;
+    if(h.get(&ofp_header::xid) == s.echo_xid) s.echo_xid = 0;
   }
 
-  void on_stats_reply(int fd, const ofp_stats_reply* r){
-    if(ntohs(r->type)!=OFPST_PORT) return;
-    size_t body_len = ntohs(r->header.length) - sizeof(ofp_stats_reply);
-    const uint8_t* p = r->body; size_t off=0;
+  // 每個已握手 switch 依 echo_interval 發探測；連續 miss 達門檻 → 判定死亡
+  void probe_echo(std::vector<int>& dead){
+    const int64_t ivl = echo_interval_ms.load();
+    if(ivl <= 0) return;
+    const auto now = std::chrono::steady_clock::now();
+    const int max_missed = std::max(1, echo_max_missed.load());
     std::lock_guard<std::mutex> lk(mtx);
-    while(off + sizeof(ofp_port_stats) <= body_len){
-      auto* ps = (const ofp_port_stats*)(p+off);
-      uint16_t port = ntohs(ps->port_no);
-      sw[fd].last_ps[port] = *ps;
-      off += sizeof(ofp_port_stats);
+    for(auto& kv : sw){
+      auto& s = kv.second;
+      if(!s.connected) continue;
+      if(now - s.echo_last_sent < std::chrono::milliseconds(ivl)) continue;
+      if(s.echo_xid != 0){
+        ++s.echo_missed;
+        if(++s.echo_consec_missed >= uint32_t(max_missed)){ dead.push_back(kv.first); continue; }
+      }
+      try { s.echo_xid = send_echo_request(kv.first, now); }
+      catch(const std::exception&){ dead.push_back(kv.first); continue; }
+      s.echo_last_sent = now;
+      ++s.echo_sent;
+    }
+  }
+
+  void on_port_status(int fd, Bytes msg){
+    auto& s = sw[fd];
+    uint8_t reason; int port; PortDesc d;
+    if(s.version == OFP13_VERSION){
+      const auto ps = View<ofp13_port_status>::at(msg);
+      if(!ps) return;
+      const auto desc = ps->sub(&ofp13_port_status::desc);
+      const uint32_t p = desc.get(&ofp13_port::port_no);
+      if(p >= OFPP13_MAX) return;
+      reason = ps->get(&ofp13_port_status::reason); port = int(p); d = decode_port13(desc);
+    } else {
+      const auto ps = View<ofp_port_status>::at(msg);
+      if(!ps) return;
+      const auto desc = ps->sub(&ofp_port_status::desc);
+      const uint16_t p = desc.get(&ofp_phy_port::port_no);
+      if(p >= OFPP_MAX) return;
+      reason = ps->get(&ofp_port_status::reason); port = p; d = decode_phy_port(desc);
     }
+    // 埠被刪除，或鏈路由 up 轉為 down（含第一次就報 down）：不等 LLDP 過期。
+    // 管理性 PORT_DOWN（例如 Actuator 的 β=0）只更新埠描述，不當成故障
+    const auto old = s.port_desc.find(port);
+    const bool was_up = old == s.port_desc.end() || old->second.link_up();
+    if(reason == OFPPR_DELETE || (was_up && !d.link_up())) publish_link_down(fd, port, LinkDownEvent::Cause::PortStatus);
+    if(reason == OFPPR_DELETE){ s.port_desc.erase(port); s.last_ps.erase(port); s.lldp.erase(port); }
+    else { s.port_desc[port] = d; lldp_hot(s.lldp[port]); }
   }
 
-  void on_packet_in(int fd, const ofp_packet_in* pi){
-    const uint8_t* frame = pi->data;
-    if(ntohs(pi->total_len) < 14) return;
-    const uint8_t* dst = frame+0;
-    const uint8_t* src = frame+6;
-    uint16_t eth_type = (frame[12]<<8) | frame[13];
-    uint16_t in_port = ntohs(pi->in_port);
+  // 取 port 的速率（Mbps）；呼叫端需持有 mtx
+  uint32_t port_speed_locked(int fd, int port) const {
+    auto sit = sw.find(fd);
+    if(sit == sw.end()) return 0;
+    auto pit = sit->second.port_desc.find(port);
+    return pit == sit->second.port_desc.end() ? 0 : pit->second.speed_mbps();
+  }
+
+  PortStats to_port_stats_locked(int fd, int port, const PortCounters& c) const {
+    PortStats st{};
+    st.rx_bytes    = c.rx_bytes;
+    st.tx_bytes    = c.tx_bytes;
+    st.duration_ns = c.duration_ns;
+    st.speedMbps   = port_speed_locked(fd, port);
+    return st;
+  }
+
+  std::optional<SwitchInfo> switch_info_locked(int swid, int fd) const {
+    auto sit = sw.find(fd);
+    if (sit == sw.end()) return std::nullopt;
+    SwitchInfo info;
+    info.swid = swid;
+    info.dpid = sit->second.dpid;
+    info.connected = sit->second.connected;
+    info.of_version = sit->second.version;
+    info.n_tables = sit->second.n_tables;
+    info.pipeline = sit->second.pipeline;
+    info.handshake_ms = sit->second.handshake_ms;
+    info.flow_mods_by_table = sit->second.flow_mods;
+    for (const auto& kv : sit->second.port_desc) {
+      PortInfo pi{};
+      pi.port_no = kv.first;
+      pi.up = kv.second.up();
+      pi.curr_features       = kv.second.curr;
+      pi.advertised_features = kv.second.advertised;
+      pi.curr_speedMbps = kv.second.speed_mbps();
+      pi.adv_speedMbps  = speed_mbps_from_features(kv.second.ver, kv.second.advertised);
+      info.ports[pi.port_no] = pi;
+    }
+    for (const auto& kv : sit->second.last_ps) {
+      PortInfo& pi = info.ports[kv.first];
+      pi.port_no = kv.first;
+      pi.last = to_port_stats_locked(fd, kv.first, kv.second);
+    }
+    return info;
+  }
+
+  // 已快取的埠計數 → {swid, port} 視圖；呼叫端需持有 mtx
+  std::map<LinkId,PortStats> port_stats_locked() const {
+    std::map<LinkId,PortStats> out;
+    reg.for_each([&](int swid, int fd){
+      auto it = sw.find(fd); if(it==sw.end()) return;
+      for(const auto& p : it->second.last_ps)
+        out[{swid, p.first}] = to_port_stats_locked(fd, p.first, p.second);
+    });
+    return out;
+  }
+
+  // 1.0 STATS_REPLY 與 1.3 MULTIPART_REPLY 共用：依 xid 累積 REPLY_MORE 分段後再解析
+  void on_stats_reply(int fd, Bytes msg){
+    auto& s = sw[fd];
+    const size_t hdr = (s.version == OFP13_VERSION) ? sizeof(ofp13_multipart_reply) : sizeof(ofp_stats_reply);
+    if(msg.size() < hdr) return;
+    // 1.0 stats_reply 與 1.3 multipart_reply 的 type / flags 位置相同
+    const auto h = *View<ofp_stats_reply>::at(msg);
+    const uint16_t type  = h.get(&ofp_stats_reply::type);
+    const uint16_t flags = h.get(&ofp_stats_reply::flags);
+    const uint32_t x     = h.raw().header.xid;   // 只當 key 用，不必轉序
+
+    auto lease = pool.acquire(); auto& body = *lease;
+    auto pit = s.mp_partial.find(x);
+    if(pit != s.mp_partial.end()){ body.swap(pit->second); s.mp_partial.erase(pit); }
+    const Bytes part = msg.sub(hdr);
+    body.insert(body.end(), part.begin(), part.end());
+    if(flags & OFPSF_REPLY_MORE){
+      if(body.size() <= (16u << 20)) s.mp_partial[x].swap(body);   // 防止異常 switch 無限累積
+      return;
+    }
+    const Bytes all(body.data(), body.size());
+
+    if(s.version == OFP13_VERSION){
+      if(type == OFPMP_PORT_DESC){
+        of::for_each<ofp13_port>(all, [&](View<ofp13_port> pp){
+          const uint32_t port = pp.get(&ofp13_port::port_no);
+          if(port < OFPP13_MAX) s.port_desc[int(port)] = decode_port13(pp);
+        });
+        s.ports_ok = true;
+        maybe_ready(fd);
+        return;
+      }
+      if(type != OFPMP_PORT_STATS) return;
+      using P = ofp13_port_stats;
+      of::for_each<P>(all, [&](View<P> ps){
+        const uint32_t port = ps.get(&P::port_no);
+        if(port >= OFPP13_MAX) return;
+        PortCounters c;
+        c.rx_packets = ps.get(&P::rx_packets); c.tx_packets = ps.get(&P::tx_packets);
+        c.rx_bytes   = ps.get(&P::rx_bytes);   c.tx_bytes   = ps.get(&P::tx_bytes);
+        c.rx_dropped = ps.get(&P::rx_dropped); c.tx_dropped = ps.get(&P::tx_dropped);
+        c.rx_errors  = ps.get(&P::rx_errors);  c.tx_errors  = ps.get(&P::tx_errors);
+        c.duration_ns = uint64_t(ps.get(&P::duration_sec)) * 1000000000ull + ps.get(&P::duration_nsec);
+        s.last_ps[int(port)] = c;
+      });
+    } else {
+      if(type != OFPST_PORT) return;
+      using P = ofp_port_stats;
+      of::for_each<P>(all, [&](View<P> ps){
+        PortCounters c;
+        c.rx_packets = ps.get(&P::rx_packets); c.tx_packets = ps.get(&P::tx_packets);
+        c.rx_bytes   = ps.get(&P::rx_bytes);   c.tx_bytes   = ps.get(&P::tx_bytes);
+        c.rx_dropped = ps.get(&P::rx_dropped); c.tx_dropped = ps.get(&P::tx_dropped);
+        c.rx_errors  = ps.get(&P::rx_errors);  c.tx_errors  = ps.get(&P::tx_errors);
+        s.last_ps[ps.get(&P::port_no)] = c;
+      });
+    }
+    OFEvent e; e.kind=OFEvent::Kind::StatsReply; e.swid=swid_of_fd_locked(fd);
+    bus.publish(std::move(e));
+  }
+
+  void on_error(int fd, Bytes msg){
+    if(!msg.has(0, sizeof(ofp_header)+4)) return;
+    OFEvent e; e.kind=OFEvent::Kind::Error; e.swid=swid_of_fd_locked(fd);
+    e.err_type = msg.u16(8);
+    e.err_code = msg.u16(10);
+    std::ostringstream os;
+    os << "OFPT_ERROR type=" << e.err_type << " code=" << e.err_code;
+    // data 欄位帶回觸發錯誤的請求（至少 64 bytes），附上其 header 方便追查
+    if(const auto req = View<ofp_header>::at(msg, sizeof(ofp_header)+4))
+      os << " req_type=" << int(req->get(&ofp_header::type)) << " req_xid=" << req->get(&ofp_header::xid);
+    e.msg = os.str();
+    bus.publish(std::move(e));
+  }
+
+  // LLDP（由 build_lldp_eth 產生）：chassis TLV = dpid，port TLV = 埠號
+  bool on_lldp_frame(int fd, uint16_t in_port, Bytes f){
+    uint64_t src_dpid=0; int src_port=-1; bool have_chassis=false;
+    size_t off = 14;
+    while(f.has(off, 2)){
+      const uint16_t tl = f.u16(off);
+      const int type = tl >> 9; const size_t vlen = tl & 0x1ff;
+      off += 2;
+      if(type == 0 || !f.has(off, vlen)) break;
+      const Bytes v = f.sub(off, vlen);
+      if(type == 1 && vlen == 9 && v.u8(0) == 7){
+        src_dpid = v.u64(1);
+        have_chassis = true;
+      } else if(type == 2 && vlen == 3){
+        src_port = v.u16(1);
+      }
+      off += vlen;
+    }
+    if(!have_chassis || src_port < 0) return false;
+    int src_sw = reg.swid_of_dpid(src_dpid);
+    if(src_sw < 0 && hooks.lookup) src_sw = hooks.lookup(src_dpid);   // 對端在其他 shard
+    const int dst_sw = swid_of_fd_locked(fd);
+    if(src_sw < 0 || dst_sw < 0) return true;   // 是 LLDP，但對端尚未完成握手
+    // 探測端在本 shard 才能結算它的排程；跨 shard 的鏈路以退避上限持續刷新
+    if(const int src_fd = reg.fd_of(src_sw); src_fd >= 0) lldp_heard_locked(src_fd, src_port, dst_sw, int(in_port));
+    OFEvent e; e.kind=OFEvent::Kind::LLDP;
+    e.lldp = LLDPEvent{src_sw, src_port, dst_sw, int(in_port)};
+    bus.publish(std::move(e));
+    return true;
+  }
+
+  // 1.3 packet-in 的 in_port 在 OXM match 內
+  static uint32_t oxm_in_port(Bytes p){
+    for(size_t off = 0; p.has(off, 4); ){
+      const uint16_t cls = p.u16(off); const uint8_t field = p.u8(off+2) >> 1; const uint8_t flen = p.u8(off+3);
+      if(!p.has(off + 4, flen)) break;
+      if(cls == OFPXMC_OPENFLOW_BASIC && field == OFPXMT_IN_PORT && flen == 4) return p.u32(off+4);
+      off += 4 + flen;
+    }
+    return 0;
+  }
+
+  void on_packet_in(int fd, Bytes msg){
+    const uint8_t ver = version_of(fd);
+    uint32_t buffer_id, in_port;
+    Bytes frame;
+    if(ver == OFP13_VERSION){
+      const auto pi = View<ofp13_packet_in>::at(msg);
+      if(!pi) return;
+      const Bytes m = pi->tail();
+      const uint16_t match_len = m.u16(2);
+      const size_t data_off = pad8(match_len) + 2;
+      if(match_len < sizeof(ofp13_match_header) || !m.has(0, data_off)) return;
+      buffer_id = pi->get(&ofp13_packet_in::buffer_id);
+      in_port   = oxm_in_port(m.sub(sizeof(ofp13_match_header), match_len - sizeof(ofp13_match_header)));
+      frame = m.sub(data_off);
+    } else {
+      const auto pi = View<ofp_packet_in>::at(msg);
+      if(!pi) return;
+      buffer_id = pi->get(&ofp_packet_in::buffer_id);
+      in_port   = pi->get(&ofp_packet_in::in_port);
+      frame = pi->tail();
+    }
+    if(frame.size() < 14) return;
+    const uint8_t* dst = frame.data()+0;
+    const uint8_t* src = frame.data()+6;
+    const uint16_t eth_type = frame.u16(12);
+
+    // LLDP 只做拓樸發現，不上 bus、不參與 L2 學習/泛洪
+    if(eth_type == 0x88cc && on_lldp_frame(fd, uint16_t(in_port), frame)) return;
 
-    // 學習來源 MAC -> in_port
     {
-      std::lock_guard<std::mutex> lk(mtx);
-      sw[fd].mac2port[mac_to_key(src)] = in_port;
+      OFEvent e; e.kind=OFEvent::Kind::PacketIn; e.swid=swid_of_fd_locked(fd); e.in_port=int(in_port);
+      e.data.assign(frame.begin(), frame.end());
+      bus.publish(std::move(e));
     }
 
+    // 學習來源 MAC -> in_port
+    sw[fd].mac2port[mac_to_key(src)] = int(in_port);
+
     // 查目的 MAC 是否已知
     int out_port = -1;
     {
-      std::lock_guard<std::mutex> lk(mtx);
       auto it = sw[fd].mac2port.find(mac_to_key(dst));
       if(it != sw[fd].mac2port.end()) out_port = it->second;
     }
 
     // 已知 → 安裝單向 flow 並轉送；未知 → FLOOD
-    if(out_port > 0 && out_port != in_port){
+    if(out_port > 0 && out_port != int(in_port)){
       // 安裝 flow: match in_port + dl_dst，動作 output:out_port
-      ofp_flow_mod fm{}; fm.header.version=OFP_VERSION; fm.header.type=OFPT_FLOW_MOD;
-      fm.cookie      = htobe64_u(0x1ULL);
-      fm.command     = htobe16_u(OFPFC_ADD);
-      fm.idle_timeout= htobe16_u(30);
-      fm.hard_timeout= htobe16_u(0);
-      fm.priority    = htobe16_u(100);
-      fm.buffer_id   = pi->buffer_id;                // 讓 switch 直接轉出這個封包
-      fm.out_port    = htobe16_u(0xffff);
-      fm.flags       = htobe16_u(0);
-
-      memset(&fm.match, 0, sizeof(fm.match));
-      fm.match.in_port = htobe16_u(in_port);
-      fm.match.dl_type = 0; // 只匹配 L2
-      memcpy(fm.match.dl_dst, dst, 6);
-      uint32_t wc = OFPFW_DL_VLAN | OFPFW_DL_SRC | OFPFW_DL_VLAN_PCP |
-                    OFPFW_DL_TYPE | OFPFW_NW_TOS | OFPFW_NW_PROTO |
-                    OFPFW_TP_SRC  | OFPFW_TP_DST; // 只指定 in_port + dl_dst
-      fm.match.wildcards = htonl(wc);
-
-      ofp_action_output act{htobe16_u(OFPAT_OUTPUT), htobe16_u(sizeof(ofp_action_output)),
-                            htobe16_u(uint16_t(out_port)), htobe16_u(0)};
-      const size_t len = sizeof(fm) + sizeof(act);
-      fm.header.length = htobe16_u(len);
-      fm.header.xid    = htobe32_u(xid++);
-      std::vector<uint8_t> buf(len);
-      memcpy(buf.data(), &fm, sizeof(fm));
-      memcpy(buf.data()+sizeof(fm), &act, sizeof(act));
-      send_all(fd, buf.data(), buf.size());
+      // pipeline 時放 L2 表且只比對 dl_dst：每個 MAC 一條，與 TE 規則數相加而非相乘
+      FlowSpec f;
+      if(sw[fd].pipeline) f.table_id = OFController::kTableL2;
+      else f.match.in_port = in_port;
+      f.match.dl_dst.emplace(); memcpy(f.match.dl_dst->data(), dst, 6);
+      f.cookie       = 0x1ULL;
+      f.idle_timeout = 30;
+      f.priority     = 100;
+      f.buffer_id    = buffer_id;                // 讓 switch 直接轉出這個封包
+      f.out_ports    = {uint32_t(out_port)};
+      send_flow(fd, f);
+      // 未緩衝（NO_BUFFER）時 flow 不會帶走這個封包，需自行送出
+      if(buffer_id == OFP_NO_BUFFER) send_packet_out(fd, buffer_id, in_port, uint32_t(out_port), frame.data(), frame.size());
     } else {
-      // 未知 → FLOOD（使用 buffer_id，避免攜帶 payload）
-      send_packet_out_with_buffer(fd, pi->buffer_id, in_port, OFPP_FLOOD);
+      // 未知 → FLOOD（有 buffer_id 時不攜帶 payload）
+      send_packet_out(fd, buffer_id, in_port, OFPP_FLOOD, frame.data(), frame.size());
+    }
+  }
+
+  static constexpr auto kPacketInWindow = std::chrono::seconds(1);
+  static void count_packet_in(ChanStats& c){
+    const auto now = std::chrono::steady_clock::now();
+    ++c.packet_ins;
+    const auto el = now - c.pin_window_start;
+    if(el >= kPacketInWindow){
+      if(c.pin_window_start.time_since_epoch().count())
+        c.pin_rate = double(c.pin_window) / std::chrono::duration<double>(el).count();
+      c.pin_window = 0;
+      c.pin_window_start = now;
+    }
+    ++c.pin_window;
+  }
+
+  // 一則完整訊息；回傳 false 表示要關閉連線
+  bool dispatch(int fd, SwCtx& s, Bytes msg){
+    const auto base = View<ofp_header>::at(msg);
+    if(!base) return false;
+    const uint8_t version = base->get(&ofp_header::version), type = base->get(&ofp_header::type);
+    // 協商後版本必須一致（HELLO 例外）
+    if(s.version && version != s.version && type != OFPT_HELLO) return false;
+    if(!s.version){
+      // 協商前只處理 HELLO / ERROR，其餘忽略
+      if(type == OFPT_HELLO) return on_hello(fd, msg);
+      if(type == OFPT_ERROR) on_error(fd, msg);
+      return true;
+    }
+    const uint8_t stats_reply = (s.version == OFP13_VERSION) ? uint8_t(OFPT13_MULTIPART_REPLY) : uint8_t(OFPT_STATS_REPLY);
+    switch(type){
+      case OFPT_HELLO: break;
+      case OFPT_ERROR:
+        on_error(fd, msg);
+        break;
+      case OFPT_ECHO_REQUEST:
+        send_echo_reply(fd, *base);
+        break;
+      case OFPT_ECHO_REPLY:
+        on_echo_reply(fd, *base);
+        break;
+      case OFPT_FEATURES_REPLY:
+        on_features_reply(fd, msg);
+        if(s.handed_off) return false;
+        break;
+      case OFPT_GET_CONFIG_REPLY:
+        s.cfg_ok = true;
+        maybe_ready(fd);
+        break;
+      case OFPT_PACKET_IN:
+        count_packet_in(s.chan);
+        on_packet_in(fd, msg);
+        break;
+      case OFPT_PORT_STATUS:
+        on_port_status(fd, msg);
+        break;
+      default:
+        if(type == stats_reply) on_stats_reply(fd, msg);
+        break;
+    }
+    return true;
+  }
+
+  // 非阻塞讀：每輪每條連線最多 kReadBudget bytes，避免單一 switch 霸佔迴圈
+  static constexpr size_t kReadBudget = 64 * 1024;
+  // 直接 recv 進連線的 rx buffer（來自 pool），訊息就地解析，不另外複製
+  static constexpr size_t kReadChunk = 16 * 1024;
+  // ready_at：poll 回報可讀的時間，用來量訊息在 reactor 裡等了多久
+  bool read_and_dispatch(int fd, SwCtx& s, std::chrono::steady_clock::time_point ready_at){
+    if(!s.rx->capacity()) s.rx = pool.acquire();
+    auto& rx = *s.rx;
+    size_t got = 0;
+    while(got < kReadBudget){
+      const size_t old = rx.size();
+      rx.resize(old + kReadChunk);
+      const ssize_t n = recv(fd, rx.data() + old, kReadChunk, 0);
+      rx.resize(old + size_t(std::max<ssize_t>(n, 0)));
+      if(n == 0) return false;
+      if(n < 0){
+        if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+        if(errno == EINTR) continue;
+        return false;
+      }
+      got += size_t(n);
+      if(size_t(n) < kReadChunk) break;
+    }
+    ChanStats& cs = s.chan;
+    cs.bytes_in += got;
+    size_t off = 0;
+    uint32_t depth = 0;
+    bool ok = true;
+    auto t = std::chrono::steady_clock::now();
+    while(ok && rx.size() - off >= sizeof(ofp_header)){
+      const uint16_t mlen = rd16(rx.data() + off + 2);   // ofp_header.length
+      if(mlen < sizeof(ofp_header)){ ok = false; break; }
+      if(rx.size() - off < mlen) break;
+      ++depth;
+      ++cs.in[type_slot(rx[off + 1])];
+      cs.wait_us.record(uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(t - ready_at).count()));
+      try { ok = dispatch(fd, s, Bytes(rx.data() + off, mlen)); }
+      catch(const std::exception&){ ok = false; }   // 回覆途中送出失敗 → 連線已斷
+      const auto done = std::chrono::steady_clock::now();
+      cs.handle_us.record(uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(done - t).count()));
+      t = done;
+      off += mlen;
+    }
+    cs.queue_depth = depth;
+    cs.queue_depth_max = std::max(cs.queue_depth_max, depth);
+    rx.erase(rx.begin(), rx.begin() + std::ptrdiff_t(std::min(off, rx.size())));
+    return ok;
+  }
+
+  // listen socket 可讀時一次取完（每輪上限 kAcceptBatch），新連線先排隊
+  static constexpr int kAcceptBatch = 1024;
+  void accept_batch(){
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(mtx);
+    for(int i = 0; i < kAcceptBatch; ++i){
+      const int cfd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if(cfd < 0){
+        if(errno == EINTR) continue;
+        if(errno != EAGAIN && errno != EWOULDBLOCK) perror("accept4");
+        break;
+      }
+      int one = 1; setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      SwCtx& s = sw[cfd];
+      s = SwCtx{};
+      s.fd = cfd;
+      s.accepted_at = now;
+      hs_queue.push_back(cfd);
     }
   }
 
-  void loop(uint16_t port){
-    listen_fd = listen_on(port);
-    if(listen_fd<0) return;
-    running = true;
+  // 握手逾時 → 關閉並釋放名額
+  void expire_handshakes(std::vector<int>& dead){
+    const auto limit = std::chrono::milliseconds(hs_timeout_ms.load());
+    if(limit.count() <= 0) return;
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(mtx);
+    for(auto& kv : sw){
+      const auto& s = kv.second;
+      if(s.hs == Hs::Queued || s.hs == Hs::Ready) continue;
+      if(now - s.admitted_at > limit){ ++hs_timed_out; dead.push_back(kv.first); }
+    }
+  }
 
+  void loop(){
     auto last_lldp  = std::chrono::steady_clock::now();
     auto last_stats = std::chrono::steady_clock::now();
+    std::vector<pollfd> pfds;
 
     while(running){
-      fd_set rfds; FD_ZERO(&rfds); int maxfd=listen_fd; FD_SET(listen_fd,&rfds);
+      // 排隊中的連線不輪詢：讓它們的資料留在 kernel，等放行再讀
+      pfds.clear();
+      pfds.push_back(pollfd{listen_fd, POLLIN, 0});
       {
         std::lock_guard<std::mutex> lk(mtx);
-        for(auto& kv: sw){ FD_SET(kv.first,&rfds); maxfd=max(maxfd, kv.first); }
-      }
-      timeval tv{1,0};
-      int rv = select(maxfd+1, &rfds, nullptr, nullptr, &tv);
-      if(rv<0){ if(errno==EINTR) continue; perror("select"); break; }
-
-      if(FD_ISSET(listen_fd,&rfds)){
-        int cfd = accept(listen_fd,nullptr,nullptr);
-        if(cfd>=0){
-          std::lock_guard<std::mutex> lk(mtx);
-          sw[cfd] = SwCtx{cfd,0,{}};
-          send_hello(cfd);
-          send_features_req(cfd);
-          // 提前設 config，某些 switch 會在 features 之前也允許
-          send_set_config(cfd, 0, 0xffff);
+        for(auto& kv: sw){
+          if(kv.second.hs == Hs::Queued) continue;
+          pfds.push_back(pollfd{kv.first, short(POLLIN | (kv.second.tx.empty() ? 0 : POLLOUT)), 0});
         }
       }
-
+      // echo 探測需要次秒級的醒來週期
+      const int64_t ivl = echo_interval_ms.load();
+      int wait_ms = int((ivl > 0) ? std::clamp<int64_t>(ivl / 4, 10, 1000) : 1000);
+      wait_ms = std::min<int>(wait_ms, int(std::clamp<int64_t>(lldp_tick_ms(), 10, 1000)));
+      int rv = poll(pfds.data(), nfds_t(pfds.size()), wait_ms);
+      if(rv<0){ if(errno==EINTR) continue; perror("poll"); break; }
+
+      const auto ready_at = std::chrono::steady_clock::now();
       std::vector<int> closed;
+      if(pfds[0].revents & POLLIN) accept_batch();
 
-      // ---- 收包（修正：把 header+body 併成一塊解析）----
+      // ---- 收包：累積到 rx，切出完整訊息再分派 ----
       {
         std::lock_guard<std::mutex> lk(mtx);
-        for(auto& kv: sw){
-          int fd=kv.first;
-          if(!FD_ISSET(fd,&rfds)) continue;
-
-          ofp_header h{};
-          ssize_t n=recv(fd,&h,sizeof(h),MSG_WAITALL);
-          if(n<=0){ closed.push_back(fd); continue; }
-          if(n != (ssize_t)sizeof(h) || h.version!=OFP_VERSION){ closed.push_back(fd); continue; }
-
-          uint16_t mlen = ntohs(h.length);
-          if(mlen < sizeof(ofp_header)){ closed.push_back(fd); continue; }
-          std::vector<uint8_t> full(mlen);
-          memcpy(full.data(), &h, sizeof(h));
-          if(mlen > sizeof(h)){
-            ssize_t m=recv(fd, full.data()+sizeof(h), mlen - sizeof(h), MSG_WAITALL);
-            if(m<=0){ closed.push_back(fd); continue; }
-          }
-
-          auto* base = (const ofp_header*)full.data();
-          switch(base->type){
-            case OFPT_HELLO: break;
-            case OFPT_ECHO_REQUEST: {
-              const uint8_t* payload = full.data()+sizeof(ofp_header);
-              size_t plen = mlen - sizeof(ofp_header);
-              send_echo_reply(fd, base, payload, plen);
-              break;
-            }
-            case OFPT_FEATURES_REPLY:
-              on_features_reply(fd, (const ofp_switch_features*)base);
-              break;
-            case OFPT_PACKET_IN:
-              on_packet_in(fd, (const ofp_packet_in*)base);
-              break;
-            case OFPT_STATS_REPLY:
-              on_stats_reply(fd,(const ofp_stats_reply*)base);
-              break;
-            default: break;
-          }
+        for(size_t i = 1; i < pfds.size(); ++i){
+          if(!pfds[i].revents) continue;
+          const int fd = pfds[i].fd;
+          auto it = sw.find(fd);
+          if(it == sw.end()) continue;
+          if((pfds[i].revents & POLLOUT) && !flush_locked(fd, it->second)){ closed.push_back(fd); continue; }
+          if((pfds[i].revents & ~POLLOUT) && !read_and_dispatch(fd, it->second, ready_at)) closed.push_back(fd);
         }
       }
 
-      if(!closed.empty()){
+      probe_echo(closed);
+      expire_handshakes(closed);
+
+      {
         std::lock_guard<std::mutex> lk(mtx);
-        for(int fd: closed){ close(fd); sw.erase(fd);
-          for(auto it=sw_index_to_fd.begin(); it!=sw_index_to_fd.end();){
-            if(it->second==fd) it=sw_index_to_fd.erase(it); else ++it;
+        for(int fd: closed){
+          auto sit = sw.find(fd);
+          if(sit == sw.end()) continue;   // 同一 fd 可能被收包與 echo 都判定關閉
+          const int swid = swid_of_fd_locked(fd);
+          const Hs hs = sit->second.hs;
+          if(hs != Hs::Queued && hs != Hs::Ready && hs_active) --hs_active;
+          if(sit->second.connected && swid > 0){
+            publish_switch_state(swid, false);
+            if(hooks.on_state) hooks.on_state(swid, sit->second.dpid, sit->second.version, false);
           }
+          // 記住 dpid → swid 與 MAC 表，重連時沿用
+          if(sit->second.dpid && swid > 0){
+            warm[sit->second.dpid] = warm_of_locked(fd, swid);
+            reg.remember(sit->second.dpid, swid);
+          }
+          if(sit->second.handed_off && hooks.hand_off) hooks.hand_off(fd, sit->second.version, sit->second.dpid);
+          else close(fd);
+          sw.erase(sit);
+          reg.unbind_fd(fd);
+        }
+        // 空出的名額給排隊中的連線；HELLO 送不出去的直接關閉
+        std::vector<int> dead;
+        admit_locked(dead);
+        for(int fd : dead){
+          auto sit = sw.find(fd);
+          if(sit == sw.end()) continue;
+          if(hs_active) --hs_active;
+          close(fd); sw.erase(sit);
         }
       }
 
       auto now = std::chrono::steady_clock::now();
-      if(now - last_lldp > std::chrono::seconds(2)){
+      if(now - last_lldp > std::chrono::milliseconds(lldp_tick_ms())){
         std::lock_guard<std::mutex> lk(mtx);
-        for(auto& kv: sw){
-          int fd=kv.first; uint64_t dpid=kv.second.dpid?kv.second.dpid:0xdeadbeef;
-          for(int p=1;p<=4;++p) packet_out_lldp(fd, uint16_t(p), dpid);
-        }
+        lldp_round_locked();
         last_lldp = now;
       }
-      if(now - last_stats > std::chrono::seconds(3)){
+      if(now - last_stats > std::chrono::milliseconds(stats_period_ms.load())){
         std::lock_guard<std::mutex> lk(mtx);
-        for(auto& kv: sw) send_port_stats_req(kv.first, 0xffff);
+        for(auto& kv: sw){
+          if(!kv.second.connected) continue;
+          try { send_port_stats_req(kv.first); } catch(const std::exception&){}
+        }
         last_stats = now;
       }
     }
   }
 };
 
-// 唯一實例
-namespace { OFControllerImpl g_impl; }
-
 // =============================
 // OFController public methods
 // =============================
+OFController::OFController() : impl_(std::make_unique<Impl>()) {}
+OFController::~OFController() { stop(); }
+
 bool OFController::start(uint16_t port){
-  if(g_impl.running) return true;
-  g_impl.loop_thread = std::thread([port]{ g_impl.loop(port); });
-  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  if(impl_->running) return true;
+  // 同步 bind/listen：埠被占用時直接回報失敗
+  impl_->listen_fd = Impl::listen_on(port, impl_->hooks.reuse_port);
+  if(impl_->listen_fd<0) return false;
+  impl_->running = true;
+  impl_->bus.start();
+  impl_->loop_thread = std::thread([this]{ impl_->loop(); });
   return true;
 }
 
 void OFController::send_lldp(int swid, int out_port){
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if(it==g_impl.sw_index_to_fd.end()) return;
-  int fd = it->second;
-  uint64_t dpid = g_impl.sw[fd].dpid? g_impl.sw[fd].dpid : 0xdeadbeef;
-  g_impl.packet_out_lldp(fd, uint16_t(out_port), dpid);
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return;
+  uint64_t dpid = impl_->sw[fd].dpid? impl_->sw[fd].dpid : 0xdeadbeef;
+  impl_->packet_out_lldp(fd, uint16_t(out_port), dpid);
+}
+
+size_t OFController::send_lldp_round(int swid){
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  if (swid <= 0) return impl_->lldp_round_locked(-1, true);
+  const int fd = impl_->reg.fd_of(swid);
+  return fd < 0 ? 0 : impl_->lldp_round_locked(fd, true);
 }
 
 std::map<LinkId,PortStats> OFController::poll_port_stats(){
-  std::map<LinkId,PortStats> out;
   {
-    std::lock_guard<std::mutex> lk(g_impl.mtx);
-    for(auto& kv: g_impl.sw) g_impl.send_port_stats_req(kv.first, 0xffff);
+    std::lock_guard<std::mutex> lk(impl_->mtx);
+    for(auto& kv: impl_->sw) if(kv.second.connected) impl_->send_port_stats_req(kv.first);
   }
   std::this_thread::sleep_for(std::chrono::milliseconds(150));
 
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  for(auto& idx : g_impl.sw_index_to_fd){
-    int swid = idx.first; int fd = idx.second;
-    auto it = g_impl.sw.find(fd); if(it==g_impl.sw.end()) continue;
-    for(const auto& p : it->second.last_ps){
-      int port = p.first;
-      const auto& ps = p.second;
-      PortStats s{};
-      s.rx_bytes = be64toh(*(const uint64_t*)&ps.rx_bytes);
-      s.tx_bytes = be64toh(*(const uint64_t*)&ps.tx_bytes);
-      s.speedMbps = 0;
-      out[{swid, port}] = s;
-    }
-  }
-  return out;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  return impl_->port_stats_locked();
 }
 
-void OFController::flow_mod(int swid,
+std::map<LinkId,PortStats> OFController::port_stats_snapshot() const {
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  return impl_->port_stats_locked();
+}
+
+bool OFController::flow_mod(int swid,
                             const std::string& match,
                             const std::string& actions,
                             int priority,
                             bool add,
                             std::optional<uint16_t> idle_timeout,
                             std::optional<uint16_t> hard_timeout,
-                            std::optional<uint64_t> cookie)
+                            std::optional<uint64_t> cookie,
+                            uint8_t table_id)
 {
-  auto parse_ip = [](const std::string& s)->uint32_t {
-    in_addr a{}; if(inet_aton(s.c_str(), &a)==0) return 0; return a.s_addr;
+  // "a.b.c.d" 或 "a.b.c.d/len"；回傳 network order 位址與前綴長度
+  auto parse_ip = [](const std::string& s, uint8_t* plen)->uint32_t {
+    const auto slash = s.find('/');
+    *plen = (slash == std::string::npos) ? 32 : uint8_t(std::clamp(std::stoi(s.substr(slash+1)), 0, 32));
+    in_addr a{}; if(inet_aton(s.substr(0, slash).c_str(), &a)==0) return 0; return a.s_addr;
   };
 
-  uint16_t in_port=0, out_port=0;
-  uint8_t  proto=0;
-  uint32_t src=0, dst=0;
-  std::optional<uint16_t> sport, dport;
+  FlowSpec f;
+  FlowMatch& m = f.match;
+  m.ipv4 = true;
 
   auto eat = [&](const std::string& k, std::string* v)->bool{
     auto pos = match.find(k);
@@ -588,114 +1501,208 @@ void OFController::flow_mod(int swid,
   };
 
   std::string v;
-  if (eat("in=",   &v) || eat("in_port=", &v)) in_port = uint16_t(std::stoi(v));
-  if (eat("src=",  &v) || eat("nw_src=",  &v)) src = parse_ip(v);
-  if (eat("dst=",  &v) || eat("nw_dst=",  &v)) dst = parse_ip(v);
-  if (eat("proto=",&v) || eat("nw_proto=",&v)) proto = uint8_t(std::stoi(v));
-  if (eat("sport=",&v) || eat("tp_src=",  &v)) if(v!="-") sport = uint16_t(std::stoi(v));
-  if (eat("dport=",&v) || eat("tp_dst=",  &v)) if(v!="-") dport = uint16_t(std::stoi(v));
-  if (actions.rfind("output:",0) == 0)       out_port = uint16_t(std::stoi(actions.substr(7)));
-  else if (actions.rfind("output=",0) == 0)  out_port = uint16_t(std::stoi(actions.substr(7)));
-
-  auto send_flow = [&](int fd){
-    ofp_flow_mod fm{}; fm.header.version=OFP_VERSION; fm.header.type=OFPT_FLOW_MOD;
-    fm.cookie      = htobe64_u(cookie.value_or(0x1234ULL));
-    fm.command     = htobe16_u(add ? OFPFC_ADD : OFPFC_DELETE_STRICT);
-    fm.idle_timeout= htobe16_u(idle_timeout.value_or(0));
-    fm.hard_timeout= htobe16_u(hard_timeout.value_or(0));
-    fm.priority    = htobe16_u(uint16_t(priority));
-    fm.buffer_id   = htobe32_u(0xffffffff);
-    fm.out_port    = htobe16_u(0xffff);
-    fm.flags       = htobe16_u(0);
-
-    memset(&fm.match, 0, sizeof(fm.match));
-    fm.match.in_port = htobe16_u(in_port);
-    fm.match.dl_type = htobe16_u(0x0800);
-    fm.match.nw_proto= proto;
-    memcpy(fm.match.nw_src, &src, 4);
-    memcpy(fm.match.nw_dst, &dst, 4);
-    fm.match.tp_src = htobe16_u(sport.value_or(0));
-    fm.match.tp_dst = htobe16_u(dport.value_or(0));
-
-    uint32_t wc = OFPFW_DL_VLAN | OFPFW_DL_SRC | OFPFW_DL_DST | OFPFW_DL_VLAN_PCP;
-    if (in_port==0) wc |= OFPFW_IN_PORT;
-    if (proto==0)   wc |= OFPFW_NW_PROTO;
-    if (!sport)     wc |= OFPFW_TP_SRC;
-    if (!dport)     wc |= OFPFW_TP_DST;
-    fm.match.wildcards = htonl(wc);
-
-    ofp_action_output act{htobe16_u(OFPAT_OUTPUT), htobe16_u(sizeof(ofp_action_output)),
-                          htobe16_u(out_port), htobe16_u(0)};
-    const size_t len = sizeof(fm) + (add ? sizeof(act) : 0);
-    fm.header.length = htobe16_u(len);
-    fm.header.xid    = htobe32_u(g_impl.xid++);
-
-    std::vector<uint8_t> buf(len);
-    memcpy(buf.data(), &fm, sizeof(fm));
-    if (add) memcpy(buf.data()+sizeof(fm), &act, sizeof(act));
-    OFControllerImpl::send_all(fd, buf.data(), buf.size());
-    g_impl.send_barrier(fd);
-  };
+  if (eat("in=",   &v) || eat("in_port=", &v)) m.in_port = uint32_t(std::stoul(v));
+  if (eat("src=",  &v) || eat("nw_src=",  &v)) m.nw_src = parse_ip(v, &m.src_plen);
+  if (eat("dst=",  &v) || eat("nw_dst=",  &v)) m.nw_dst = parse_ip(v, &m.dst_plen);
+  if (eat("proto=",&v) || eat("nw_proto=",&v)) m.nw_proto = uint8_t(std::stoi(v));
+  if (eat("sport=",&v) || eat("tp_src=",  &v)) if(v!="-") m.tp_src = uint16_t(std::stoi(v));
+  if (eat("dport=",&v) || eat("tp_dst=",  &v)) if(v!="-") m.tp_dst = uint16_t(std::stoi(v));
+
+  // 動作：以逗號分隔；output:N / output:in_port / group:G / goto:T / meter:M（group、goto、meter 只有 1.3）
+  {
+    std::istringstream as(actions);
+    std::string tok;
+    while (std::getline(as, tok, ',')) {
+      tok.erase(0, tok.find_first_not_of(' '));
+      if (tok == "output:in_port")
+        f.out_ports.push_back(kInPort);
+      else if (tok.rfind("output:",0) == 0 || tok.rfind("output=",0) == 0)
+        f.out_ports.push_back(uint32_t(std::stoul(tok.substr(7))));
+      else if (tok.rfind("group:",0) == 0)
+        f.group = uint32_t(std::stoul(tok.substr(6)));
+      else if (tok.rfind("goto:",0) == 0)
+        f.goto_table = uint8_t(std::stoi(tok.substr(5)));
+      else if (tok.rfind("goto_table:",0) == 0)
+        f.goto_table = uint8_t(std::stoi(tok.substr(11)));
+      else if (tok.rfind("meter:",0) == 0)
+        f.meter = uint32_t(std::stoul(tok.substr(6)));
+    }
+  }
 
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if (it == g_impl.sw_index_to_fd.end()) return;
-  send_flow(it->second);
+  f.cookie       = cookie.value_or(0x1234ULL);
+  f.command      = add ? OFPFC_ADD : OFPFC_DELETE_STRICT;
+  f.idle_timeout = idle_timeout.value_or(0);
+  f.hard_timeout = hard_timeout.value_or(0);
+  f.priority     = uint16_t(priority);
+  f.table_id     = table_id;
+  if (!add) { f.out_ports.clear(); f.group.reset(); f.goto_table.reset(); f.meter.reset(); }
+
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->target_locked(swid);
+  if (fd == Impl::kNoTarget) return false;
+  if (impl_->version_of(fd) != OFP13_VERSION && (table_id != 0 || f.goto_table || f.group || f.meter)) {
+    std::cerr << "[of] flow_mod: tables/groups/meters need OpenFlow 1.3 (swid=" << swid << ")\n";
+    return false;
+  }
+  impl_->send_flow(fd, f);
+  impl_->send_barrier(fd);
+  return true;
+}
+
+bool OFController::group_mod(int swid, GroupCommand cmd, uint32_t group_id, GroupType type,
+                             const std::vector<GroupBucket>& buckets)
+{
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->target_locked(swid);
+  if (fd == Impl::kNoTarget) return false;
+  if (impl_->version_of(fd) != OFP13_VERSION) return false;   // 1.0 沒有 group table
+  auto buf = impl_->pool.acquire();
+  encode_group_mod13(*buf, impl_->xid++, uint16_t(cmd), uint8_t(type), group_id,
+                     cmd == GroupCommand::Delete ? std::vector<GroupBucket>{} : buckets);
+  impl_->send_all(fd, buf->data(), buf->size());
+  impl_->send_barrier(fd);
+  return true;
+}
+
+bool OFController::meter_mod(int swid, MeterCommand cmd, uint32_t meter_id,
+                             const std::vector<MeterBand>& bands)
+{
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->target_locked(swid);
+  if (fd == Impl::kNoTarget) return false;
+  if (impl_->version_of(fd) != OFP13_VERSION) return false;   // 1.0 沒有 meter table
+  auto buf = impl_->pool.acquire();
+  encode_meter_mod13(*buf, impl_->xid++, uint16_t(cmd), meter_id,
+                     cmd == MeterCommand::Delete ? std::vector<MeterBand>{} : bands);
+  impl_->send_all(fd, buf->data(), buf->size());
+  impl_->send_barrier(fd);
+  return true;
 }
 
 void OFController::packet_out(int swid, int out_port, const uint8_t* eth, size_t len)
 {
   if (!eth || len < 14) return; // 需為完整 L2 幀
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if (it == g_impl.sw_index_to_fd.end()) return;
-  int fd = it->second;
-
-  ofp_action_output act{htobe16_u(OFPAT_OUTPUT), htobe16_u(sizeof(ofp_action_output)),
-                        htobe16_u(uint16_t(out_port)), htobe16_u(0)};
-  ofp_packet_out po{};
-  po.header.version=OFP_VERSION; po.header.type=OFPT_PACKET_OUT;
-  po.buffer_id=htobe32_u(0xffffffff);
-  po.in_port = htobe16_u(0xffff);
-  po.actions_len = htobe16_u(sizeof(act));
-  po.header.length = htobe16_u(sizeof(po)+sizeof(act)+len);
-  po.header.xid = htobe32_u(g_impl.xid++);
-
-  std::vector<uint8_t> buf(sizeof(po)+sizeof(act)+len);
-  memcpy(buf.data(), &po, sizeof(po));
-  memcpy(buf.data()+sizeof(po), &act, sizeof(act));
-  memcpy(buf.data()+sizeof(po)+sizeof(act), eth, len);
-  OFControllerImpl::send_all(fd, buf.data(), buf.size());
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->target_locked(swid);
+  if (fd == Impl::kNoTarget) return;
+  impl_->send_packet_out(fd, OFP_NO_BUFFER, OFPP_NONE, uint32_t(out_port), eth, len);
+}
+
+bool OFController::clear_table(int swid, uint8_t table_id){
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return false;
+  auto& s = impl_->sw[fd];
+  if(s.version != OFP13_VERSION) return false;   // 1.0 無法指定 table 刪除
+  FlowSpec del; del.command = OFPFC_DELETE; del.table_id = table_id;   // 空 match = 整張表
+  impl_->send_flow(fd, del);
+  if(table_id == kTableL2 || !s.pipeline) s.mac2port.clear();
+  if(table_id == kTableTE || (s.pipeline && table_id == kTableL2)) impl_->install_table_miss(fd, table_id);
+  impl_->send_barrier(fd);
+  return true;
+}
+
+std::vector<WarmSwitchState> OFController::export_warm_state() const {
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  std::map<uint64_t, WarmSwitchState> out = impl_->warm;
+  impl_->reg.for_each([&](int swid, int fd){
+    auto sit = impl_->sw.find(fd);
+    if(sit == impl_->sw.end() || !sit->second.dpid) return;
+    out[sit->second.dpid] = impl_->warm_of_locked(fd, swid);
+  });
+  std::vector<WarmSwitchState> v;
+  for(auto& kv : out) v.push_back(std::move(kv.second));
+  return v;
+}
+
+void OFController::set_switch_ids(const std::map<uint64_t, int>& dpid_to_swid){
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  for(const auto& kv : dpid_to_swid) impl_->reg.pin(kv.first, kv.second);
+}
+
+void OFController::import_warm_state(const std::vector<WarmSwitchState>& st){
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  for(const auto& w : st){
+    if(!w.dpid) continue;
+    impl_->warm[w.dpid] = w;
+    impl_->reg.remember(w.dpid, w.swid);
+  }
+}
+
+void OFController::set_shard_hooks(ShardHooks h){
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  impl_->hooks = std::move(h);
+}
+
+bool OFController::adopt_connection(int fd, uint8_t version){
+  if(!impl_->running || fd < 0 || (version != OFP_VERSION && version != OFP13_VERSION)) return false;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  if(impl_->sw.count(fd)) return false;
+  // 已在原 shard 通過握手名額與 HELLO：直接從 FEATURES 重來
+  auto& s = impl_->sw[fd];
+  s = Impl::SwCtx{};
+  s.fd = fd;
+  s.accepted_at = s.admitted_at = std::chrono::steady_clock::now();
+  s.version = version;
+  s.hs = Impl::Hs::Features;
+  ++impl_->hs_active;
+  try { impl_->send_features_req(fd); }
+  catch(const std::exception&){ impl_->sw.erase(fd); --impl_->hs_active; return false; }
+  return true;
+}
+
+bool OFController::send_raw(int swid, const uint8_t* msg, size_t len){
+  const auto h = View<ofp_header>::at(Bytes{msg, len});
+  if(!h || h->get(&ofp_header::length) != len) return false;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return false;
+  auto& s = impl_->sw[fd];
+  if(h->get(&ofp_header::version) != s.version) return false;
+  auto buf = impl_->pool.acquire();
+  buf->assign(msg, msg + len);
+  // 轉送端不知道 hw_addr：PORT_MOD 帶全 0 時以本地埠描述補上
+  auto fill_hw = [&](auto* pm, uint32_t port_no){
+    static const uint8_t zero[6] = {};
+    auto pit = s.port_desc.find(int(port_no));
+    if(pit != s.port_desc.end() && !memcmp(pm->hw_addr, zero, 6)) memcpy(pm->hw_addr, pit->second.hw_addr.data(), 6);
+  };
+  const uint8_t type = h->get(&ofp_header::type);
+  if(s.version == OFP13_VERSION && type == OFPT13_PORT_MOD && len >= sizeof(ofp13_port_mod)){
+    auto* pm = reinterpret_cast<ofp13_port_mod*>(buf->data());
+    fill_hw(pm, from_be(pm->port_no));
+  } else if(s.version == OFP_VERSION && type == OFPT_PORT_MOD && len >= sizeof(ofp_port_mod)){
+    auto* pm = reinterpret_cast<ofp_port_mod*>(buf->data());
+    fill_hw(pm, from_be(pm->port_no));
+  }
+  try { impl_->send_all(fd, buf->data(), buf->size()); }
+  catch(const std::exception&){ return false; }   // 斷線由 reactor 處理
+  if(type == OFPT_FLOW_MOD)   // 1.3 flow_mod 的 table_id 在 offset 24；1.0 只有 table 0
+    ++s.flow_mods[s.version == OFP13_VERSION ? h->bytes().u8(24) : 0];
+  return true;
 }
 
 void OFController::barrier(int swid){
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if(it==g_impl.sw_index_to_fd.end()) return;
-  g_impl.send_barrier(it->second);
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->target_locked(swid);
+  if(fd == Impl::kNoTarget) return;
+  impl_->send_barrier(fd);
 }
 
 std::map<int, PortStats> OFController::poll_port_stats(int swid){
   std::map<int, PortStats> out;
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if(it==g_impl.sw_index_to_fd.end()) return out;
-  int fd = it->second;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return out;
 
-  g_impl.send_port_stats_req(fd, 0xffff);
+  impl_->send_port_stats_req(fd);
   std::this_thread::sleep_for(std::chrono::milliseconds(120));
 
-  auto sit = g_impl.sw.find(fd);
-  if (sit == g_impl.sw.end()) return out;
-  for (const auto& kv : sit->second.last_ps) {
-    const int port = kv.first;
-    const auto& ps = kv.second;
-    PortStats s{};
-    s.rx_bytes  = be64toh(*(const uint64_t*)&ps.rx_bytes);
-    s.tx_bytes  = be64toh(*(const uint64_t*)&ps.tx_bytes);
-    s.speedMbps = 0;
-    out[port] = s;
-  }
+  auto sit = impl_->sw.find(fd);
+  if (sit == impl_->sw.end()) return out;
+  for (const auto& kv : sit->second.last_ps)
+    out[kv.first] = impl_->to_port_stats_locked(fd, kv.first, kv.second);
   return out;
 }
 
@@ -715,83 +1722,192 @@ std::string OFController::ip_match(int in_port,
 // =============================
 // Extra public methods needed by TopoViewer / Monitor
 // =============================
-void OFController::on_lldp(OnLLDP cb) { std::lock_guard<std::mutex> lk(mtx_); cb_lldp_ = std::move(cb); }
-void OFController::set_lldp_period(std::chrono::milliseconds p) { std::lock_guard<std::mutex> lk(mtx_); lldp_period_ = p; }
-void OFController::set_stats_period(std::chrono::milliseconds p){ std::lock_guard<std::mutex> lk(mtx_); stats_period_ = p; }
+void OFController::on_lldp(OnLLDP cb)                { impl_->bus.subscribe(std::move(cb)); }
+void OFController::on_switch_state(OnSwitchState cb) { impl_->bus.subscribe(std::move(cb)); }
+void OFController::on_packet_in(OnPacketIn cb)       { impl_->bus.subscribe(std::move(cb)); }
+void OFController::on_error(OnError cb)              { impl_->bus.subscribe(std::move(cb)); }
+void OFController::on_stats_reply(OnStatsReply cb)   { impl_->bus.subscribe(std::move(cb)); }
+void OFController::on_link_down(OnLinkDown cb)       { impl_->bus.subscribe(std::move(cb)); }
+void OFController::set_event_executor(std::function<void(std::function<void()>)> ex) {
+  impl_->bus.set_executor(std::move(ex));
+}
+EventBusStats OFController::event_bus_stats() const { return impl_->bus.stats(); }
+
+void OFController::set_supported_versions(uint32_t bitmap) {
+  bitmap &= (1u << kOFVersion10) | (1u << kOFVersion13);
+  if (bitmap) impl_->supported_versions = bitmap;
+}
+
+uint8_t OFController::switch_version(int swid) const {
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0)
+    return impl_->hooks.remote_version ? impl_->hooks.remote_version(swid) : 0;
+  auto sit = impl_->sw.find(fd);
+  return sit == impl_->sw.end() ? 0 : sit->second.version;
+}
+
+void OFController::set_echo_probe(std::chrono::milliseconds interval, int max_missed) {
+  impl_->echo_interval_ms = int64_t(interval.count());
+  impl_->echo_max_missed  = max_missed;
+}
+
+std::map<int, EchoStats> OFController::echo_stats() const {
+  std::map<int, EchoStats> out;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  impl_->reg.for_each([&](int swid, int fd) {
+    auto sit = impl_->sw.find(fd);
+    if (sit == impl_->sw.end()) return;
+    const auto& s = sit->second;
+    EchoStats e;
+    e.sent = s.echo_sent; e.replies = s.echo_replies; e.missed = s.echo_missed;
+    e.consecutive_missed = s.echo_consec_missed;
+    e.samples = s.rtt_us.count();
+    e.min_ms = s.rtt_us.min() / 1000.0;
+    e.p50_ms = s.rtt_us.quantile(0.50) / 1000.0;
+    e.p99_ms = s.rtt_us.quantile(0.99) / 1000.0;
+    e.max_ms = s.rtt_us.max() / 1000.0;
+    out[swid] = e;
+  });
+  return out;
+}
+std::map<int, ChannelMetrics> OFController::metrics_snapshot() const {
+  std::map<int, ChannelMetrics> out;
+  const auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  impl_->reg.for_each([&](int swid, int fd) {
+    auto sit = impl_->sw.find(fd);
+    if (sit == impl_->sw.end()) return;
+    const auto& s = sit->second;
+    const auto& c = s.chan;
+    ChannelMetrics m;
+    m.dpid = s.dpid;
+    for (size_t t = 0; t < Impl::kTypeSlots; ++t) {
+      if (c.in[t])  m.msgs_in[uint8_t(t)]  = c.in[t];
+      if (c.out[t]) m.msgs_out[uint8_t(t)] = c.out[t];
+    }
+    m.bytes_in = c.bytes_in; m.bytes_out = c.bytes_out;
+    m.packet_ins = c.packet_ins;
+    // 目前的窗已超過 1 秒（packet-in 變少或停了）就以它為準，否則用上一個完整窗
+    const double open_s = std::chrono::duration<double>(now - c.pin_window_start).count();
+    m.packet_in_rate = (c.packet_ins && open_s >= 1.0) ? double(c.pin_window) / open_s : c.pin_rate;
+    m.queue_depth = c.queue_depth; m.queue_depth_max = c.queue_depth_max;
+    m.rx_backlog_bytes = s.rx->size();
+    m.tx_backlog_bytes = s.tx.size();
+    m.send_stalls = c.send_stalls; m.send_stall_ms = c.send_stall_ms;
+    m.wait_p50_us   = double(c.wait_us.quantile(0.50));
+    m.wait_p99_us   = double(c.wait_us.quantile(0.99));
+    m.wait_max_us   = double(c.wait_us.max());
+    m.handle_p50_us = double(c.handle_us.quantile(0.50));
+    m.handle_p99_us = double(c.handle_us.quantile(0.99));
+    m.handle_max_us = double(c.handle_us.max());
+    out[swid] = std::move(m);
+  });
+  return out;
+}
+void OFController::set_handshake_limits(size_t max_inflight, std::chrono::milliseconds timeout){
+  impl_->hs_limit = std::max<size_t>(1, max_inflight);
+  impl_->hs_timeout_ms = int64_t(timeout.count());
+}
+
+HandshakeStats OFController::handshake_stats() const {
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  HandshakeStats h;
+  h.in_progress = impl_->hs_active;
+  h.queued      = impl_->hs_queue.size();
+  h.completed   = impl_->hs_completed;
+  h.timed_out   = impl_->hs_timed_out;
+  h.p50_ms = impl_->hs_us.quantile(0.50) / 1000.0;
+  h.p99_ms = impl_->hs_us.quantile(0.99) / 1000.0;
+  h.max_ms = impl_->hs_us.max() / 1000.0;
+  return h;
+}
+
+void OFController::set_lldp_period(std::chrono::milliseconds p) { impl_->lldp_period_ms  = int64_t(p.count()); }
+void OFController::set_lldp_backoff(std::chrono::milliseconds ceiling) { impl_->lldp_ceiling_ms = int64_t(ceiling.count()); }
+void OFController::set_stats_period(std::chrono::milliseconds p){ impl_->stats_period_ms = int64_t(p.count()); }
 
 std::vector<int> OFController::switch_ids() const {
-  std::vector<int> ids;
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  ids.reserve(g_impl.sw_index_to_fd.size());
-  for (const auto& kv : g_impl.sw_index_to_fd) ids.push_back(kv.first);
-  return ids;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  return impl_->reg.ids();
 }
 
 std::vector<int> OFController::ports_of(int swid) const {
   std::vector<int> ports;
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if (it == g_impl.sw_index_to_fd.end()) return ports;
-  int fd = it->second;
-  auto sit = g_impl.sw.find(fd);
-  if (sit == g_impl.sw.end()) return ports;
-  ports.reserve(sit->second.last_ps.size());
-  for (const auto& kv : sit->second.last_ps) ports.push_back(kv.first);
-  std::sort(ports.begin(), ports.end());
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return ports;
+  auto sit = impl_->sw.find(fd);
+  if (sit == impl_->sw.end()) return ports;
+  // 埠描述（FEATURES_REPLY / PORT_DESC）∪ 已收到統計的埠
+  std::set<int> uniq;
+  for (const auto& kv : sit->second.port_desc) uniq.insert(kv.first);
+  for (const auto& kv : sit->second.last_ps)   uniq.insert(kv.first);
+  ports.assign(uniq.begin(), uniq.end());
   return ports;
 }
 
+uint32_t OFController::port_speed_mbps(int swid, int port_no) const {
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return 0;
+  return impl_->port_speed_locked(fd, port_no);
+}
+
 std::optional<SwitchInfo> OFController::switch_info(int swid) const {
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if (it == g_impl.sw_index_to_fd.end()) return std::nullopt;
-  int fd = it->second;
-  auto sit = g_impl.sw.find(fd);
-  if (sit == g_impl.sw.end()) return std::nullopt;
-
-  SwitchInfo info;
-  info.swid = swid;
-  info.dpid = sit->second.dpid;
-  info.connected = true;
-  for (const auto& kv : sit->second.last_ps) {
-    PortInfo pi{};
-    pi.port_no = kv.first;
-    pi.up = true;
-    pi.curr_speedMbps = 0;
-    const auto& ps = kv.second;
-    pi.last.rx_bytes = be64toh(*(const uint64_t*)&ps.rx_bytes);
-    pi.last.tx_bytes = be64toh(*(const uint64_t*)&ps.tx_bytes);
-    pi.last.speedMbps = 0;
-    info.ports[pi.port_no] = pi;
-  }
-  return info;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->reg.fd_of(swid);
+  if (fd < 0) return std::nullopt;
+  return impl_->switch_info_locked(swid, fd);
+}
+
+std::map<int, SwitchInfo> OFController::inventory_snapshot() const {
+  std::map<int, SwitchInfo> out;
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  impl_->reg.for_each([&](int swid, int fd) {
+    if (auto info = impl_->switch_info_locked(swid, fd)) out[swid] = std::move(*info);
+  });
+  return out;
 }
 
 void OFController::port_mod(int swid, int port_no, bool up, int speedMbps){
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  auto it = g_impl.sw_index_to_fd.find(swid);
-  if(it==g_impl.sw_index_to_fd.end()) return;
-  int fd = it->second;
-
-  ofp_port_mod pm{}; pm.header.version=OFP_VERSION; pm.header.type=OFPT_PORT_MOD;
-  pm.port_no=htobe16_u(uint16_t(port_no));
-  memset(pm.hw_addr, 0, sizeof(pm.hw_addr));
-  pm.config = up ? 0 : htonl(OFPPC_PORT_DOWN);
-  pm.mask   = htonl(OFPPC_PORT_DOWN);
-  pm.advertise = htonl(advertise_mask_for_speed(speedMbps));
-  pm.header.length=htobe16_u(sizeof(pm));
-  pm.header.xid=htobe32_u(g_impl.xid++);
-  OFControllerImpl::send_all(fd,&pm,sizeof(pm));
-  g_impl.send_barrier(fd);
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  const int fd = impl_->target_locked(swid);
+  if(fd == Impl::kNoTarget) return;
+  const uint8_t ver = impl_->version_of(fd);
+
+  // switch 會比對 hw_addr，取自埠描述（未知時為全 0；遠端 switch 由 owner 的 send_raw 補上）
+  std::array<uint8_t,6> hw{};
+  if(auto sit = impl_->sw.find(fd); sit != impl_->sw.end()){
+    const auto& pd = sit->second.port_desc;
+    if(auto pit = pd.find(port_no); pit != pd.end()) hw = pit->second.hw_addr;
+  }
+
+  const uint32_t config    = up ? 0 : htobe32_u(OFPPC_PORT_DOWN);
+  const uint32_t mask      = htobe32_u(OFPPC_PORT_DOWN);
+  const uint32_t advertise = htobe32_u(advertise_mask_for_speed(ver, speedMbps));
+  if(ver == OFP13_VERSION){
+    auto pm = make<ofp13_port_mod, OFPT13_PORT_MOD>(OFP13_VERSION, impl_->xid++);
+    pm.port_no = htobe32_u(uint32_t(port_no));
+    memcpy(pm.hw_addr, hw.data(), 6);
+    pm.config=config; pm.mask=mask; pm.advertise=advertise;
+    impl_->send_all(fd,&pm,sizeof(pm));
+  } else {
+    auto pm = make<ofp_port_mod, OFPT_PORT_MOD>(OFP_VERSION, impl_->xid++);
+    pm.port_no = htobe16_u(uint16_t(port_no));
+    memcpy(pm.hw_addr, hw.data(), 6);
+    pm.config=config; pm.mask=mask; pm.advertise=advertise;
+    impl_->send_all(fd,&pm,sizeof(pm));
+  }
+  impl_->send_barrier(fd);
 }
 
 void OFController::stop(){
-  if(!g_impl.running) return;
-  g_impl.running=false;
-  if(g_impl.listen_fd>=0){ close(g_impl.listen_fd); g_impl.listen_fd=-1; }
-  if(g_impl.loop_thread.joinable()) g_impl.loop_thread.join();
-  std::lock_guard<std::mutex> lk(g_impl.mtx);
-  for(auto& kv : g_impl.sw){ close(kv.first); }
-  g_impl.sw.clear(); g_impl.sw_index_to_fd.clear();
+  if(!impl_->running.exchange(false)) return;
+  if(impl_->loop_thread.joinable()) impl_->loop_thread.join();
+  impl_->bus.stop();
+  if(impl_->listen_fd>=0){ close(impl_->listen_fd); impl_->listen_fd=-1; }
+  std::lock_guard<std::mutex> lk(impl_->mtx);
+  for(auto& kv : impl_->sw){ close(kv.first); }
+  impl_->sw.clear(); impl_->reg.clear();
 }
-
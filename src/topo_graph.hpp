@@ -0,0 +1,121 @@
+#pragma once
+#ifndef HYBRID_TOPO_GRAPH_HPP
+#define HYBRID_TOPO_GRAPH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "topo_viewer.hpp"
+
+//
+//  Topology Graph Snapshot
+//  -----------------------------------------------
+//  Immutable CSR view of the discovered topology at one epoch. TopoViewer
+//  builds a new one after each structural change and swaps it in atomically;
+//  readers (path computation, capacity reconciliation, the MILP inputs) hold
+//  a shared_ptr to the same object, so they never copy and never lock.
+//
+//    nodes  : dense index -> node id, ascending
+//    edges  : edge id -> Edge (canonical u < v, same order as snapshot_edges())
+//    row    : adjacency of dense node i is [row[i], row[i+1]) in nbr / via / port
+//    speeds : per edge, port speed of each end when the snapshot was built
+//             (0 = unknown; consumers fall back to a live query)
+//
+//  Half-edges of a node keep the order of the edge list, so a BFS over the
+//  CSR visits neighbours exactly like one over the old map-of-vectors.
+//
+struct TopoGraph {
+  using Edge = TopoViewer::Edge;
+  struct Speed { uint32_t u_mbps{0}, v_mbps{0}; };
+
+  uint64_t epoch{0};
+  std::vector<int>      nodes;
+  std::vector<Edge>     edges;
+  std::vector<Speed>    speeds;
+  std::vector<uint32_t> row;     // nodes.size() + 1
+  std::vector<int>      nbr;     // neighbour (dense index)
+  std::vector<int>      via;     // edge id
+  std::vector<int>      port;    // this node's port on that edge
+
+  size_t node_count() const { return nodes.size(); }
+  size_t edge_count() const { return edges.size(); }
+  int node_id(int idx) const { return nodes[size_t(idx)]; }
+  // Dense index of a node id; -1 if the node has no edges.
+  int index_of(int node) const {
+    auto it = std::lower_bound(nodes.begin(), nodes.end(), node);
+    return (it == nodes.end() || *it != node) ? -1 : int(it - nodes.begin());
+  }
+  // f(neighbour_index, edge_id, local_port) for every half-edge of node 'idx'
+  template<class F> void for_each_neighbor(int idx, F&& f) const {
+    for (uint32_t i = row[size_t(idx)]; i < row[size_t(idx) + 1]; ++i) f(nbr[i], via[i], port[i]);
+  }
+
+  // Up to k loop-free paths s -> d of at most max_nodes nodes, as dense index
+  // sequences, in BFS order (fewest hops first, ties by half-edge order).
+  std::vector<std::vector<int>> k_paths(int s, int d, size_t k, size_t max_nodes = 10) const {
+    std::vector<std::vector<int>> out;
+    const int si = index_of(s), di = index_of(d);
+    if (si < 0 || di < 0) return out;
+    struct P { int node; std::vector<int> seq; };
+    std::queue<P> q; q.push({si, {si}});
+    std::set<std::vector<int>> seen;   // 平行邊會走出相同的節點序列
+    while (!q.empty() && out.size() < k) {
+      auto cur = q.front(); q.pop();
+      if (cur.seq.size() > max_nodes) continue;
+      if (cur.node == di) {
+        if (seen.insert(cur.seq).second) out.push_back(std::move(cur.seq));
+        continue;
+      }
+      for_each_neighbor(cur.node, [&](int nb, int, int) {
+        if (std::find(cur.seq.begin(), cur.seq.end(), nb) != cur.seq.end()) return;   // 禁止成環
+        auto nxt = cur.seq; nxt.push_back(nb);
+        q.push({nb, std::move(nxt)});
+      });
+    }
+    return out;
+  }
+
+  // 'edges' must be canonical (u < v); 'speeds' is empty or one per edge.
+  static std::shared_ptr<const TopoGraph> build(uint64_t epoch, std::vector<Edge> edges,
+                                                std::vector<Speed> speeds = {}) {
+    auto g = std::make_shared<TopoGraph>();
+    g->epoch = epoch;
+    g->edges = std::move(edges);
+    g->speeds = std::move(speeds);
+    g->speeds.resize(g->edges.size());
+
+    for (const auto& e : g->edges) { g->nodes.push_back(e.u); g->nodes.push_back(e.v); }
+    std::sort(g->nodes.begin(), g->nodes.end());
+    g->nodes.erase(std::unique(g->nodes.begin(), g->nodes.end()), g->nodes.end());
+
+    // 計數排序：先數每個 node 的度數，再依邊的順序填入（保持穩定順序）
+    const size_t n = g->nodes.size(), m = g->edges.size();
+    std::vector<std::pair<int,int>> ends(m);
+    g->row.assign(n + 1, 0);
+    for (size_t id = 0; id < m; ++id) {
+      ends[id] = {g->index_of(g->edges[id].u), g->index_of(g->edges[id].v)};
+      ++g->row[size_t(ends[id].first) + 1];
+      ++g->row[size_t(ends[id].second) + 1];
+    }
+    for (size_t i = 0; i < n; ++i) g->row[i + 1] += g->row[i];
+    g->nbr.resize(2 * m); g->via.resize(2 * m); g->port.resize(2 * m);
+    std::vector<uint32_t> fill(g->row.begin(), g->row.end() - 1);
+    for (size_t id = 0; id < m; ++id) {
+      const auto [a, b] = ends[id];
+      const auto& e = g->edges[id];
+      uint32_t& fa = fill[size_t(a)];
+      g->nbr[fa] = b; g->via[fa] = int(id); g->port[fa] = e.u_port; ++fa;
+      uint32_t& fb = fill[size_t(b)];
+      g->nbr[fb] = a; g->via[fb] = int(id); g->port[fb] = e.v_port; ++fb;
+    }
+    return g;
+  }
+};
+
+#endif // HYBRID_TOPO_GRAPH_HPP
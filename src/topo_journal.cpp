@@ -0,0 +1,250 @@
+// src/topo_journal.cpp
+#include "topo_journal.hpp"
+#include "topo_graph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char   kMagic[8]  = {'H','O','F','T','J','R','N','\0'};
+constexpr size_t kGrowBytes = 1u << 20;
+
+// 檔頭固定 64 bytes；count 是唯一會被更新的欄位（記錄寫完才 release-store）
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  int64_t created_ns;
+  std::atomic<uint64_t> count;
+  uint8_t reserved[32];
+};
+static_assert(sizeof(Header) == 64, "journal header layout is part of the file format");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "header count is shared with readers");
+
+int64_t wall_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 檔頭合法：magic / 版本 / 記錄大小都對得上
+bool header_ok(const Header* h, const std::string& path) {
+  if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0) {
+    std::cerr << "[journal] " << path << ": not a topology journal\n";
+    return false;
+  }
+  if (h->version != TopoJournal::kFormatVersion || h->record_size != sizeof(TopoJournalRecord)) {
+    std::cerr << "[journal] " << path << ": format version " << h->version << " / record size "
+              << h->record_size << " not supported\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+const char* journal_kind_name(TopoJournalRecord::Kind k) {
+  switch (k) {
+    case TopoJournalRecord::Kind::EdgeUp:     return "edge_up";
+    case TopoJournalRecord::Kind::EdgeDown:   return "edge_down";
+    case TopoJournalRecord::Kind::EdgeMoved:  return "edge_moved";
+    case TopoJournalRecord::Kind::SwitchUp:   return "switch_up";
+    case TopoJournalRecord::Kind::SwitchDown: return "switch_down";
+    case TopoJournalRecord::Kind::PortDown:   return "port_down";
+    case TopoJournalRecord::Kind::Suppressed: return "suppressed";
+    case TopoJournalRecord::Kind::Reused:     return "reused";
+    case TopoJournalRecord::Kind::Start:      return "start";
+    default:                                  return "unknown";
+  }
+}
+
+// ============ TopoJournal ============
+std::unique_ptr<TopoJournal> TopoJournal::open(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cerr << "[journal] open " << path << ": " << std::strerror(errno) << "\n";
+    return nullptr;
+  }
+  std::unique_ptr<TopoJournal> j(new TopoJournal(path, fd));
+  struct stat st{};
+  if (::fstat(fd, &st) != 0) {
+    std::cerr << "[journal] stat " << path << ": " << std::strerror(errno) << "\n";
+    return nullptr;
+  }
+  const size_t have = size_t(st.st_size);
+  if (have == 0) {
+    // 新檔：ftruncate 補的是 0，count 從 0 開始
+    if (!j->remap_(kGrowBytes)) return nullptr;
+    auto* h = new (j->map_) Header;
+    std::memcpy(h->magic, kMagic, sizeof(kMagic));
+    h->version = kFormatVersion;
+    h->record_size = uint32_t(sizeof(TopoJournalRecord));
+    h->created_ns = wall_ns();
+    h->count.store(0, std::memory_order_release);
+    j->valid_ = true;
+    return j;
+  }
+  if (have < sizeof(Header)) {
+    std::cerr << "[journal] " << path << ": truncated header\n";
+    return nullptr;
+  }
+  // 先唯讀檢查檔頭，確定是 journal 才長大檔案：別的檔案或舊格式原封不動
+  {
+    void* m = ::mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+      std::cerr << "[journal] mmap " << path << ": " << std::strerror(errno) << "\n";
+      return nullptr;
+    }
+    const bool ok = header_ok(static_cast<const Header*>(m), path);
+    ::munmap(m, sizeof(Header));
+    if (!ok) return nullptr;
+  }
+  if (!j->remap_(std::max(have, kGrowBytes))) return nullptr;
+  const auto* h = reinterpret_cast<const Header*>(j->map_);
+  // 續寫：count 以檔頭為準，尾端沒算進去的（寫到一半就掛）直接覆蓋
+  const uint64_t fits = (have - sizeof(Header)) / sizeof(TopoJournalRecord);
+  j->count_ = std::min<uint64_t>(h->count.load(std::memory_order_acquire), fits);
+  if (j->count_) {
+    const auto* last = reinterpret_cast<const TopoJournalRecord*>(j->map_ + sizeof(Header)) + (j->count_ - 1);
+    j->last_ns_ = last->t_ns;
+  }
+  j->valid_ = true;
+  return j;
+}
+
+// 把檔案長到 bytes 並重新映射；呼叫端持有 mtx_（或尚未共享）
+bool TopoJournal::remap_(size_t bytes) {
+  if (::ftruncate(fd_, off_t(bytes)) != 0) {
+    std::cerr << "[journal] grow " << path_ << ": " << std::strerror(errno) << "\n";
+    return false;
+  }
+  void* m = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (m == MAP_FAILED) {
+    std::cerr << "[journal] mmap " << path_ << ": " << std::strerror(errno) << "\n";
+    return false;
+  }
+  if (map_) ::munmap(map_, map_bytes_);
+  map_ = static_cast<uint8_t*>(m);
+  map_bytes_ = bytes;
+  return true;
+}
+
+TopoJournal::~TopoJournal() {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (map_) ::munmap(map_, map_bytes_);
+  // 去掉預先長出來的空白尾巴；open 沒成功就不動檔案
+  if (fd_ >= 0 && valid_) (void)::ftruncate(fd_, off_t(sizeof(Header) + count_ * sizeof(TopoJournalRecord)));
+  if (fd_ >= 0) ::close(fd_);
+  if (dropped_) std::cerr << "[journal] " << path_ << ": " << dropped_ << " records dropped\n";
+}
+
+void TopoJournal::append(TopoJournalRecord r) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  const size_t end = sizeof(Header) + size_t(count_ + 1) * sizeof(TopoJournalRecord);
+  if (end > map_bytes_ && !remap_(map_bytes_ + kGrowBytes)) {
+    ++dropped_;
+    return;
+  }
+  // 牆上時間被往回調時沿用上一筆，檔案維持依時間排序
+  last_ns_ = std::max(last_ns_, wall_ns());
+  r.t_ns = last_ns_;
+  std::memcpy(map_ + sizeof(Header) + size_t(count_) * sizeof(TopoJournalRecord), &r, sizeof(r));
+  reinterpret_cast<Header*>(map_)->count.store(++count_, std::memory_order_release);
+}
+
+uint64_t TopoJournal::size() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return count_;
+}
+
+// ============ TopoJournalReader ============
+std::unique_ptr<TopoJournalReader> TopoJournalReader::open(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    std::cerr << "[journal] open " << path << ": " << std::strerror(errno) << "\n";
+    return nullptr;
+  }
+  struct stat st{};
+  const bool sized = ::fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header);
+  void* m = sized ? ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+  if (m == MAP_FAILED) {
+    std::cerr << "[journal] " << path << ": " << (sized ? std::strerror(errno) : "truncated header") << "\n";
+    return nullptr;
+  }
+  std::unique_ptr<TopoJournalReader> r(new TopoJournalReader);
+  r->map_ = m;
+  r->map_bytes_ = size_t(st.st_size);
+  const auto* h = static_cast<const Header*>(m);
+  if (!header_ok(h, path)) return nullptr;
+  r->created_ns_ = h->created_ns;
+  r->rec_ = reinterpret_cast<const TopoJournalRecord*>(static_cast<const uint8_t*>(m) + sizeof(Header));
+  const uint64_t fits = (r->map_bytes_ - sizeof(Header)) / sizeof(TopoJournalRecord);
+  r->n_ = size_t(std::min<uint64_t>(h->count.load(std::memory_order_acquire), fits));
+
+  // 一次走完，每 kCheckpointEvery 筆留一份邊集合
+  std::set<Key> cur;
+  for (size_t i = 0; i < r->n_; ++i) {
+    if (i % kCheckpointEvery == 0) r->checkpoints_.emplace_back(cur.begin(), cur.end());
+    apply_(cur, r->rec_[i]);
+  }
+  if (r->checkpoints_.empty()) r->checkpoints_.emplace_back();
+  return r;
+}
+
+TopoJournalReader::~TopoJournalReader() {
+  if (map_) ::munmap(map_, map_bytes_);
+}
+
+void TopoJournalReader::apply_(std::set<Key>& edges, const TopoJournalRecord& r) {
+  switch (r.kind) {
+    case TopoJournalRecord::Kind::EdgeUp:
+      edges.emplace(r.u, r.v, r.u_port, r.v_port);
+      break;
+    case TopoJournalRecord::Kind::EdgeDown:
+      edges.erase(Key{r.u, r.v, r.u_port, r.v_port});
+      break;
+    case TopoJournalRecord::Kind::EdgeMoved:
+      edges.erase(Key{r.u, r.v, r.old_u_port, r.old_v_port});
+      edges.emplace(r.u, r.v, r.u_port, r.v_port);
+      break;
+    case TopoJournalRecord::Kind::Start:
+      edges.clear();
+      break;
+    default: break;   // 觸發事件本身不改變邊集合
+  }
+}
+
+size_t TopoJournalReader::count_until(int64_t t_ns) const {
+  return size_t(std::upper_bound(rec_, rec_ + n_, t_ns,
+                                 [](int64_t t, const TopoJournalRecord& r){ return t < r.t_ns; }) - rec_);
+}
+
+std::vector<TopoViewer::Edge> TopoJournalReader::edges_after(size_t n) const {
+  n = std::min(n, n_);
+  const size_t cp = std::min(n / kCheckpointEvery, checkpoints_.size() - 1);
+  std::set<Key> cur(checkpoints_[cp].begin(), checkpoints_[cp].end());
+  for (size_t i = cp * kCheckpointEvery; i < n; ++i) apply_(cur, rec_[i]);
+  std::vector<TopoViewer::Edge> out;
+  out.reserve(cur.size());
+  for (const auto& [u, v, up, vp] : cur) out.push_back(TopoViewer::Edge{u, v, up, vp, {}});
+  return out;
+}
+
+std::shared_ptr<const TopoGraph> TopoJournalReader::graph_at(int64_t t_ns) const {
+  const size_t n = count_until(t_ns);
+  uint64_t epoch = 0;
+  for (size_t i = n; i-- > 0; )
+    if (rec_[i].epoch) { epoch = rec_[i].epoch; break; }
+  return TopoGraph::build(epoch, edges_after(n));
+}
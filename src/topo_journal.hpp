@@ -0,0 +1,132 @@
+#pragma once
+#ifndef HYBRID_TOPO_JOURNAL_HPP
+#define HYBRID_TOPO_JOURNAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "topo_viewer.hpp"   // TopoViewer::Edge
+
+struct TopoGraph;            // topo_graph.hpp
+
+//
+//  Topology Event Journal
+//  -----------------------------------------------
+//  Append-only binary log of everything TopoViewer saw, so the sequence of
+//  topology changes behind a TE decision can be replayed offline:
+//
+//    header  : magic "HOFTJRN\0", format version, record size, committed
+//              record count, creation time (64 bytes)
+//    records : fixed 48-byte TopoJournalRecord, host byte order, append order
+//
+//  Edge records follow TopoViewer's change deltas (the TE view, so dampened
+//  edges come and go with Suppressed / Reused); switch and port records are
+//  the triggers, written just before the edge changes they cause. Every
+//  controller run starts with a Start record, so replay forgets the edges of
+//  the previous run (it never recorded their removal). Timestamps are wall
+//  clock, clamped to never go backwards so the file stays sorted.
+//
+//  TopoJournal maps the file shared and grows it 1 MiB at a time. A record is
+//  copied in before the header count is bumped, so a crash or a concurrent
+//  reader never sees half a record. Opening an existing journal appends.
+//
+//  TopoJournalReader maps a journal read-only and keeps the edge set at every
+//  kCheckpointEvery-th record; edges_at(t) starts from the last checkpoint
+//  before t and replays at most that many records.
+//
+struct TopoJournalRecord {
+  enum class Kind : uint8_t {
+    EdgeUp = 1,     // u, v, u_port, v_port
+    EdgeDown,       // u, v, u_port, v_port
+    EdgeMoved,      // u, v, u_port, v_port (new), old_u_port, old_v_port
+    SwitchUp,       // u = swid
+    SwitchDown,     // u = swid
+    PortDown,       // u = swid, u_port = port, cause = LinkDownEvent::Cause
+    Suppressed,     // edge dampened (hidden from TE)
+    Reused,         // dampening lifted
+    Start,          // a TopoViewer (re)started on this journal: no edges
+  };
+  int64_t  t_ns{0};          // system_clock since the Unix epoch
+  uint64_t epoch{0};         // TopoViewer epoch after an edge change; 0 for the rest
+  Kind     kind{Kind::EdgeUp};
+  uint8_t  cause{0};
+  uint16_t reserved0{0};
+  int32_t  u{0}, v{0}, u_port{0}, v_port{0};
+  int32_t  old_u_port{0}, old_v_port{0};
+  uint32_t reserved1{0};
+};
+static_assert(sizeof(TopoJournalRecord) == 48, "journal record layout is part of the file format");
+
+const char* journal_kind_name(TopoJournalRecord::Kind k);
+
+class TopoJournal {
+public:
+  static constexpr uint32_t kFormatVersion = 1;
+
+  // Create, or reopen and append; nullptr (logged) if the file is not a journal.
+  static std::unique_ptr<TopoJournal> open(const std::string& path);
+  ~TopoJournal();
+  TopoJournal(const TopoJournal&) = delete;
+  TopoJournal& operator=(const TopoJournal&) = delete;
+
+  // Thread-safe; stamps t_ns.
+  void append(TopoJournalRecord r);
+  uint64_t size() const;
+  const std::string& path() const { return path_; }
+
+private:
+  TopoJournal(std::string path, int fd) : path_(std::move(path)), fd_(fd) {}
+  bool remap_(size_t bytes);
+
+  std::string path_;
+  int fd_{-1};
+  uint8_t* map_{nullptr};
+  size_t map_bytes_{0};
+  mutable std::mutex mtx_;
+  uint64_t count_{0};
+  int64_t last_ns_{0};
+  uint64_t dropped_{0};
+  bool valid_{false};   // open() succeeded: the destructor may trim the file
+};
+
+class TopoJournalReader {
+public:
+  static constexpr size_t kCheckpointEvery = 4096;
+
+  // nullptr (logged) on a missing, foreign or truncated file.
+  static std::unique_ptr<TopoJournalReader> open(const std::string& path);
+  ~TopoJournalReader();
+  TopoJournalReader(const TopoJournalReader&) = delete;
+  TopoJournalReader& operator=(const TopoJournalReader&) = delete;
+
+  size_t size() const { return n_; }
+  const TopoJournalRecord& operator[](size_t i) const { return rec_[i]; }
+  int64_t created_ns() const { return created_ns_; }
+
+  // Records with t_ns <= t
+  size_t count_until(int64_t t_ns) const;
+  // TE-view edges after the first n records / as of time t (sorted, last_seen unset)
+  std::vector<TopoViewer::Edge> edges_after(size_t n) const;
+  std::vector<TopoViewer::Edge> edges_at(int64_t t_ns) const { return edges_after(count_until(t_ns)); }
+  std::shared_ptr<const TopoGraph> graph_at(int64_t t_ns) const;
+
+private:
+  using Key = std::tuple<int,int,int,int>;   // u, v, u_port, v_port
+  TopoJournalReader() = default;
+  static void apply_(std::set<Key>& edges, const TopoJournalRecord& r);
+
+  void* map_{nullptr};
+  size_t map_bytes_{0};
+  const TopoJournalRecord* rec_{nullptr};
+  size_t n_{0};
+  int64_t created_ns_{0};
+  std::vector<std::vector<Key>> checkpoints_;   // [i] = edges after i * kCheckpointEvery records
+};
+
+#endif // HYBRID_TOPO_JOURNAL_HPP
@@ -0,0 +1,236 @@
+#pragma once
+#ifndef HYBRID_TOPO_METRICS_HPP
+#define HYBRID_TOPO_METRICS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "topo_graph.hpp"
+
+//
+//  Topology Metrics
+//  -----------------------------------------------
+//  Structural hints for the TE optimizer, per node-level link (parallel edges
+//  between two nodes count as one link, like te::LinkId):
+//
+//    bridge       : removing the link disconnects its end nodes, so β must stay 1
+//    connectivity : edge-disjoint paths between the end nodes, capped at kMax
+//                   (1 = bridge; kMax = losing the link still leaves spares)
+//    betweenness  : share of node pairs whose shortest paths cross the link
+//                   (Brandes; ties split evenly)
+//
+//  sleep_order() ranks links from the cheapest to put to sleep (well protected,
+//  little through traffic) to the most expensive, bridges last. Results are
+//  immutable like the TopoGraph they come from; update() returns the previous
+//  object when a new snapshot has the same links (port changes, re-added
+//  parallel edges), so the analysis only reruns on real structural change.
+//
+struct TopoMetrics {
+  static constexpr int kMax = 3;
+
+  struct Link {
+    int u{0}, v{0};            // node ids, u < v
+    int parallel{1};           // edges between u and v
+    bool bridge{false};
+    int connectivity{0};       // min(kMax, edge-disjoint u-v paths)
+    double betweenness{0.0};   // 0..1
+  };
+
+  uint64_t epoch{0};           // snapshot the metrics were computed from
+  std::vector<Link> links;     // sorted by (u, v)
+
+  size_t bridge_count() const {
+    return size_t(std::count_if(links.begin(), links.end(), [](const Link& l){ return l.bridge; }));
+  }
+  const Link* find(int u, int v) const {
+    if (u > v) std::swap(u, v);
+    auto it = std::lower_bound(links.begin(), links.end(), std::make_pair(u, v),
+                               [](const Link& l, const std::pair<int,int>& k){ return std::make_pair(l.u, l.v) < k; });
+    return (it == links.end() || it->u != u || it->v != v) ? nullptr : &*it;
+  }
+  // Indices into links, cheapest sleep candidate first
+  std::vector<size_t> sleep_order() const {
+    std::vector<size_t> idx(links.size());
+    for (size_t i = 0; i < idx.size(); ++i) idx[i] = i;
+    std::stable_sort(idx.begin(), idx.end(), [&](size_t a, size_t b) {
+      const Link& x = links[a];
+      const Link& y = links[b];
+      if (x.bridge != y.bridge) return y.bridge;
+      if (x.connectivity != y.connectivity) return x.connectivity > y.connectivity;
+      return x.betweenness < y.betweenness;
+    });
+    return idx;
+  }
+
+  static std::shared_ptr<const TopoMetrics> update(std::shared_ptr<const TopoMetrics> prev, const TopoGraph& g) {
+    auto links = links_of_(g);
+    if (prev && prev->links.size() == links.size() &&
+        std::equal(links.begin(), links.end(), prev->links.begin(), [](const Link& a, const Link& b) {
+          return a.u == b.u && a.v == b.v && a.parallel == b.parallel;
+        }))
+      return prev;
+    auto m = std::make_shared<TopoMetrics>();
+    m->epoch = g.epoch;
+    m->links = std::move(links);
+    m->analyse_();
+    return m;
+  }
+  static std::shared_ptr<const TopoMetrics> compute(const TopoGraph& g) { return update(nullptr, g); }
+
+private:
+  // 鄰接：dense node index -> (鄰居, link index)
+  struct Adj { std::vector<uint32_t> row; std::vector<int> nbr, link; };
+
+  static std::vector<Link> links_of_(const TopoGraph& g) {
+    std::vector<Link> v;
+    v.reserve(g.edges.size());
+    for (const auto& e : g.edges) v.push_back(Link{std::min(e.u, e.v), std::max(e.u, e.v)});
+    std::sort(v.begin(), v.end(), [](const Link& a, const Link& b){ return std::tie(a.u, a.v) < std::tie(b.u, b.v); });
+    std::vector<Link> out;
+    for (const auto& l : v) {
+      if (!out.empty() && out.back().u == l.u && out.back().v == l.v) ++out.back().parallel;
+      else out.push_back(l);
+    }
+    return out;
+  }
+
+  void analyse_() {
+    std::vector<int> nodes;
+    for (const auto& l : links) { nodes.push_back(l.u); nodes.push_back(l.v); }
+    std::sort(nodes.begin(), nodes.end());
+    nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+    auto idx = [&](int n){ return int(std::lower_bound(nodes.begin(), nodes.end(), n) - nodes.begin()); };
+
+    const size_t n = nodes.size(), m = links.size();
+    std::vector<std::pair<int,int>> ends(m);
+    Adj a;
+    a.row.assign(n + 1, 0);
+    for (size_t i = 0; i < m; ++i) {
+      ends[i] = {idx(links[i].u), idx(links[i].v)};
+      ++a.row[size_t(ends[i].first) + 1];
+      ++a.row[size_t(ends[i].second) + 1];
+    }
+    for (size_t i = 0; i < n; ++i) a.row[i + 1] += a.row[i];
+    a.nbr.resize(2 * m); a.link.resize(2 * m);
+    std::vector<uint32_t> fill(a.row.begin(), a.row.end() - 1);
+    for (size_t i = 0; i < m; ++i) {
+      const auto [x, y] = ends[i];
+      a.nbr[fill[size_t(x)]] = y; a.link[fill[size_t(x)]++] = int(i);
+      a.nbr[fill[size_t(y)]] = x; a.link[fill[size_t(y)]++] = int(i);
+    }
+
+    find_bridges_(a, n);
+    for (size_t i = 0; i < m; ++i)
+      links[i].connectivity = links[i].bridge ? 1 : disjoint_paths_(a, ends, ends[i].first, ends[i].second);
+    betweenness_(a, n);
+  }
+
+  // Tarjan（迭代版，避免深圖爆 stack）；平行邊的 link 不可能是 bridge
+  void find_bridges_(const Adj& a, size_t n) {
+    std::vector<int> disc(n, -1), low(n, 0);
+    std::vector<std::tuple<int, int, uint32_t>> st;   // (node, 來時的 link, 下一個鄰接位置)
+    int t = 0;
+    for (size_t r = 0; r < n; ++r) {
+      if (disc[r] >= 0) continue;
+      disc[r] = low[r] = t++;
+      st.emplace_back(int(r), -1, a.row[r]);
+      while (!st.empty()) {
+        auto& [x, via, next] = st.back();
+        if (next < a.row[size_t(x) + 1]) {
+          const int y = a.nbr[next], l = a.link[next];
+          ++next;
+          if (l == via) continue;
+          if (disc[size_t(y)] < 0) {
+            disc[size_t(y)] = low[size_t(y)] = t++;
+            st.emplace_back(y, l, a.row[size_t(y)]);
+          } else {
+            low[size_t(x)] = std::min(low[size_t(x)], disc[size_t(y)]);
+          }
+          continue;
+        }
+        const int child = x, l = via;
+        st.pop_back();
+        if (st.empty()) break;
+        const int parent = std::get<0>(st.back());
+        low[size_t(parent)] = std::min(low[size_t(parent)], low[size_t(child)]);
+        if (low[size_t(child)] > disc[size_t(parent)] && links[size_t(l)].parallel == 1) links[size_t(l)].bridge = true;
+      }
+    }
+  }
+
+  // s-t 邊不相交路徑數（每個 link 容量 = 平行邊數），擴增到 kMax 為止
+  int disjoint_paths_(const Adj& a, const std::vector<std::pair<int,int>>& ends, int s, int t) const {
+    std::vector<int> flow(links.size(), 0);   // 沿 ends.first -> ends.second 為正
+    std::vector<int> prev_link(a.row.size() - 1);
+    std::vector<int> q;
+    int k = 0;
+    while (k < kMax) {
+      std::fill(prev_link.begin(), prev_link.end(), -2);
+      prev_link[size_t(s)] = -1;
+      q.assign(1, s);
+      for (size_t h = 0; h < q.size() && prev_link[size_t(t)] == -2; ++h) {
+        const int x = q[h];
+        for (uint32_t i = a.row[size_t(x)]; i < a.row[size_t(x) + 1]; ++i) {
+          const int y = a.nbr[i], l = a.link[i];
+          if (prev_link[size_t(y)] != -2) continue;
+          const int f = ends[size_t(l)].first == x ? flow[size_t(l)] : -flow[size_t(l)];
+          if (f >= links[size_t(l)].parallel) continue;   // 這個方向滿了
+          prev_link[size_t(y)] = l;
+          q.push_back(y);
+        }
+      }
+      if (prev_link[size_t(t)] == -2) break;
+      for (int y = t; y != s; ) {
+        const int l = prev_link[size_t(y)];
+        const bool fwd = ends[size_t(l)].second == y;
+        flow[size_t(l)] += fwd ? 1 : -1;
+        y = fwd ? ends[size_t(l)].first : ends[size_t(l)].second;
+      }
+      ++k;
+    }
+    return k;
+  }
+
+  // Brandes：每個來源一次 BFS，再反向累加依賴值；無向圖每對算了兩次
+  void betweenness_(const Adj& a, size_t n) {
+    std::vector<double> eb(links.size(), 0.0), sigma(n), delta(n);
+    std::vector<int> dist(n);
+    std::vector<int> order;
+    order.reserve(n);
+    for (size_t s = 0; s < n; ++s) {
+      std::fill(dist.begin(), dist.end(), -1);
+      std::fill(sigma.begin(), sigma.end(), 0.0);
+      std::fill(delta.begin(), delta.end(), 0.0);
+      order.clear();
+      dist[s] = 0; sigma[s] = 1.0;
+      order.push_back(int(s));
+      for (size_t h = 0; h < order.size(); ++h) {
+        const int x = order[h];
+        for (uint32_t i = a.row[size_t(x)]; i < a.row[size_t(x) + 1]; ++i) {
+          const int y = a.nbr[i];
+          if (dist[size_t(y)] < 0) { dist[size_t(y)] = dist[size_t(x)] + 1; order.push_back(y); }
+          if (dist[size_t(y)] == dist[size_t(x)] + 1) sigma[size_t(y)] += sigma[size_t(x)];
+        }
+      }
+      for (size_t h = order.size(); h-- > 1; ) {
+        const int y = order[h];
+        for (uint32_t i = a.row[size_t(y)]; i < a.row[size_t(y) + 1]; ++i) {
+          const int x = a.nbr[i];
+          if (dist[size_t(x)] != dist[size_t(y)] - 1) continue;
+          const double c = sigma[size_t(x)] / sigma[size_t(y)] * (1.0 + delta[size_t(y)]);
+          eb[size_t(a.link[i])] += c;
+          delta[size_t(x)] += c;
+        }
+      }
+    }
+    const double pairs = n > 1 ? double(n) * double(n - 1) : 1.0;   // 有序對：抵掉重複計算
+    for (size_t i = 0; i < links.size(); ++i) links[i].betweenness = eb[i] / pairs;
+  }
+};
+
+#endif // HYBRID_TOPO_METRICS_HPP
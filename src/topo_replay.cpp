@@ -0,0 +1,108 @@
+// g++ -O2 -std=c++17 -I. topo_replay.cpp topo_journal.cpp -o topo_replay
+// 用法：./topo_replay hybrid_of.journal                  摘要：事件數、時間範圍、最後的鏈路
+//       ./topo_replay hybrid_of.journal --events         逐筆列出
+//       ./topo_replay hybrid_of.journal --at 1760000000.5  該時刻（Unix 秒）TE 看到的鏈路
+//       ./topo_replay hybrid_of.journal --convergence    埠 / switch 斷線 → 鏈路移除的延遲
+#include "topo_journal.hpp"
+#include "topo_graph.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using Kind = TopoJournalRecord::Kind;
+
+static std::string ts(int64_t ns) {
+  char b[32];
+  std::snprintf(b, sizeof(b), "%.3f", double(ns) / 1e9);
+  return b;
+}
+
+static void print_record(const TopoJournalRecord& r) {
+  std::cout << ts(r.t_ns) << "  " << journal_kind_name(r.kind);
+  switch (r.kind) {
+    case Kind::SwitchUp: case Kind::SwitchDown:
+      std::cout << " sw " << r.u;
+      break;
+    case Kind::PortDown:
+      std::cout << " sw " << r.u << " port " << r.u_port << (r.cause ? " (probe loss)" : " (port status)");
+      break;
+    case Kind::Start:
+      break;
+    default:
+      std::cout << " " << r.u << ":" << r.u_port << " -- " << r.v << ":" << r.v_port;
+      if (r.kind == Kind::EdgeMoved) std::cout << " (was " << r.old_u_port << " / " << r.old_v_port << ")";
+  }
+  if (r.epoch) std::cout << "  epoch " << r.epoch;
+  std::cout << "\n";
+}
+
+static void print_edges(const std::vector<TopoViewer::Edge>& edges) {
+  for (const auto& e : edges) std::cout << "  " << e.u << ":" << e.u_port << " -- " << e.v << ":" << e.v_port << "\n";
+}
+
+// 觸發（PortDown / SwitchDown）之後，第一筆碰到該埠 / 該 switch 的 EdgeDown 算收斂
+// （node id == swid，與 TopoViewer 預設的對應相同）
+static void convergence(const TopoJournalReader& j) {
+  std::vector<double> lat;
+  for (size_t i = 0; i < j.size(); ++i) {
+    const auto& t = j[i];
+    if (t.kind != Kind::PortDown && t.kind != Kind::SwitchDown) continue;
+    print_record(t);
+    bool found = false;
+    for (size_t k = i + 1; k < j.size() && !found; ++k) {
+      const auto& r = j[k];
+      if (r.kind == Kind::Start) break;
+      if (r.kind != Kind::EdgeDown && r.kind != Kind::Suppressed) continue;
+      const bool hit = t.kind == Kind::SwitchDown
+                     ? (r.u == t.u || r.v == t.u)
+                     : ((r.u == t.u && r.u_port == t.u_port) || (r.v == t.u && r.v_port == t.u_port));
+      if (!hit) continue;
+      found = true;
+      const double ms = double(r.t_ns - t.t_ns) / 1e6;
+      lat.push_back(ms);
+      std::cout << "    -> " << journal_kind_name(r.kind) << " after " << ms << " ms\n";
+    }
+    if (!found) std::cout << "    -> no edge removed (already gone or never seen)\n";
+  }
+  if (lat.empty()) return;
+  std::sort(lat.begin(), lat.end());
+  std::cout << "converged " << lat.size() << ": p50 " << lat[lat.size() / 2] << " ms, max " << lat.back() << " ms\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <journal> [--events | --at <unix seconds> | --convergence]\n";
+    return 2;
+  }
+  auto j = TopoJournalReader::open(argv[1]);
+  if (!j) return 1;
+  const std::string mode = argc > 2 ? argv[2] : "";
+
+  if (mode == "--events") {
+    for (size_t i = 0; i < j->size(); ++i) print_record((*j)[i]);
+  } else if (mode == "--at" && argc > 3) {
+    const int64_t t = int64_t(std::atof(argv[3]) * 1e9);
+    const auto g = j->graph_at(t);
+    std::cout << "at " << ts(t) << ": " << j->count_until(t) << " records, epoch " << g->epoch << ", "
+              << g->node_count() << " nodes, " << g->edge_count() << " links\n";
+    print_edges(g->edges);
+  } else if (mode == "--convergence") {
+    convergence(*j);
+  } else {
+    std::map<std::string, size_t> by_kind;
+    for (size_t i = 0; i < j->size(); ++i) ++by_kind[journal_kind_name((*j)[i].kind)];
+    std::cout << argv[1] << ": " << j->size() << " records";
+    if (j->size()) std::cout << ", " << ts((*j)[0].t_ns) << " .. " << ts((*j)[j->size() - 1].t_ns);
+    std::cout << "\n";
+    for (const auto& kv : by_kind) std::cout << "  " << kv.first << " " << kv.second << "\n";
+    const auto last = j->edges_after(j->size());
+    std::cout << "links at end: " << last.size() << "\n";
+    print_edges(last);
+  }
+  return 0;
+}
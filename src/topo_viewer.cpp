@@ -1,10 +1,27 @@
 #include "topo_viewer.hpp"
+#include "topo_graph.hpp"
+#include "topo_journal.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
+namespace {
+using JKind = TopoJournalRecord::Kind;
+// Edge records: canonical (u, v, u_port, v_port); switch / port records: u = swid, u_port = port
+void journal(TopoJournal* j, JKind kind, int u, int v, int u_port, int v_port, uint64_t epoch = 0,
+             int old_u_port = 0, int old_v_port = 0, uint8_t cause = 0) {
+  if (!j) return;
+  TopoJournalRecord r;
+  r.epoch = epoch; r.kind = kind; r.cause = cause;
+  r.u = u; r.v = v; r.u_port = u_port; r.v_port = v_port;
+  r.old_u_port = old_u_port; r.old_v_port = old_v_port;
+  j->append(r);
+}
+} // namespace
+
 TopoViewer::TopoViewer(OFController* ctl,
                        std::function<int(int)> swid_to_node,
                        std::chrono::milliseconds lldp_period,
@@ -12,29 +29,38 @@ TopoViewer::TopoViewer(OFController* ctl,
   : ctl_(ctl),
     swid_to_node_(std::move(swid_to_node)),
     lldp_period_(lldp_period),
-    expiry_(expiry) {
+    expiry_(expiry),
+    wheel_tick_(std::max(lldp_period, std::chrono::milliseconds(1))),
+    wheel_epoch_(Clock::now()),
+    // One rotation covers a full expiry interval, so a fresh deadline is never clamped
+    wheel_(size_t(std::chrono::duration_cast<std::chrono::milliseconds>(expiry) / wheel_tick_) + 2) {
+  graph_ = TopoGraph::build(0, {});
   if (!swid_to_node_) {
     // Default to identity mapping: node_id == swid
     swid_to_node_ = [](int sw){ return sw; };
   }
-  // Subscribe to controller LLDP events
+  // Subscribe to controller LLDP / switch events
   ctl_->on_lldp([this](const LLDPEvent& e){ this->handle_lldp(e); });
+  ctl_->on_switch_state([this](int swid, bool up){ this->handle_switch_state(swid, up); });
+  ctl_->on_link_down([this](const LinkDownEvent& e){ this->handle_link_down(e); });
 }
 
 TopoViewer::~TopoViewer() { stop(); }
 
 void TopoViewer::start() {
   if (running_.exchange(true)) return;
-  // Align controller's LLDP period to our setting
+  // The controller owns the LLDP schedule; align its period to our setting.
+  // Stable links back off to a third of the expiry, so a link is re-probed
+  // at least three times before its edge would expire.
   ctl_->set_lldp_period(lldp_period_);
+  ctl_->set_lldp_backoff(std::chrono::duration_cast<std::chrono::milliseconds>(expiry_) / 3);
 
   bg_ = std::thread([this](){
     auto next = Clock::now();
     while (running_.load()) {
       auto now = Clock::now();
       if (now >= next) {
-        tick_send_lldp();  // 1) broadcast LLDP
-        prune_expired();   // 2) prune expired edges
+        prune_expired();
         next = now + lldp_period_;
       }
       std::this_thread::sleep_for(std::chrono::milliseconds(50));
@@ -48,22 +74,84 @@ void TopoViewer::stop() {
 }
 
 void TopoViewer::tick_send_lldp() {
-  auto swids = ctl_->switch_ids();
-  for (int sw : swids) {
-    auto ports = ctl_->ports_of(sw);
-    for (int p : ports) {
-      ctl_->send_lldp(sw, p); // controller constructs LLDP frames internally.
-    }
+  ctl_->send_lldp_round(); // controller batches each switch's probes
+}
+
+void TopoViewer::handle_switch_state(int swid, bool up) {
+  journal(journal_.get(), up ? JKind::SwitchUp : JKind::SwitchDown, swid, 0, 0, 0);
+  if (up) {
+    // Discover the new switch's links now instead of waiting for the next tick
+    if (running_.load()) ctl_->send_lldp_round(swid);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const int n = swid_to_node_(swid);
+    std::vector<EdgeKey> dead;
+    for (const auto& kv : edges_)
+      if (kv.first.u == n || kv.first.v == n) dead.push_back(kv.first);
+    std::sort(dead.begin(), dead.end());
+    const auto now = Clock::now();
+    for (const auto& k : dead) { penalize_locked_(k, now); erase_edge_locked_(k); }
   }
+  notify_();
+}
+
+// The peer's PORT_STATUS (or the probe loss on the other side) usually
+// follows; by then the edge is gone and it is a no-op.
+void TopoViewer::handle_link_down(const LinkDownEvent& e) {
+  journal(journal_.get(), JKind::PortDown, e.swid, 0, e.port, 0, 0, 0, 0, uint8_t(e.cause));
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    const uint64_t pk = port_key_(swid_to_node_(e.swid), e.port);
+    if (e.seq) down_seq_[pk] = std::max(down_seq_[pk], e.seq);
+    auto p = port_edge_.find(pk);
+    if (p == port_edge_.end()) return;
+    const EdgeKey k = p->second;
+    const uint64_t before = epoch_.load();
+    penalize_locked_(k, Clock::now());
+    erase_edge_locked_(k);
+    if (epoch_.load() == before) return;   // was suppressed: TE never saw it
+    urgent_epoch_.store(epoch_.load());
+    std::cerr << "[topo] link down " << k.u << ":" << k.u_port << " -- " << k.v << ":" << k.v_port
+              << (e.cause == LinkDownEvent::Cause::PortStatus ? " (port status)" : " (probe loss)") << "\n";
+  }
+  notify_();
 }
 
 void TopoViewer::prune_expired() {
   const auto now = Clock::now();
-  std::lock_guard<std::mutex> lk(mtx_);
-  for (auto it = edges_.begin(); it != edges_.end(); ) {
-    if (now - it->second > expiry_) it = edges_.erase(it);
-    else ++it;
-  }
+  std::unique_lock<std::mutex> lk(mtx_);
+  const uint64_t before = epoch_.load();
+  wheel_.advance(tick_of_(now), [&](const EdgeKey& k, int64_t t) {
+    auto it = edges_.find(k);
+    // Gone (switch down) or re-added since: that copy is scheduled elsewhere
+    if (it == edges_.end() || !wheel_.reached(it->second.wheel_tick, t)) return;
+    if (now - it->second.last_seen > expiry_) { penalize_locked_(k, now); erase_edge_locked_(k); }
+    else schedule_locked_(k, it->second);
+  });
+  reuse_locked_(now);
+  const bool changed = epoch_.load() != before;
+  lk.unlock();
+  if (changed) notify_();
+}
+
+int64_t TopoViewer::tick_of_(Clock::time_point t) const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(t - wheel_epoch_) / wheel_tick_;
+}
+
+// First tick after the deadline (see ExpiryWheel::schedule for the clamping)
+void TopoViewer::schedule_locked_(const EdgeKey& k, EdgeState& st) {
+  st.wheel_tick = wheel_.schedule(k, tick_of_(st.last_seen + expiry_) + 1);
+}
+
+std::vector<TopoViewer::EdgeKey> TopoViewer::sorted_keys_locked_(bool visible_only) const {
+  std::vector<EdgeKey> keys;
+  keys.reserve(edges_.size());
+  for (const auto& kv : edges_)
+    if (kv.second.visible || !visible_only) keys.push_back(kv.first);
+  std::sort(keys.begin(), keys.end());
+  return keys;
 }
 
 void TopoViewer::handle_lldp(const LLDPEvent& e) {
@@ -74,57 +162,291 @@ void TopoViewer::handle_lldp(const LLDPEvent& e) {
 
   // Canonicalize (u < v); swap corresponding ports if needed
   EdgeKey k{};
+  int u_sw = e.src_swid, v_sw = e.dst_swid;
   if (nu < nv) {
     k = EdgeKey{nu, nv, e.src_port, e.dst_port};
   } else {
     k = EdgeKey{nv, nu, e.dst_port, e.src_port};
+    std::swap(u_sw, v_sw);
   }
 
+  bool fresh = false;
   {
     std::lock_guard<std::mutex> lk(mtx_);
-    edges_[k] = Clock::now();
+    // LinkDown is delivered ahead of queued LLDP: a frame received before the
+    // port went down must not bring the dead edge back
+    if (e.seq) {
+      for (const uint64_t pk : {port_key_(k.u, k.u_port), port_key_(k.v, k.v_port)}) {
+        auto d = down_seq_.find(pk);
+        if (d != down_seq_.end() && d->second > e.seq) return;
+      }
+    }
+    const auto now = Clock::now();
+    auto it = edges_.find(k);
+    if (it != edges_.end()) it->second.last_seen = now;   // refresh: O(1), the wheel catches up lazily
+    else { add_edge_locked_(k, u_sw, v_sw, now); fresh = true; }
   }
+  if (fresh) notify_();
 
   // Optional debug:
   // std::cerr << "[topo] LLDP: " << nu << ":" << e.src_port
   //           << " -- " << nv << ":" << e.dst_port << "\n";
 }
 
-std::vector<TopoViewer::Edge> TopoViewer::snapshot_edges() const {
+std::vector<TopoViewer::Edge> TopoViewer::snapshot_edges(uint64_t* epoch) const {
   std::vector<Edge> out;
   std::lock_guard<std::mutex> lk(mtx_);
-  out.reserve(edges_.size());
-  for (const auto& kv : edges_) {
-    const auto& k = kv.first;
-    out.push_back(Edge{k.u, k.v, k.u_port, k.v_port, kv.second});
-  }
+  if (epoch) *epoch = epoch_.load();
+  // Sorted like the old std::map, so path enumeration downstream stays deterministic
+  const auto keys = sorted_keys_locked_();
+  out.reserve(keys.size());
+  for (const auto& k : keys) out.push_back(Edge{k.u, k.v, k.u_port, k.v_port, edges_.at(k).last_seen});
   return out;
 }
 
+// A new edge that takes over a port its node pair already used on another
+// port is a re-cabling: the old edge is replaced and one PortChanged recorded.
+// Edges towards other nodes are left to expire (a shared segment can
+// legitimately show several neighbours behind one port).
+void TopoViewer::add_edge_locked_(const EdgeKey& k, int u_sw, int v_sw, Clock::time_point now) {
+  std::optional<EdgeKey> old;
+  for (const uint64_t pk : {port_key_(k.u, k.u_port), port_key_(k.v, k.v_port)}) {
+    auto p = port_edge_.find(pk);
+    if (p != port_edge_.end() && p->second.u == k.u && p->second.v == k.v && edges_.count(p->second)) {
+      old = p->second;
+      break;
+    }
+  }
+  const bool old_visible = old && edges_.at(*old).visible;
+  if (old) erase_edge_locked_(*old, EdgeDelta::Kind::PortChanged);
+
+  auto& st = edges_[k];
+  st.last_seen = now;
+  st.u_sw = u_sw;
+  st.v_sw = v_sw;
+  st.visible = !suppressed_locked_(k, now);
+  schedule_locked_(k, st);
+  port_edge_[port_key_(k.u, k.u_port)] = k;
+  port_edge_[port_key_(k.v, k.v_port)] = k;
+
+  // Deltas describe the TE view: a dampened edge coming or going is silent
+  EdgeDelta d;
+  if (st.visible) {
+    d.edge = Edge{k.u, k.v, k.u_port, k.v_port, now};
+    if (old_visible) {
+      d.kind = EdgeDelta::Kind::PortChanged;
+      d.old_u_port = old->u_port;
+      d.old_v_port = old->v_port;
+    }
+  } else if (old_visible) {
+    d.kind = EdgeDelta::Kind::Removed;
+    d.edge = Edge{old->u, old->v, old->u_port, old->v_port, now};
+  } else {
+    return;
+  }
+  record_locked_(d);
+}
+
+// kind == PortChanged: the replacement's add records the single delta
+void TopoViewer::erase_edge_locked_(const EdgeKey& k, EdgeDelta::Kind kind) {
+  auto it = edges_.find(k);
+  if (it == edges_.end()) return;
+  const auto last_seen = it->second.last_seen;
+  const bool visible = it->second.visible;
+  edges_.erase(it);   // its wheel entry is skipped when the slot fires
+  for (const uint64_t pk : {port_key_(k.u, k.u_port), port_key_(k.v, k.v_port)}) {
+    auto p = port_edge_.find(pk);
+    if (p != port_edge_.end() && p->second == k) port_edge_.erase(p);
+  }
+  if (kind != EdgeDelta::Kind::Removed || !visible) return;
+  EdgeDelta d;
+  d.kind = kind;
+  d.edge = Edge{k.u, k.v, k.u_port, k.v_port, last_seen};
+  record_locked_(d);
+}
+
+double TopoViewer::decayed_(const Damp& d, Clock::time_point now) const {
+  const double dt = std::chrono::duration<double>(now - d.at).count();
+  const double hl = std::max<double>(1.0, double(damp_cfg_.half_life.count()));
+  return d.penalty * std::exp2(-std::max(0.0, dt) / hl);
+}
+
+// Only losing an edge the TE view could see counts as a flap
+void TopoViewer::penalize_locked_(const EdgeKey& k, Clock::time_point now) {
+  if (!damp_cfg_.enabled) return;
+  auto it = edges_.find(k);
+  if (it == edges_.end() || !it->second.visible) return;
+  auto& d = damp_[k];
+  d.penalty = std::min(decayed_(d, now) + damp_cfg_.penalty, damp_cfg_.max_penalty);
+  d.at = now;
+  if (!d.suppressed && d.penalty >= damp_cfg_.suppress) {
+    d.suppressed = true;
+    std::cerr << "[topo] dampening flapping link " << k.u << ":" << k.u_port << " -- "
+              << k.v << ":" << k.v_port << " (penalty " << int(d.penalty) << ")\n";
+    journal(journal_.get(), JKind::Suppressed, k.u, k.v, k.u_port, k.v_port);
+  }
+}
+
+bool TopoViewer::suppressed_locked_(const EdgeKey& k, Clock::time_point now) {
+  auto it = damp_.find(k);
+  if (it == damp_.end() || !it->second.suppressed) return false;
+  if (damp_cfg_.enabled && decayed_(it->second, now) >= damp_cfg_.reuse) return true;
+  it->second.suppressed = false;   // decayed since the last prune
+  return false;
+}
+
+// Runs with every prune; damp_ only holds links that flapped recently
+void TopoViewer::reuse_locked_(Clock::time_point now) {
+  for (auto it = damp_.begin(); it != damp_.end(); ) {
+    const double p = decayed_(it->second, now);
+    if (it->second.suppressed && (!damp_cfg_.enabled || p < damp_cfg_.reuse)) {
+      it->second.suppressed = false;
+      const auto& k = it->first;
+      auto e = edges_.find(k);
+      std::cerr << "[topo] link " << k.u << ":" << k.u_port << " -- " << k.v << ":" << k.v_port
+                << " stable again" << (e == edges_.end() ? " (not seen)" : "") << "\n";
+      journal(journal_.get(), JKind::Reused, k.u, k.v, k.u_port, k.v_port);
+      if (e != edges_.end() && !e->second.visible) {
+        e->second.visible = true;
+        EdgeDelta d;
+        d.edge = Edge{k.u, k.v, k.u_port, k.v_port, e->second.last_seen};
+        record_locked_(d);
+      }
+    }
+    if (!it->second.suppressed && p < 1.0) it = damp_.erase(it);
+    else ++it;
+  }
+}
+
+void TopoViewer::set_dampening(const Dampening& d) {
+  std::lock_guard<std::mutex> lk(mtx_);
+  damp_cfg_ = d;   // turning it off releases suppressed edges on the next prune
+}
+
+size_t TopoViewer::suppressed_count() const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  return size_t(std::count_if(edges_.begin(), edges_.end(), [](const auto& kv){ return !kv.second.visible; }));
+}
+
+void TopoViewer::record_locked_(EdgeDelta d) {
+  d.epoch = epoch_.load() + 1;
+  log_.push_back(d);
+  if (log_.size() > kDeltaLog) log_.pop_front();
+  epoch_.store(d.epoch);
+  const auto& e = d.edge;
+  switch (d.kind) {
+    case EdgeDelta::Kind::Added:       journal(journal_.get(), JKind::EdgeUp,   e.u, e.v, e.u_port, e.v_port, d.epoch); break;
+    case EdgeDelta::Kind::Removed:     journal(journal_.get(), JKind::EdgeDown, e.u, e.v, e.u_port, e.v_port, d.epoch); break;
+    case EdgeDelta::Kind::PortChanged: journal(journal_.get(), JKind::EdgeMoved, e.u, e.v, e.u_port, e.v_port, d.epoch,
+                                               d.old_u_port, d.old_v_port); break;
+  }
+}
+
+bool TopoViewer::open_journal(const std::string& path) {
+  auto j = TopoJournal::open(path);
+  if (!j) return false;
+  std::cerr << "[topo] journal " << path << " (" << j->size() << " records)\n";
+  std::lock_guard<std::mutex> lk(mtx_);
+  journal_ = std::move(j);
+  journal(journal_.get(), JKind::Start, 0, 0, 0, 0, epoch_.load());
+  return true;
+}
+
+bool TopoViewer::deltas_since(uint64_t since, uint64_t until, std::vector<EdgeDelta>& out) const {
+  std::lock_guard<std::mutex> lk(mtx_);
+  if (since >= until) return true;
+  // log_ holds consecutive epochs ending at epoch_
+  if (log_.empty() || log_.front().epoch > since + 1 || until > epoch_.load()) return false;
+  const size_t first = size_t(since + 1 - log_.front().epoch);
+  for (size_t i = first; i < log_.size() && log_[i].epoch <= until; ++i) out.push_back(log_[i]);
+  return true;
+}
+
+int TopoViewer::subscribe(OnTopoChange cb) {
+  std::lock_guard<std::mutex> lk(sub_mtx_);
+  if (subs_.empty()) notified_ = epoch_.load();   // nothing older is owed to anyone
+  subs_[next_sub_] = std::move(cb);
+  return next_sub_++;
+}
+
+void TopoViewer::unsubscribe(int id) {
+  std::lock_guard<std::mutex> lk(sub_mtx_);
+  subs_.erase(id);
+}
+
+// Delivery is serialised by sub_mtx_ (taken before mtx_, never under it), so
+// concurrent writers (LLDP events, pruning) still reach subscribers in order.
+void TopoViewer::notify_() {
+  std::lock_guard<std::mutex> lk(sub_mtx_);
+  publish_graph_();
+  if (subs_.empty()) { notified_ = epoch_.load(); return; }
+  TopoChange c;
+  c.epoch = epoch_.load();
+  if (c.epoch == notified_) return;
+  c.resync = !deltas_since(notified_, c.epoch, c.deltas);
+  // Whoever delivers it: a concurrent LLDP or prune may get here first
+  c.urgent = urgent_epoch_.load() > notified_;
+  notified_ = c.epoch;
+  for (const auto& kv : subs_) kv.second(c);
+}
+
+std::shared_ptr<const TopoGraph> TopoViewer::graph() const {
+  return std::atomic_load(&graph_);
+}
+
+// Built from the current state, so a publish that lost the race to a newer
+// change still installs the newest graph; sub_mtx_ keeps swaps in order.
+void TopoViewer::publish_graph_() {
+  std::vector<Edge> edges;
+  std::vector<std::pair<int,int>> sw;
+  uint64_t ep = 0;
+  {
+    std::lock_guard<std::mutex> lk(mtx_);
+    ep = epoch_.load();
+    if (ep == std::atomic_load(&graph_)->epoch) return;
+    const auto keys = sorted_keys_locked_();
+    edges.reserve(keys.size());
+    sw.reserve(keys.size());
+    for (const auto& k : keys) {
+      const auto& st = edges_.at(k);
+      edges.push_back(Edge{k.u, k.v, k.u_port, k.v_port, st.last_seen});
+      sw.push_back({st.u_sw, st.v_sw});
+    }
+  }
+  // Port speeds come from the controller: query outside our lock
+  std::vector<TopoGraph::Speed> speeds(edges.size());
+  for (size_t i = 0; i < edges.size(); ++i) {
+    speeds[i].u_mbps = ctl_->port_speed_mbps(sw[i].first,  edges[i].u_port);
+    speeds[i].v_mbps = ctl_->port_speed_mbps(sw[i].second, edges[i].v_port);
+  }
+  std::atomic_store(&graph_, TopoGraph::build(ep, std::move(edges), std::move(speeds)));
+}
+
 std::string TopoViewer::export_dot() const {
   std::ostringstream os;
   os << "graph SDN {\n";
   os << "  graph [overlap=false, splines=true];\n";
   os << "  node  [shape=circle, fontsize=10];\n";
-  // Nodes (collect from edges)
-  std::set<int> nodes;
+  std::vector<EdgeKey> keys;
+  std::set<EdgeKey> hidden;
   {
     std::lock_guard<std::mutex> lk(mtx_);
-    for (const auto& kv : edges_) {
-      nodes.insert(kv.first.u);
-      nodes.insert(kv.first.v);
-    }
+    keys = sorted_keys_locked_(/*visible_only=*/false);
+    for (const auto& k : keys) if (!edges_.at(k).visible) hidden.insert(k);
+  }
+  // Nodes (collect from edges)
+  std::set<int> nodes;
+  for (const auto& e : keys) {
+    nodes.insert(e.u);
+    nodes.insert(e.v);
   }
   for (int n : nodes) os << "  " << n << ";\n";
 
   // Edges with port labels
-  {
-    std::lock_guard<std::mutex> lk(mtx_);
-    for (const auto& kv : edges_) {
-      const auto& e = kv.first;
-      os << "  " << e.u << " -- " << e.v
-         << " [label=\"(" << e.u_port << "," << e.v_port << ")\"];\n";
-    }
+  for (const auto& e : keys) {
+    os << "  " << e.u << " -- " << e.v
+       << " [label=\"(" << e.u_port << "," << e.v_port << ")\""
+       << (hidden.count(e) ? ", style=dashed" : "") << "];\n";
   }
   os << "}\n";
   return os.str();
@@ -3,19 +3,26 @@
 #define HYBRID_TOPO_VIEWER_HPP
 
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <set>
 #include <string>
 #include <thread>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include<atomic>
+#include "expiry_wheel.hpp"
 #include "of_controller.hpp"
 
+struct TopoGraph;     // topo_graph.hpp
+class TopoJournal;    // topo_journal.hpp
+
 class TopoViewer {
 public:
   using Clock = std::chrono::steady_clock;
@@ -27,14 +34,16 @@ public:
                       std::chrono::seconds expiry = std::chrono::seconds(10));
   ~TopoViewer();
 
-  // Start/stop background thread that sends periodic LLDP and prunes expired edges.
+  // Start/stop the background thread that prunes expired edges. The periodic
+  // LLDP round itself runs in the controller's reactor (set_lldp_period).
   void start();
   void stop();
 
-  // Send one round of LLDP on all known switches/ports.
+  // Send one extra round of LLDP on all known switches/ports now.
   void tick_send_lldp();
 
-  // Remove edges whose last_seen is older than 'expiry_'.
+  // Remove edges whose last_seen is older than 'expiry_'. Only the edges whose
+  // deadline falls in the elapsed wheel slots are examined.
   void prune_expired();
 
   // Edge snapshot item
@@ -43,9 +52,66 @@ public:
     int u_port, v_port;  // port numbers on each side
     Clock::time_point last_seen;
   };
-  std::vector<Edge> snapshot_edges() const;
+  // 'epoch' (optional) receives the epoch the snapshot corresponds to.
+  std::vector<Edge> snapshot_edges(uint64_t* epoch = nullptr) const;
+  // Immutable CSR snapshot of the latest published epoch (never null). A new
+  // one is swapped in after every structural change; holding the pointer
+  // keeps that version alive, so readers need neither copies nor locks.
+  std::shared_ptr<const TopoGraph> graph() const;
+
+  // ---- Versioning / change deltas ----
+  // Every structural change bumps the epoch by one: an edge added, removed
+  // (expiry, link down or switch down) or re-cabled to another port between the same
+  // two nodes. Refreshing an edge does not, so an unchanged epoch means the
+  // topology is exactly what the consumer saw last time.
+  struct EdgeDelta {
+    enum class Kind { Added, Removed, PortChanged };
+    Kind kind{Kind::Added};
+    uint64_t epoch{0};                  // epoch right after this change
+    Edge edge{};                        // PortChanged: with the new ports
+    int old_u_port{0}, old_v_port{0};   // PortChanged only
+  };
+  struct TopoChange {
+    uint64_t epoch{0};
+    bool resync{false};                 // deltas were dropped: re-read snapshot_edges()
+    bool urgent{false};                 // includes a link reported down: reroute now
+    std::vector<EdgeDelta> deltas;
+  };
+  using OnTopoChange = std::function<void(const TopoChange&)>;
+
+  uint64_t epoch() const { return epoch_.load(); }
+  // Changes in (since, until] in order; false if the log no longer reaches
+  // back to 'since' (the caller then starts over from a snapshot).
+  bool deltas_since(uint64_t since, uint64_t until, std::vector<EdgeDelta>& out) const;
+  // Callbacks run in epoch order on the thread that made the change, outside
+  // the topology lock (they may read snapshots), but must not (un)subscribe.
+  int  subscribe(OnTopoChange cb);
+  void unsubscribe(int id);
+
+  // ---- Event journal ----
+  // Append every change delta plus its trigger (switch up/down, port down,
+  // dampening) to a memory-mapped journal for offline replay; see
+  // topo_journal.hpp. Call before start(); false if the file can't be used.
+  bool open_journal(const std::string& path);
+
+  // ---- Flap dampening ----
+  // BGP-style: every time a visible edge is lost (expiry or switch down) its
+  // penalty grows by 'penalty'; the penalty halves every 'half_life'. At
+  // 'suppress' the edge is hidden from the TE view (snapshot_edges, graph,
+  // deltas) even while LLDP still sees it; it reappears once the penalty has
+  // decayed below 'reuse'. 'max_penalty' bounds how long that can take.
+  struct Dampening {
+    bool   enabled{true};
+    double penalty{1000.0};
+    double suppress{2000.0};
+    double reuse{750.0};
+    double max_penalty{8000.0};
+    std::chrono::seconds half_life{15};
+  };
+  void set_dampening(const Dampening& d);
+  size_t suppressed_count() const;   // suppressed edges LLDP currently sees
 
-  // Export current topology to Graphviz DOT string.
+  // Export current topology to Graphviz DOT string (suppressed edges dashed).
   std::string export_dot() const;
 
   // Change mapping from swid -> node id
@@ -54,6 +120,10 @@ public:
 private:
   // Controller will call this via on_lldp() when an LLDP frame is observed.
   void handle_lldp(const LLDPEvent& e);
+  // on_switch_state(): probe a new switch right away / drop a dead switch's edges.
+  void handle_switch_state(int swid, bool up);
+  // on_link_down(): PORT_STATUS or probe loss, drop the edge without waiting for expiry.
+  void handle_link_down(const LinkDownEvent& e);
 
   // Canonical edge key (undirected, sorted by node ID)
   struct EdgeKey {
@@ -62,7 +132,51 @@ private:
     bool operator<(const EdgeKey& o) const {
       return std::tie(u,v,u_port,v_port) < std::tie(o.u,o.v,o.u_port,o.v_port);
     }
+    bool operator==(const EdgeKey& o) const {
+      return u == o.u && v == o.v && u_port == o.u_port && v_port == o.v_port;
+    }
   };
+  struct EdgeKeyHash {
+    size_t operator()(const EdgeKey& k) const {
+      uint64_t h = (uint64_t(uint32_t(k.u)) << 32) ^ uint32_t(k.v);
+      h ^= ((uint64_t(uint32_t(k.u_port)) << 32) ^ uint32_t(k.v_port)) * 0x9e3779b97f4a7c15ULL;
+      return size_t(h ^ (h >> 29));
+    }
+  };
+  struct EdgeState {
+    Clock::time_point last_seen;
+    int64_t wheel_tick{0};   // wheel tick whose slot holds this edge
+    int u_sw{0}, v_sw{0};    // switch ids of each end (port speeds for graph_)
+    bool visible{true};      // false while dampened: hidden from the TE view
+  };
+  // Outlives the edge itself: a flapping link is gone half of the time
+  struct Damp {
+    double penalty{0.0};     // as of 'at'
+    Clock::time_point at{};
+    bool suppressed{false};
+  };
+
+  // Timer wheel over expiry deadlines (one tick per LLDP period).
+  // Refreshing an edge only updates last_seen; when its slot comes due, an
+  // edge refreshed in the meantime is moved to its new deadline slot, the
+  // rest are erased. Caller holds mtx_.
+  int64_t tick_of_(Clock::time_point t) const;
+  void schedule_locked_(const EdgeKey& k, EdgeState& st);
+  std::vector<EdgeKey> sorted_keys_locked_(bool visible_only = true) const;
+
+  double decayed_(const Damp& d, Clock::time_point now) const;
+  void penalize_locked_(const EdgeKey& k, Clock::time_point now);
+  bool suppressed_locked_(const EdgeKey& k, Clock::time_point now);
+  void reuse_locked_(Clock::time_point now);   // un-suppress decayed edges
+
+  // Structural changes: keep the port index and the delta log in step with
+  // edges_ (caller holds mtx_); notify_() delivers new deltas to subscribers.
+  static uint64_t port_key_(int node, int port) { return (uint64_t(uint32_t(node)) << 32) | uint32_t(port); }
+  void add_edge_locked_(const EdgeKey& k, int u_sw, int v_sw, Clock::time_point now);
+  void erase_edge_locked_(const EdgeKey& k, EdgeDelta::Kind kind = EdgeDelta::Kind::Removed);
+  void record_locked_(EdgeDelta d);
+  void notify_();
+  void publish_graph_();   // under sub_mtx_
 
   OFController* ctl_;
   std::function<int(int)> swid_to_node_;
@@ -70,7 +184,28 @@ private:
   std::chrono::seconds expiry_;
 
   mutable std::mutex mtx_;
-  std::map<EdgeKey, Clock::time_point> edges_; // last_seen timestamp
+  std::unordered_map<EdgeKey, EdgeState, EdgeKeyHash> edges_;
+  std::chrono::milliseconds wheel_tick_;
+  Clock::time_point wheel_epoch_;
+  ExpiryWheel<EdgeKey> wheel_;
+  std::unordered_map<uint64_t, EdgeKey> port_edge_;   // (node, port) -> edge using it
+  std::unordered_map<uint64_t, uint64_t> down_seq_;   // (node, port) -> seq of its last LinkDown
+  Dampening damp_cfg_;
+  std::unordered_map<EdgeKey, Damp, EdgeKeyHash> damp_;
+
+  static constexpr size_t kDeltaLog = 4096;
+  std::atomic<uint64_t> epoch_{0};
+  std::deque<EdgeDelta> log_;                 // last kDeltaLog changes
+
+  std::shared_ptr<const TopoGraph> graph_;    // std::atomic_load / atomic_store only
+
+  std::mutex sub_mtx_;                        // serialises delivery; never taken under mtx_
+  std::map<int, OnTopoChange> subs_;
+  int next_sub_{1};
+  uint64_t notified_{0};
+  std::atomic<uint64_t> urgent_epoch_{0};     // last epoch that removed a link reported down
+
+  std::unique_ptr<TopoJournal> journal_;      // set before start(); appends are thread-safe
 
   std::atomic<bool> running_{false};
   std::thread bg_;
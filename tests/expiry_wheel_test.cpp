@@ -0,0 +1,121 @@
+// tests/expiry_wheel_test.cpp
+// ExpiryWheel driven the way TopoViewer::prune_expired uses it, with prune
+// calls at irregular intervals (late by a few ticks, or by several rotations).
+#include "expiry_wheel.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+// The owner side of the wheel: per key the authoritative tick and the deadline
+// (last_seen + expiry, in ticks), like EdgeState.
+struct Owner {
+  struct Entry { int64_t tick; int64_t deadline; };
+  ExpiryWheel<int> wheel;
+  std::map<int, Entry> live;
+  std::map<int, int64_t> expired_at;   // key -> 'now' of the prune that dropped it
+
+  explicit Owner(size_t slots) : wheel(slots) {}
+
+  void add(int k, int64_t deadline) {
+    live[k] = Entry{0, deadline};
+    live[k].tick = wheel.schedule(k, deadline + 1);
+  }
+  // LLDP refresh: only the deadline moves, like last_seen
+  void refresh(int k, int64_t deadline) { live.at(k).deadline = deadline; }
+
+  void prune(int64_t now) {
+    wheel.advance(now, [&](int k, int64_t t) {
+      auto it = live.find(k);
+      if (it == live.end() || !wheel.reached(it->second.tick, t)) return;
+      if (now > it->second.deadline) { expired_at[k] = now; live.erase(it); }
+      else it->second.tick = wheel.schedule(k, it->second.deadline + 1);
+    });
+  }
+};
+
+// 100 ms ticks, 1 s expiry (12 slots). An edge discovered at tick 10 while
+// the last prune ran at tick 8 used to land more than a rotation ahead of the
+// wheel, in a slot visited at tick 9, and was dropped there for good.
+void lagging_prune() {
+  Owner o(12);
+  for (int64_t now = 1; now <= 8; ++now) o.prune(now);
+  o.add(1, 10 + 10);
+  for (int64_t now = 11; now <= 40; ++now) o.prune(now);
+  CHECK(o.expired_at.count(1) == 1);
+  CHECK(o.expired_at.count(1) && o.expired_at[1] == 21);
+}
+
+// A gap of several rotations must still expire every edge on that call
+void long_gap() {
+  Owner o(12);
+  for (int k = 0; k < 50; ++k) o.add(k, 3 + k % 9);
+  o.prune(2);
+  o.prune(2 + 5 * 12 + 7);
+  CHECK(o.live.empty());
+  CHECK(o.expired_at.size() == 50);
+}
+
+// Random additions, refreshes and prune gaps: every edge expires on the first
+// prune past its deadline, never earlier and never lost.
+void irregular() {
+  std::mt19937 rng(42);
+  for (int round = 0; round < 200; ++round) {
+    const size_t slots = 3 + rng() % 20;
+    const int64_t expiry = int64_t(slots) - 2;   // TopoViewer: expiry / tick + 2 slots
+    Owner o(slots);
+    std::map<int, int64_t> deadline;
+    int64_t now = 0, prev = 0;
+    for (int k = 0; k < 30; ++k) {
+      deadline[k] = int64_t(rng() % uint32_t(expiry + 1));
+      o.add(k, deadline[k]);
+    }
+    std::map<int, int64_t> prev_now;   // 'now' of the prune before the expiring one
+    int next_key = 30;
+    while (now < 2000 && !o.live.empty()) {
+      // mostly one tick, sometimes a few, now and then several rotations
+      const uint32_t r = rng() % 100;
+      const int64_t step = r < 70 ? 1 : r < 95 ? 2 + rng() % 4 : int64_t(rng() % (4 * slots));
+      now += step;
+      // LLDP seen at 'now' while the wheel is still at 'prev': refresh some
+      // live edges, discover a new one now and then
+      for (auto& kv : o.live)
+        if (now < 1000 && rng() % 4 == 0) {
+          deadline[kv.first] = now + expiry;
+          o.refresh(kv.first, deadline[kv.first]);
+        }
+      if (now < 1000 && rng() % 3 == 0) {
+        deadline[next_key] = now + expiry;
+        o.add(next_key, deadline[next_key]);
+        ++next_key;
+      }
+      for (const auto& kv : o.live) prev_now[kv.first] = prev;
+      o.prune(now);
+      prev = now;
+    }
+    CHECK(o.live.empty());
+    for (const auto& [k, at] : o.expired_at) {
+      CHECK(at > deadline[k]);          // not before the deadline
+      CHECK(prev_now[k] <= deadline[k]);   // on the first prune after it
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  lagging_prune();
+  long_gap();
+  irregular();
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("expiry_wheel_test: ok\n");
+  return failures ? 1 : 0;
+}
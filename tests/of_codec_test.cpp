@@ -0,0 +1,157 @@
+// tests/of_codec_test.cpp
+// of_codec.hpp: bounds of Bytes / View on short buffers, and the length and
+// xid patching of Out::close / close_len on flow_mod and group_mod layouts
+// built the way te_controller.cpp's encoders build them.
+#include "of_codec.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+using namespace of;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+// make<> is usable at compile time
+static_assert(make<ofp_header, OFPT_HELLO>(OFP13_VERSION, 7).length == to_be(uint16_t(8)), "make<> length");
+static_assert(make<ofp_header, OFPT_HELLO>(OFP13_VERSION, 7).xid == to_be(uint32_t(7)), "make<> xid");
+
+void bytes_bounds() {
+  const uint8_t raw[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+  const Bytes b(raw, sizeof(raw));
+
+  CHECK(Bytes().empty() && Bytes().u32(0) == 0);
+  CHECK(b.has(0, 7) && b.has(7, 0) && !b.has(0, 8) && !b.has(8, 0) && !b.has(6, 2));
+  CHECK(!b.has(1, size_t(-1)));                  // off + n would wrap
+  CHECK(b.u8(6) == 0x07 && b.u8(7) == 0);
+  CHECK(b.u16(5) == 0x0607 && b.u16(6) == 0);
+  CHECK(b.u32(3) == 0x04050607u && b.u32(4) == 0);
+  CHECK(b.u64(0) == 0);                           // 7 bytes: no u64
+  CHECK(b.sub(5).size() == 2 && b.sub(5, 10).size() == 2 && b.sub(7).empty() && b.sub(9).empty());
+  CHECK(b.sub(2, 3).u16(1) == 0x0405 && b.sub(2, 3).u16(2) == 0);
+
+  // a header needs 8 bytes
+  CHECK(!View<ofp_header>::at(b));
+  CHECK(!View<ofp_header>::at(Bytes(raw, 0)));
+  uint8_t msg[12] = {OFP13_VERSION, OFPT_ECHO_REQUEST, 0x00, 0x0c, 0, 0, 0, 9, 0xaa, 0xbb, 0xcc, 0xdd};
+  const Bytes m(msg, sizeof(msg));
+  CHECK(View<ofp_header>::at(m) && !View<ofp_header>::at(m, 5) && !View<ofp_header>::at(m, size_t(-1)));
+  const auto h = View<ofp_header>::at(m);
+  CHECK(h && h->get(&ofp_header::length) == 12 && h->get(&ofp_header::xid) == 9);
+  CHECK(h && h->tail().size() == 4 && h->tail().u32(0) == 0xaabbccddu);
+  CHECK(!View<ofp_echo_stamp>::at(m));            // 16 bytes wanted, 12 there
+
+  // for_each skips a trailing partial record
+  uint8_t stats[2 * sizeof(ofp13_port_stats) + 10] = {};
+  stats[3] = 1; stats[sizeof(ofp13_port_stats) + 3] = 2;
+  int n = 0, sum = 0;
+  for_each<ofp13_port_stats>(Bytes(stats, sizeof(stats)),
+                             [&](View<ofp13_port_stats> v){ ++n; sum += int(v.get(&ofp13_port_stats::port_no)); });
+  CHECK(n == 2 && sum == 3);
+}
+
+// OF1.3 flow_mod: empty OXM match, apply-actions(output:2), written after
+// unrelated bytes so close() must patch relative to the message start
+void flow_mod13() {
+  std::vector<uint8_t> b = {0xee, 0xee, 0xee};
+  auto fm = Out<ofp13_flow_mod>::message<OFPT_FLOW_MOD>(b, OFP13_VERSION);
+  fm.set(&ofp13_flow_mod::cookie,   0x7e00000000000001ULL)
+    .set(&ofp13_flow_mod::priority, 300)
+    .set(&ofp13_flow_mod::buffer_id, OFP_NO_BUFFER);
+  put16(b, OFPMT_OXM); put16(b, 4); put32(b, 0);   // ofp_match, padded to 8
+  auto ins = Out<ofp13_instruction_actions>::append(b);
+  ins.set(&ofp13_instruction_actions::type, OFPIT_APPLY_ACTIONS);
+  Out<ofp13_action_output>::append(b)
+    .set(&ofp13_action_output::type, OFPAT_OUTPUT)
+    .set(&ofp13_action_output::len,  sizeof(ofp13_action_output))
+    .set(&ofp13_action_output::port, 2u);
+  ins.close_len(&ofp13_instruction_actions::len);
+  fm.close(0x11223344);
+
+  const size_t total = sizeof(ofp13_flow_mod) + 8 + sizeof(ofp13_instruction_actions) + sizeof(ofp13_action_output);
+  CHECK(total == 80);
+  CHECK(b.size() == 3 + total && b[0] == 0xee && b[2] == 0xee);
+  const Bytes m(b.data() + 3, total);
+  const uint8_t hdr[8] = {OFP13_VERSION, OFPT_FLOW_MOD, 0x00, 0x50, 0x11, 0x22, 0x33, 0x44};
+  for (size_t i = 0; i < 8; ++i) CHECK(m.u8(i) == hdr[i]);
+  CHECK(m.u64(8) == 0x7e00000000000001ULL);
+  CHECK(m.u16(30) == 300);                          // priority
+  CHECK(m.u16(48) == OFPMT_OXM && m.u16(50) == 4);
+  CHECK(m.u16(56) == OFPIT_APPLY_ACTIONS && m.u16(58) == 24);   // 8 + one 16-byte output
+  CHECK(m.u16(64) == OFPAT_OUTPUT && m.u16(66) == 16 && m.u32(68) == 2);
+
+  const auto v = View<ofp13_flow_mod>::at(m);
+  CHECK(v && v->get(&ofp13_flow_mod::priority) == 300 && v->tail().size() == total - sizeof(ofp13_flow_mod));
+}
+
+// OF1.0 flow_mod with two outputs: fixed part 72 bytes + 2 × 8
+void flow_mod10() {
+  std::vector<uint8_t> b;
+  auto fm = Out<ofp_flow_mod>::message<OFPT_FLOW_MOD>(b, OFP_VERSION);
+  fm.set(&ofp_flow_mod::priority, 100).set(&ofp_flow_mod::out_port, OFPP_NONE);
+  for (uint16_t p : {uint16_t(1), uint16_t(3)})
+    Out<ofp_action_output>::append(b)
+      .set(&ofp_action_output::type, OFPAT_OUTPUT)
+      .set(&ofp_action_output::len,  sizeof(ofp_action_output))
+      .set(&ofp_action_output::port, p);
+  fm.close(5);
+  const Bytes m(b.data(), b.size());
+  CHECK(b.size() == 88);
+  CHECK(m.u8(0) == OFP_VERSION && m.u8(1) == OFPT_FLOW_MOD && m.u16(2) == 88 && m.u32(4) == 5);
+  CHECK(m.u16(72) == OFPAT_OUTPUT && m.u16(76) == 1 && m.u16(84) == 3);
+}
+
+// OF1.3 fast-failover group: buckets of one and two outputs
+void group_mod13() {
+  std::vector<uint8_t> b;
+  auto gm = Out<ofp13_group_mod>::message<OFPT13_GROUP_MOD>(b, OFP13_VERSION);
+  gm.set(&ofp13_group_mod::command,  0)
+    .set(&ofp13_group_mod::type,     3)
+    .set(&ofp13_group_mod::group_id, 0x10001u);
+  const std::vector<std::vector<uint32_t>> buckets = {{2}, {3, 4}};
+  for (const auto& outs : buckets) {
+    auto ob = Out<ofp13_bucket>::append(b);
+    ob.set(&ofp13_bucket::watch_port, outs[0]).set(&ofp13_bucket::watch_group, OFPG13_ANY);
+    for (uint32_t p : outs)
+      Out<ofp13_action_output>::append(b)
+        .set(&ofp13_action_output::type, OFPAT_OUTPUT)
+        .set(&ofp13_action_output::len,  sizeof(ofp13_action_output))
+        .set(&ofp13_action_output::port, p);
+    ob.close_len(&ofp13_bucket::len);
+  }
+  gm.close(0xabcdef01u);
+
+  const Bytes m(b.data(), b.size());
+  CHECK(b.size() == 16 + 32 + 48);
+  CHECK(m.u8(0) == OFP13_VERSION && m.u8(1) == OFPT13_GROUP_MOD && m.u16(2) == 96 && m.u32(4) == 0xabcdef01u);
+  CHECK(m.u16(8) == 0 && m.u8(10) == 3 && m.u32(12) == 0x10001u);
+  CHECK(m.u16(16) == 32 && m.u32(20) == 2 && m.u32(24) == OFPG13_ANY);   // bucket 1
+  CHECK(m.u16(48) == 48 && m.u32(52) == 3);                              // bucket 2
+  CHECK(m.u32(68) == 3 && m.u32(84) == 4);                               // its two output ports
+
+  // walk the buckets by their patched lengths, as a switch would
+  size_t off = sizeof(ofp13_group_mod), seen = 0;
+  while (auto bk = View<ofp13_bucket>::at(m, off)) {
+    const uint16_t len = bk->get(&ofp13_bucket::len);
+    if (len < sizeof(ofp13_bucket)) break;
+    off += len; ++seen;
+  }
+  CHECK(seen == 2 && off == m.size());
+}
+
+} // namespace
+
+int main() {
+  bytes_bounds();
+  flow_mod13();
+  flow_mod10();
+  group_mod13();
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("of_codec_test: ok\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// tests/state_snapshot_test.cpp
+// StateStore: encode/decode and save/load round trips, rejection of damaged
+// or foreign images, and save() skipping an unchanged state.
+#include "state_snapshot.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+StateSnapshot sample() {
+  StateSnapshot s;
+  WarmSwitchState a; a.dpid = 0x0000aabbccddeeffULL; a.swid = 3;
+  a.macs.push_back({{0x02, 0, 0, 0, 0, 0x01}, 1});
+  a.macs.push_back({{0x02, 0, 0, 0, 0, 0x02}, 4});
+  WarmSwitchState b; b.dpid = 7; b.swid = 1;
+  s.switches = {a, b};
+
+  Actuator::Installed ins;
+  ins.rules.push_back(Actuator::Rule{1, "ip,src=10.0.0.1,dst=10.0.0.3", "meter:65537,group:65537", 300});
+  ins.rules.push_back(Actuator::Rule{3, "in=2,ip,src=10.0.0.1,dst=10.0.0.3", "output:1", 310});
+  Actuator::Group g; g.swid = 1; g.id = Actuator::kFailoverGroupBase + 1; g.type = GroupType::FastFailover;
+  GroupBucket b1; b1.watch_port = 2; b1.out_ports = {2};
+  GroupBucket b2; b2.watch_port = 3; b2.out_ports = {3, OFController::kInPort};
+  g.buckets = {b1, b2};
+  ins.groups.push_back(g);
+  Actuator::Meter m; m.swid = 1; m.id = Actuator::kMeterBase + 1;
+  m.band.rate_kbps = 120000; m.band.burst_kb = 12000;
+  ins.meters.push_back(m);
+  s.shadow[1] = ins;
+  s.shadow[9] = Actuator::Installed{};
+
+  te::TE_Output p;
+  p.chosen_path = {{1, 100}, {2, 201}};
+  p.split[2] = {{201, 0.25}, {202, 0.75}};
+  p.beta[{1, 2}] = 1; p.beta[{2, 3}] = 0;
+  p.load_mbps[{1, 2}] = 42.5;
+  p.objective = 3.25; p.optimal = true; p.status_text = "optimal";
+  s.plan = p;
+  return s;
+}
+
+bool same(const StateSnapshot& a, const StateSnapshot& b) {
+  if (a.switches.size() != b.switches.size()) return false;
+  for (size_t i = 0; i < a.switches.size(); ++i) {
+    const auto& x = a.switches[i]; const auto& y = b.switches[i];
+    if (x.dpid != y.dpid || x.swid != y.swid || x.macs != y.macs) return false;
+  }
+  if (a.shadow != b.shadow || bool(a.plan) != bool(b.plan)) return false;
+  if (!a.plan) return true;
+  const auto& p = *a.plan; const auto& q = *b.plan;
+  return p.chosen_path == q.chosen_path && p.split == q.split && p.beta == q.beta &&
+         p.load_mbps == q.load_mbps && p.objective == q.objective && p.optimal == q.optimal &&
+         p.status_text == q.status_text;
+}
+
+void round_trip() {
+  const auto s = sample();
+  const auto img = StateStore::encode(s);
+  const auto back = StateStore::decode(img.data(), img.size());
+  CHECK(back && same(s, *back));
+
+  StateSnapshot empty;
+  const auto e = StateStore::encode(empty);
+  const auto eb = StateStore::decode(e.data(), e.size());
+  CHECK(eb && eb->switches.empty() && eb->shadow.empty() && !eb->plan);
+}
+
+void rejects_damage() {
+  const auto img = StateStore::encode(sample());
+  // truncated inside the header, at the payload start and inside it
+  for (size_t n : {size_t(0), size_t(8), size_t(31), size_t(32), size_t(33), img.size() / 2, img.size() - 1})
+    CHECK(!StateStore::decode(img.data(), n));
+
+  // a flipped payload byte fails the checksum
+  for (size_t at : {size_t(32), img.size() / 2, img.size() - 1}) {
+    auto bad = img;
+    bad[at] ^= 0x40;
+    CHECK(!StateStore::decode(bad.data(), bad.size()));
+  }
+
+  // bad magic, other format version
+  auto magic = img; magic[0] = 'X';
+  CHECK(!StateStore::decode(magic.data(), magic.size()));
+  auto ver = img; ver[8] = uint8_t(StateStore::kFormatVersion + 1);
+  CHECK(!StateStore::decode(ver.data(), ver.size()));
+
+  // trailing garbage changes the length the header promises
+  auto longer = img; longer.push_back(0);
+  CHECK(!StateStore::decode(longer.data(), longer.size()));
+}
+
+ino_t inode_of(const std::string& path) {
+  struct stat st{};
+  return ::stat(path.c_str(), &st) == 0 ? st.st_ino : 0;
+}
+
+void save_load(const std::string& dir) {
+  const std::string path = dir + "/hybrid_of.state";
+  StateStore store(path);
+  CHECK(!store.load());                       // no file: cold start
+
+  auto s = sample();
+  CHECK(store.save(s));
+  const auto back = store.load();
+  CHECK(back && same(s, *back));
+
+  // unchanged state: no new file is renamed over the old one
+  const ino_t first = inode_of(path);
+  CHECK(store.save(s));
+  CHECK(inode_of(path) == first);
+
+  // a change is written
+  s.shadow.erase(9);
+  CHECK(store.save(s));
+  CHECK(inode_of(path) != first);
+  const auto again = StateStore(path).load();
+  CHECK(again && same(s, *again));
+
+  // a truncated file on disk is a cold start, not half a state
+  CHECK(::truncate(path.c_str(), 40) == 0);
+  CHECK(!store.load());
+  ::unlink(path.c_str());
+}
+
+} // namespace
+
+int main() {
+  char tmpl[] = "/tmp/state_snapshot_test.XXXXXX";
+  const char* dir = ::mkdtemp(tmpl);
+  if (!dir) { std::perror("mkdtemp"); return 1; }
+  round_trip();
+  rejects_damage();
+  save_load(dir);
+  ::rmdir(dir);
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("state_snapshot_test: ok\n");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+// tests/switch_registry_test.cpp
+// SwitchRegistry: swid allocation order, reservations of pinned / remembered
+// ids, rebinding a dpid on a new connection, and refusing a swid that is
+// bound to another dpid.
+#include "switch_registry.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+constexpr uint64_t kBig = 0x0000aabbccdd0000ULL;   // above kMaxDerived: no derived id
+
+// pinned > derived > remembered > lowest free
+void allocation_order() {
+  SwitchRegistry r;
+  CHECK(r.allocate(3) == 3);                 // derived
+  CHECK(r.allocate(kBig) == 1);              // lowest free
+  CHECK(r.allocate(0) == 1);                 // no dpid yet (before FEATURES_REPLY)
+
+  r.pin(3, 7);
+  CHECK(r.allocate(3) == 7);                 // pin beats derived
+  r.remember(kBig + 1, 2);
+  CHECK(r.allocate(kBig + 1) == 2);
+  r.remember(4, 9);
+  CHECK(r.allocate(4) == 4);                 // derived beats remembered while free
+
+  // derived id taken by another dpid → remembered, then lowest free
+  CHECK(r.bind(4, 40, kBig + 2));
+  CHECK(r.allocate(4) == 9);
+  r.remember(5, 6);
+  CHECK(r.bind(5, 50, kBig + 3) && r.bind(6, 60, kBig + 4));
+  CHECK(r.allocate(5) == 1);                 // 5 and 6 bound to others, 2 and 7 reserved
+
+  // lowest free skips bound and reserved ids
+  SwitchRegistry s;
+  CHECK(s.bind(1, 10, kBig + 10) && s.bind(2, 11, kBig + 11));
+  s.pin(kBig + 12, 3);
+  CHECK(s.allocate(kBig + 13) == 4);
+  CHECK(s.allocate(kBig + 12) == 3);
+}
+
+// a pinned or remembered id stays with its dpid while the switch is away
+void reservations() {
+  SwitchRegistry r;
+  r.pin(kBig, 5);
+  CHECK(r.allocate(5) != 5);                 // derived id 5 is reserved for kBig
+  CHECK(r.bind(5, 10, kBig));
+  r.unbind_fd(10);
+  CHECK(r.size() == 0 && r.fd_of(5) == SwitchRegistry::kNone);
+  CHECK(r.allocate(kBig + 1) == 1 && r.allocate(5) != 5);
+
+  // re-pinning moves the reservation
+  r.pin(kBig, 8);
+  CHECK(r.allocate(5) == 5 && r.allocate(kBig) == 8);
+
+  // remember() does not take an id reserved by another dpid, nor override a pin
+  r.remember(kBig + 2, 8);
+  CHECK(r.allocate(kBig + 2) != 8);
+  r.remember(kBig, 3);
+  CHECK(r.allocate(kBig) == 8);
+
+  // remembering a new id for the same dpid frees the old one
+  r.remember(kBig + 3, 11);
+  r.remember(kBig + 3, 12);
+  CHECK(r.allocate(kBig + 3) == 12);
+  CHECK(r.allocate(11) == 11);
+
+  // invalid input is ignored
+  r.pin(0, 4); r.pin(kBig + 4, 0); r.remember(0, 4);
+  CHECK(r.allocate(4) == 4);
+}
+
+// the same dpid on a new connection replaces the stale one
+void rebind_same_dpid() {
+  SwitchRegistry r;
+  CHECK(r.bind(2, 20, kBig));
+  CHECK(r.bind(2, 21, kBig));                // reconnect before the old fd was reaped
+  CHECK(r.size() == 1);
+  CHECK(r.fd_of(2) == 21 && r.swid_of(21) == 2 && r.swid_of(20) == SwitchRegistry::kNone);
+  CHECK(r.fd_of_dpid(kBig) == 21);
+
+  // reaping the old fd later must not drop the new binding
+  r.unbind_fd(20);
+  CHECK(r.size() == 1 && r.fd_of(2) == 21);
+
+  // the dpid moving to another swid releases the first one
+  CHECK(r.bind(3, 22, kBig));
+  CHECK(r.size() == 1 && r.fd_of(2) == SwitchRegistry::kNone && r.swid_of(21) == SwitchRegistry::kNone);
+  CHECK(r.swid_of_dpid(kBig) == 3);
+
+  // rebinding the very same fd is idempotent
+  CHECK(r.bind(3, 22, kBig));
+  CHECK(r.size() == 1 && r.fd_of(3) == 22);
+}
+
+// a swid bound to one dpid is never handed to another
+void refuse_foreign_swid() {
+  SwitchRegistry r;
+  CHECK(r.bind(4, 30, kBig));
+  CHECK(!r.bind(4, 31, kBig + 1));
+  CHECK(r.size() == 1 && r.fd_of(4) == 30 && r.swid_of(31) == SwitchRegistry::kNone);
+  CHECK(r.swid_of_dpid(kBig + 1) == SwitchRegistry::kNone);
+  CHECK(r.allocate(kBig + 1) != 4);
+
+  CHECK(!r.bind(0, 32, kBig + 2) && !r.bind(5, -1, kBig + 2));
+
+  // once the owner is gone the id is free again
+  r.unbind_fd(30);
+  CHECK(r.bind(4, 31, kBig + 1) && r.fd_of_dpid(kBig + 1) == 31);
+}
+
+void iteration_and_clear() {
+  SwitchRegistry r;
+  CHECK(r.bind(9, 3, kBig) && r.bind(2, 7, kBig + 1) && r.bind(5, 1, kBig + 2));
+  CHECK(r.ids() == std::vector<int>({2, 5, 9}));
+  std::vector<int> fds;
+  r.for_each([&](int, int fd) { fds.push_back(fd); });
+  CHECK(fds == std::vector<int>({7, 1, 3}));
+  CHECK(r.fd_of(100) == SwitchRegistry::kNone && r.swid_of(100) == SwitchRegistry::kNone);
+
+  r.clear();
+  CHECK(r.size() == 0 && r.ids().empty() && r.swid_of_dpid(kBig) == SwitchRegistry::kNone);
+  CHECK(r.bind(9, 4, kBig + 1));            // bindings, not reservations, are cleared
+}
+
+} // namespace
+
+int main() {
+  allocation_order();
+  reservations();
+  rebind_same_dpid();
+  refuse_foreign_swid();
+  iteration_and_clear();
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("switch_registry_test: ok\n");
+  return failures ? 1 : 0;
+}
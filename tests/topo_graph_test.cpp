@@ -0,0 +1,152 @@
+// tests/topo_graph_test.cpp
+// TopoGraph::build and k_paths against the map-of-vectors adjacency the TE
+// path search used before the CSR: same neighbour order, same paths in the
+// same order, on random multigraphs with sparse node ids.
+#include "topo_graph.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <queue>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+using Edge = TopoGraph::Edge;
+using Adj  = std::map<int, std::vector<std::tuple<int,int,int>>>;   // node -> (neighbour, edge id, own port)
+
+Adj reference_adj(const std::vector<Edge>& edges) {
+  Adj adj;
+  for (size_t id = 0; id < edges.size(); ++id) {
+    const auto& e = edges[id];
+    adj[e.u].emplace_back(e.v, int(id), e.u_port);
+    adj[e.v].emplace_back(e.u, int(id), e.v_port);
+  }
+  return adj;
+}
+
+// The BFS as it was written over std::map<int, std::vector<int>>
+std::vector<std::vector<int>> reference_paths(const Adj& adj, int s, int d, size_t k) {
+  std::vector<std::vector<int>> out;
+  if (!adj.count(s) || !adj.count(d)) return out;
+  struct P { int node; std::vector<int> seq; };
+  std::queue<P> q; q.push({s, {s}});
+  std::set<std::vector<int>> seen;
+  while (!q.empty() && out.size() < k) {
+    auto cur = q.front(); q.pop();
+    if (cur.seq.size() > 10) continue;
+    if (cur.node == d) {
+      if (seen.insert(cur.seq).second) out.push_back(cur.seq);
+      continue;
+    }
+    for (const auto& [nb, id, port] : adj.at(cur.node)) {
+      (void)id; (void)port;
+      if (std::find(cur.seq.begin(), cur.seq.end(), nb) != cur.seq.end()) continue;
+      auto nxt = cur.seq; nxt.push_back(nb);
+      q.push({nb, std::move(nxt)});
+    }
+  }
+  return out;
+}
+
+// Random multigraph: sparse ids, parallel links on different ports
+std::vector<Edge> random_edges(std::mt19937& rng, int n) {
+  std::set<std::tuple<int,int,int,int>> es;
+  const int m = n + int(rng() % uint32_t(2 * n));
+  for (int i = 0; i < m; ++i) {
+    int a = 1 + int(rng() % uint32_t(n)) * 3, b = 1 + int(rng() % uint32_t(n)) * 3;
+    if (a == b) continue;
+    if (a > b) std::swap(a, b);
+    es.insert({a, b, 1 + int(rng() % 4), 1 + int(rng() % 4)});
+  }
+  std::vector<Edge> v;
+  for (const auto& [a, b, pa, pb] : es) v.push_back(Edge{a, b, pa, pb, {}});
+  std::shuffle(v.begin(), v.end(), rng);   // build() must not depend on edge order
+  return v;
+}
+
+void check_csr(const TopoGraph& g, const std::vector<Edge>& edges) {
+  const auto adj = reference_adj(edges);
+  CHECK(g.node_count() == adj.size() && g.edge_count() == edges.size());
+  CHECK(g.row.size() == g.node_count() + 1 && g.row.back() == 2 * edges.size());
+  CHECK(g.speeds.size() == edges.size());
+  size_t i = 0;
+  for (const auto& [node, half] : adj) {
+    CHECK(g.node_id(int(i)) == node && g.index_of(node) == int(i));
+    std::vector<std::tuple<int,int,int>> got;
+    g.for_each_neighbor(int(i), [&](int nb, int id, int port) { got.emplace_back(g.node_id(nb), id, port); });
+    CHECK(got == half);
+    ++i;
+  }
+  for (int x = -1; x <= (adj.empty() ? 0 : adj.rbegin()->first) + 1; ++x)
+    if (!adj.count(x)) CHECK(g.index_of(x) == -1);
+}
+
+void random_graphs() {
+  std::mt19937 rng(46);
+  for (int round = 0; round < 300; ++round) {
+    const int n = 3 + int(rng() % 12);
+    const auto edges = random_edges(rng, n);
+    const auto g = TopoGraph::build(uint64_t(round), edges);
+    CHECK(g->epoch == uint64_t(round));
+    check_csr(*g, edges);
+
+    const auto adj = reference_adj(edges);
+    for (int q = 0; q < 10; ++q) {
+      const int s = 1 + int(rng() % uint32_t(n)) * 3, d = 1 + int(rng() % uint32_t(n)) * 3;
+      if (s == d) continue;
+      const size_t k = 1 + rng() % 4;
+      std::vector<std::vector<int>> got;
+      for (const auto& seq : g->k_paths(s, d, k)) {
+        std::vector<int> ids;
+        for (int x : seq) ids.push_back(g->node_id(x));
+        got.push_back(std::move(ids));
+      }
+      CHECK(got == reference_paths(adj, s, d, k));
+      for (size_t p = 1; p < got.size(); ++p) CHECK(got[p-1].size() <= got[p].size());   // fewest hops first
+    }
+  }
+}
+
+void small_cases() {
+  // empty graph
+  const auto e = TopoGraph::build(0, {});
+  CHECK(e->node_count() == 0 && e->row.size() == 1 && e->k_paths(1, 2, 3).empty());
+
+  // square 1-2-4-3-1 with a parallel 1-2 link: two 2-hop paths 1 -> 4, the
+  // parallel link does not give a third
+  const std::vector<Edge> sq = {{1, 2, 1, 1, {}}, {2, 4, 2, 1, {}}, {3, 4, 1, 2, {}},
+                                {1, 3, 2, 2, {}}, {1, 2, 3, 3, {}}};
+  const auto g = TopoGraph::build(5, sq, {{100, 100}, {}, {}, {}, {1000, 10}});
+  check_csr(*g, sq);
+  CHECK(g->speeds[0].u_mbps == 100 && g->speeds[4].v_mbps == 10 && g->speeds[1].u_mbps == 0);
+  const auto p = g->k_paths(1, 4, 5);
+  CHECK(p.size() == 2);
+  CHECK(p.size() == 2 && g->node_id(p[0][1]) == 2 && g->node_id(p[1][1]) == 3);
+  CHECK(g->k_paths(1, 9, 3).empty());
+  CHECK(g->k_paths(1, 4, 0).empty());
+
+  // hop limit: paths have at most 10 nodes (1 -> 10 on a line, not 1 -> 11)
+  std::vector<Edge> line;
+  for (int i = 1; i < 12; ++i) line.push_back(Edge{i, i + 1, 2, 1, {}});
+  const auto l = TopoGraph::build(1, line);
+  CHECK(l->k_paths(1, 10, 1).size() == 1 && l->k_paths(1, 11, 1).empty());
+}
+
+} // namespace
+
+int main() {
+  small_cases();
+  random_graphs();
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("topo_graph_test: ok\n");
+  return failures ? 1 : 0;
+}
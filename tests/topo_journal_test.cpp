@@ -0,0 +1,268 @@
+// tests/topo_journal_test.cpp
+// TopoJournal / TopoJournalReader: append and reopen-and-append, Start
+// clearing the edge set, checkpointed replay against a replay from the first
+// record, and foreign or other-version files refused without being touched.
+#include "topo_journal.hpp"
+#include "topo_graph.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+using Kind = TopoJournalRecord::Kind;
+using Key  = std::tuple<int,int,int,int>;
+
+constexpr size_t kHeader = 64;
+
+TopoJournalRecord rec(Kind kind, int u, int v, int up, int vp, uint64_t epoch = 0, int old_up = 0, int old_vp = 0) {
+  TopoJournalRecord r;
+  r.kind = kind; r.epoch = epoch;
+  r.u = u; r.v = v; r.u_port = up; r.v_port = vp;
+  r.old_u_port = old_up; r.old_v_port = old_vp;
+  return r;
+}
+
+std::vector<char> read_file(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::vector<char>& bytes) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+std::set<Key> keys(const std::vector<TopoViewer::Edge>& edges) {
+  std::set<Key> out;
+  for (const auto& e : edges) out.emplace(e.u, e.v, e.u_port, e.v_port);
+  return out;
+}
+
+void append_and_reopen(const std::string& dir) {
+  const std::string path = dir + "/append.jrn";
+  {
+    auto j = TopoJournal::open(path);
+    CHECK(j && j->size() == 0);
+    if (!j) return;
+    j->append(rec(Kind::Start, 0, 0, 0, 0));
+    j->append(rec(Kind::SwitchUp, 1, 0, 0, 0));
+    j->append(rec(Kind::EdgeUp, 1, 2, 3, 4, 1));
+    CHECK(j->size() == 3);
+  }
+  // the pre-grown tail is trimmed on close
+  CHECK(read_file(path).size() == kHeader + 3 * sizeof(TopoJournalRecord));
+
+  int64_t created = 0;
+  {
+    auto r = TopoJournalReader::open(path);
+    CHECK(r && r->size() == 3);
+    if (!r) return;
+    created = r->created_ns();
+    CHECK((*r)[2].kind == Kind::EdgeUp && (*r)[2].epoch == 1 && (*r)[2].v_port == 4);
+    CHECK(created > 0 && created <= (*r)[0].t_ns);
+  }
+
+  {
+    auto j = TopoJournal::open(path);
+    CHECK(j && j->size() == 3);
+    if (!j) return;
+    j->append(rec(Kind::PortDown, 2, 0, 4, 0));
+    j->append(rec(Kind::EdgeDown, 1, 2, 3, 4, 2));
+    CHECK(j->size() == 5);
+  }
+  CHECK(read_file(path).size() == kHeader + 5 * sizeof(TopoJournalRecord));
+
+  auto r = TopoJournalReader::open(path);
+  CHECK(r && r->size() == 5);
+  if (!r) return;
+  CHECK(r->created_ns() == created);           // reopening keeps the header
+  const Kind want[] = {Kind::Start, Kind::SwitchUp, Kind::EdgeUp, Kind::PortDown, Kind::EdgeDown};
+  for (size_t i = 0; i < r->size(); ++i) {
+    CHECK((*r)[i].kind == want[i]);
+    if (i) CHECK((*r)[i - 1].t_ns <= (*r)[i].t_ns);
+  }
+  CHECK(r->edges_after(3).size() == 1 && r->edges_after(5).empty());
+  CHECK(r->count_until((*r)[4].t_ns) == 5 && r->count_until(created - 1) == 0);
+  ::unlink(path.c_str());
+}
+
+// every run starts with Start: the edges of the previous run are forgotten
+void start_resets(const std::string& dir) {
+  const std::string path = dir + "/start.jrn";
+  {
+    auto j = TopoJournal::open(path);
+    CHECK(j != nullptr);
+    if (!j) return;
+    j->append(rec(Kind::Start, 0, 0, 0, 0));
+    j->append(rec(Kind::EdgeUp, 1, 2, 1, 1, 1));
+    j->append(rec(Kind::EdgeUp, 2, 3, 2, 1, 2));
+    j->append(rec(Kind::EdgeMoved, 1, 2, 5, 1, 3, 1, 1));
+    j->append(rec(Kind::Suppressed, 2, 3, 2, 1));   // trigger only
+    j->append(rec(Kind::Start, 0, 0, 0, 0));
+    j->append(rec(Kind::EdgeUp, 3, 4, 1, 2, 1));
+  }
+  auto r = TopoJournalReader::open(path);
+  CHECK(r && r->size() == 7);
+  if (!r) return;
+  CHECK(keys(r->edges_after(3)) == std::set<Key>({{1, 2, 1, 1}, {2, 3, 2, 1}}));
+  CHECK(keys(r->edges_after(5)) == std::set<Key>({{1, 2, 5, 1}, {2, 3, 2, 1}}));
+  CHECK(r->edges_after(6).empty());
+  CHECK(keys(r->edges_after(7)) == std::set<Key>({{3, 4, 1, 2}}));
+  CHECK(keys(r->edges_after(100)) == keys(r->edges_after(7)));
+
+  const auto g = r->graph_at((*r)[6].t_ns);
+  CHECK(g->epoch == 1 && g->node_count() == 2 && g->edge_count() == 1);
+  ::unlink(path.c_str());
+}
+
+// edges_after() starts from a checkpoint; it must match a replay from record 0
+void checkpoint_replay(const std::string& dir) {
+  const std::string path = dir + "/replay.jrn";
+  const size_t n = 3 * TopoJournalReader::kCheckpointEvery + 500;
+  std::vector<TopoJournalRecord> written;
+  {
+    auto j = TopoJournal::open(path);
+    CHECK(j != nullptr);
+    if (!j) return;
+    std::mt19937 rng(50);
+    std::set<Key> live;
+    uint64_t epoch = 0;
+    for (size_t i = 0; i < n; ++i) {
+      TopoJournalRecord r;
+      const uint32_t pick = rng() % 100;
+      if (pick == 0) {
+        r = rec(Kind::Start, 0, 0, 0, 0);
+        live.clear();
+      } else if (pick < 5) {
+        r = rec(Kind::SwitchUp, 1 + int(rng() % 20), 0, 0, 0);    // trigger only
+      } else if (pick < 10 || live.empty()) {
+        const int u = 1 + int(rng() % 10), v = u + 1 + int(rng() % 10);
+        r = rec(Kind::EdgeUp, u, v, 1 + int(rng() % 4), 1 + int(rng() % 4), ++epoch);
+        live.emplace(r.u, r.v, r.u_port, r.v_port);
+      } else {
+        auto it = live.begin();
+        std::advance(it, long(rng() % live.size()));
+        const auto [u, v, up, vp] = *it;
+        if (pick < 60) {
+          r = rec(Kind::EdgeDown, u, v, up, vp, ++epoch);
+          live.erase(it);
+        } else if (pick < 75) {
+          r = rec(Kind::EdgeMoved, u, v, up + 4, vp, ++epoch, up, vp);
+          live.erase(it);
+          live.emplace(u, v, up + 4, vp);
+        } else {
+          const int a = 1 + int(rng() % 10), b = a + 1 + int(rng() % 10);
+          r = rec(Kind::EdgeUp, a, b, 1 + int(rng() % 4), 1 + int(rng() % 4), ++epoch);
+          live.emplace(r.u, r.v, r.u_port, r.v_port);
+        }
+      }
+      j->append(r);
+      written.push_back(r);
+    }
+    CHECK(j->size() == n);
+  }
+
+  auto r = TopoJournalReader::open(path);
+  CHECK(r && r->size() == n);
+  if (!r) return;
+  std::set<size_t> probe = {0, 1, n - 1, n, n + 10};
+  for (size_t c = 1; c <= 3; ++c)
+    for (size_t d : {size_t(0), size_t(1), size_t(2)}) probe.insert(c * TopoJournalReader::kCheckpointEvery + d - 1);
+  std::mt19937 rng(51);
+  for (int i = 0; i < 40; ++i) probe.insert(rng() % n);
+
+  // reference: apply every record from the start with a plain set
+  std::set<Key> cur;
+  size_t applied = 0;
+  for (size_t p : probe) {
+    for (; applied < std::min(p, n); ++applied) {
+      const auto& w = written[applied];
+      switch (w.kind) {
+        case Kind::EdgeUp:    cur.emplace(w.u, w.v, w.u_port, w.v_port); break;
+        case Kind::EdgeDown:  cur.erase(Key{w.u, w.v, w.u_port, w.v_port}); break;
+        case Kind::EdgeMoved: cur.erase(Key{w.u, w.v, w.old_u_port, w.old_v_port});
+                              cur.emplace(w.u, w.v, w.u_port, w.v_port); break;
+        case Kind::Start:     cur.clear(); break;
+        default: break;
+      }
+    }
+    CHECK(keys(r->edges_after(p)) == cur);
+  }
+
+  // graph_at: last edge epoch at or before t
+  const int64_t mid = (*r)[n / 2].t_ns;
+  const size_t upto = r->count_until(mid);
+  uint64_t epoch = 0;
+  for (size_t i = upto; i-- > 0; ) if (written[i].epoch) { epoch = written[i].epoch; break; }
+  const auto g = r->graph_at(mid);
+  CHECK(g->epoch == epoch && g->edge_count() == r->edges_after(upto).size());
+  ::unlink(path.c_str());
+}
+
+// neither the writer nor the reader may touch a file that is not ours
+void refuses_foreign(const std::string& dir) {
+  const std::string text = dir + "/notes.txt";
+  std::vector<char> words;
+  for (int i = 0; i < 20; ++i) for (char c : std::string("not a topology journal\n")) words.push_back(c);
+  write_file(text, words);
+  CHECK(!TopoJournal::open(text));
+  CHECK(!TopoJournalReader::open(text));
+  CHECK(read_file(text) == words);
+
+  const std::string tiny = dir + "/tiny.txt";
+  write_file(tiny, {'h', 'i', '\n'});
+  CHECK(!TopoJournal::open(tiny));
+  CHECK(!TopoJournalReader::open(tiny));
+  CHECK(read_file(tiny) == std::vector<char>({'h', 'i', '\n'}));
+
+  // a journal of another format version
+  const std::string old = dir + "/old.jrn";
+  {
+    auto j = TopoJournal::open(old);
+    CHECK(j != nullptr);
+    if (j) j->append(rec(Kind::Start, 0, 0, 0, 0));
+  }
+  auto bytes = read_file(old);
+  CHECK(bytes.size() == kHeader + sizeof(TopoJournalRecord));
+  bytes[8] = char(TopoJournal::kFormatVersion + 1);   // version follows the 8-byte magic
+  write_file(old, bytes);
+  CHECK(!TopoJournal::open(old));
+  CHECK(!TopoJournalReader::open(old));
+  CHECK(read_file(old) == bytes);
+
+  ::unlink(text.c_str());
+  ::unlink(tiny.c_str());
+  ::unlink(old.c_str());
+}
+
+} // namespace
+
+int main() {
+  char tmpl[] = "/tmp/topo_journal_test.XXXXXX";
+  const char* dir = ::mkdtemp(tmpl);
+  if (!dir) { std::perror("mkdtemp"); return 1; }
+  append_and_reopen(dir);
+  start_resets(dir);
+  checkpoint_replay(dir);
+  refuses_foreign(dir);
+  ::rmdir(dir);
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("topo_journal_test: ok\n");
+  return failures ? 1 : 0;
+}
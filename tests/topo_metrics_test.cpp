@@ -0,0 +1,184 @@
+// tests/topo_metrics_test.cpp
+// TopoMetrics against brute force on small random multigraphs (parallel
+// links, disconnected parts): bridges and capped connectivity by removing
+// every edge subset smaller than kMax, betweenness by counting shortest paths
+// from every ordered node pair.
+#include "topo_metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+using Edge  = TopoGraph::Edge;
+using Pairs = std::vector<std::pair<int,int>>;
+
+// Hop distances from s over the links not marked gone (nodes 1..n)
+std::vector<int> bfs(int n, const Pairs& links, const std::vector<bool>& gone, int s) {
+  std::vector<std::vector<int>> adj(size_t(n) + 1);
+  for (size_t i = 0; i < links.size(); ++i) {
+    if (gone[i]) continue;
+    adj[size_t(links[i].first)].push_back(links[i].second);
+    adj[size_t(links[i].second)].push_back(links[i].first);
+  }
+  std::vector<int> d(size_t(n) + 1, -1), q{s};
+  d[size_t(s)] = 0;
+  for (size_t h = 0; h < q.size(); ++h)
+    for (int y : adj[size_t(q[h])])
+      if (d[size_t(y)] < 0) { d[size_t(y)] = d[size_t(q[h])] + 1; q.push_back(y); }
+  return d;
+}
+
+// min(kMax, smallest edge cut between u and v): try every subset of fewer
+// than kMax edges
+int brute_connectivity(int n, const Pairs& edges, int u, int v) {
+  const size_t m = edges.size();
+  for (int k = 1; k < TopoMetrics::kMax; ++k) {
+    if (size_t(k) > m) break;
+    std::vector<size_t> sel(size_t(k), 0);
+    for (size_t i = 0; i < sel.size(); ++i) sel[i] = i;
+    for (;;) {
+      std::vector<bool> gone(m, false);
+      for (size_t s : sel) gone[s] = true;
+      if (bfs(n, edges, gone, u)[size_t(v)] < 0) return k;
+      int i = k - 1;
+      while (i >= 0 && sel[size_t(i)] == m - size_t(k) + size_t(i)) --i;
+      if (i < 0) break;
+      ++sel[size_t(i)];
+      for (size_t j = size_t(i) + 1; j < sel.size(); ++j) sel[j] = sel[j - 1] + 1;
+    }
+  }
+  return TopoMetrics::kMax;
+}
+
+// Share of ordered pairs (s, t) of nodes with links whose shortest paths
+// cross u-v, each pair weighted by the fraction of its shortest paths that do
+double brute_betweenness(int n, const Pairs& links, const std::vector<int>& nodes, int u, int v) {
+  const std::vector<bool> none(links.size(), false);
+  // number of shortest paths from s to every node
+  auto sigma = [&](int s, const std::vector<int>& d) {
+    std::vector<double> sg(size_t(n) + 1, 0.0);
+    sg[size_t(s)] = 1.0;
+    for (int h = 1; h <= n; ++h)
+      for (const auto& [a, b] : links) {
+        if (d[size_t(b)] == h && d[size_t(a)] == h - 1) sg[size_t(b)] += sg[size_t(a)];
+        if (d[size_t(a)] == h && d[size_t(b)] == h - 1) sg[size_t(a)] += sg[size_t(b)];
+      }
+    return sg;
+  };
+  double total = 0.0;
+  for (int s : nodes) {
+    const auto ds = bfs(n, links, none, s);
+    const auto ss = sigma(s, ds);
+    for (int t : nodes) {
+      if (s == t || ds[size_t(t)] < 0) continue;
+      const auto dt = bfs(n, links, none, t);
+      const auto st = sigma(t, dt);
+      const int dist = ds[size_t(t)];
+      if (ds[size_t(u)] >= 0 && dt[size_t(v)] >= 0 && ds[size_t(u)] + 1 + dt[size_t(v)] == dist)
+        total += ss[size_t(u)] * st[size_t(v)] / ss[size_t(t)];
+      if (ds[size_t(v)] >= 0 && dt[size_t(u)] >= 0 && ds[size_t(v)] + 1 + dt[size_t(u)] == dist)
+        total += ss[size_t(v)] * st[size_t(u)] / ss[size_t(t)];
+    }
+  }
+  const double k = double(nodes.size());
+  return total / (k * (k - 1));
+}
+
+void random_multigraphs() {
+  std::mt19937 rng(49);
+  for (int round = 0; round < 400; ++round) {
+    const int n = 3 + int(rng() % 7);
+    const int m = n - 1 + int(rng() % 8);
+    std::vector<Edge> edges;
+    Pairs all;                                   // every edge, parallel ones included
+    for (int i = 0; i < m; ++i) {
+      int u = 1 + int(rng() % uint32_t(n)), v = 1 + int(rng() % uint32_t(n));
+      if (u == v) continue;
+      if (u > v) std::swap(u, v);
+      edges.push_back(Edge{u, v, i + 1, i + 1, {}});
+      all.push_back({u, v});
+    }
+    const auto g = TopoGraph::build(uint64_t(round), edges);
+    const auto metrics = TopoMetrics::compute(*g);
+    const auto& links = metrics->links;
+
+    Pairs simple;
+    for (const auto& l : links) simple.push_back({l.u, l.v});
+    CHECK(std::is_sorted(simple.begin(), simple.end()));
+    std::vector<int> nodes(g->nodes.begin(), g->nodes.end());
+
+    size_t bridges = 0;
+    for (const auto& l : links) {
+      int par = 0;
+      for (const auto& e : all) par += (e == std::make_pair(l.u, l.v));
+      CHECK(l.parallel == par);
+      const int lambda = brute_connectivity(n, all, l.u, l.v);
+      CHECK(l.connectivity == lambda);
+      CHECK(l.bridge == (lambda == 1));
+      bridges += l.bridge;
+      CHECK(std::fabs(l.betweenness - brute_betweenness(n, simple, nodes, l.u, l.v)) < 1e-9);
+      CHECK(metrics->find(l.v, l.u) == &l);
+    }
+    CHECK(metrics->bridge_count() == bridges);
+
+    // bridges sleep last, after every non-bridge
+    const auto order = metrics->sleep_order();
+    CHECK(order.size() == links.size());
+    bool seen_bridge = false;
+    for (size_t i : order) {
+      if (links[i].bridge) seen_bridge = true;
+      else CHECK(!seen_bridge);
+    }
+
+    // same links on other ports: update() keeps the old analysis
+    auto moved = edges;
+    for (auto& e : moved) e.u_port += 100;
+    CHECK(TopoMetrics::update(metrics, *TopoGraph::build(uint64_t(round) + 1, moved)) == metrics);
+    // one parallel edge fewer or more is a structural change
+    if (!edges.empty()) {
+      auto fewer = edges;
+      fewer.pop_back();
+      CHECK(TopoMetrics::update(metrics, *TopoGraph::build(uint64_t(round) + 1, fewer)) != metrics);
+    }
+  }
+}
+
+void known_graphs() {
+  // path 1-2-3 plus triangle 3-4-5: the path links are bridges
+  const auto g = TopoGraph::build(1, {{1, 2, 1, 1, {}}, {2, 3, 2, 1, {}}, {3, 4, 2, 1, {}},
+                                      {4, 5, 2, 1, {}}, {3, 5, 3, 2, {}}});
+  const auto m = TopoMetrics::compute(*g);
+  CHECK(m->epoch == 1 && m->links.size() == 5 && m->bridge_count() == 2);
+  CHECK(m->find(1, 2) && m->find(1, 2)->bridge && m->find(2, 3)->bridge);
+  CHECK(m->find(3, 4) && !m->find(3, 4)->bridge && m->find(3, 4)->connectivity == 2);
+  CHECK(!m->find(1, 3) && !m->find(9, 10));
+
+  // a doubled link is no bridge
+  const auto d = TopoMetrics::compute(*TopoGraph::build(2, {{1, 2, 1, 1, {}}, {1, 2, 2, 2, {}}}));
+  CHECK(d->links.size() == 1 && d->links[0].parallel == 2 && !d->links[0].bridge && d->links[0].connectivity == 2);
+  CHECK(std::fabs(d->links[0].betweenness - 1.0) < 1e-12);
+
+  // empty topology
+  const auto e = TopoMetrics::compute(*TopoGraph::build(3, {}));
+  CHECK(e->links.empty() && e->bridge_count() == 0 && e->sleep_order().empty());
+}
+
+} // namespace
+
+int main() {
+  known_graphs();
+  random_multigraphs();
+  if (failures) std::fprintf(stderr, "%d check(s) failed\n", failures);
+  else std::printf("topo_metrics_test: ok\n");
+  return failures ? 1 : 0;
+}